@@ -4,6 +4,7 @@ ifeq ($(OS),Windows_NT)
 	OUT=$(PROJECT).exe
 	TOOLCHAIN=i686-w64-mingw32
 	CC=$(TOOLCHAIN)-cc
+	HOSTEXE=.exe
 else
 	OUT=$(PROJECT)
 	TOOLCHAIN=local
@@ -41,7 +42,7 @@ EMSCRIPTEN=\
 	-s SDL2_IMAGE_FORMATS='["png"]' \
 	-s USE_ZLIB=1 \
 	--preload-file emscripten.ini \
-	--preload-file res \
+	--preload-file $(PACK) \
 	--shell-file emscripten/shell.html\
 	-o emscripten/index.html
 
@@ -51,3 +52,22 @@ SRCS=\
 	$(wildcard src/inih/*.c)
 
 OBJS=$(patsubst %.c, %.o, $(SRCS))
+
+# The packer runs on the build host, so it isn't cross-compiled.
+HOSTCC ?= cc
+
+HOSTCFLAGS ?=\
+	-DSDL_MAIN_HANDLED\
+	-O2\
+	-pedantic-errors\
+	-std=c99\
+	-Wall\
+	-Werror\
+	-Wextra
+
+HOSTLIBS ?= -lSDL2 -lz
+
+PACK=res.pack
+PACKER=tools/pack-host$(HOSTEXE)
+
+RES=$(sort $(wildcard res/*/*))
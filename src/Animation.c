@@ -0,0 +1,408 @@
+/**
+ * @file      Animation.c
+ * @ingroup   Animation
+ * @defgroup  Animation
+ * @brief     Table-driven sprite animation.  Clips are read from an
+ *            INI file and compiled into a flat table of source rects
+ *            once; each entity then only keeps an index into it.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Animation.h"
+#include "Log.h"
+#include "Memory.h"
+#include "Pack.h"
+#include "inih/ini.h"
+
+/**
+ * @brief This structure carries the state of the INI parser between
+ * the calls of _Handler().
+ */
+typedef struct AnimationParser_t
+{
+    AnimationSheet *pstSheet;
+    int8_t          s8Error;
+    char            aacStates[ANIMATION_STATE_COUNT][ANIMATION_MAX_NAME_LENGTH];
+} AnimationParser;
+
+static const char *_apacStateNames[ANIMATION_STATE_COUNT] =
+{
+    "idle",
+    "run",
+    "jump",
+    "fall"
+};
+
+static AnimationClip *_GetClip(AnimationSheet *pstSheet, const char *pacName)
+{
+    AnimationClip *pstClip;
+
+    for (uint8_t u8Index = 0; u8Index < pstSheet->u8ClipCount; u8Index++)
+    {
+        if (0 == strcmp(pacName, pstSheet->astClips[u8Index].acName))
+        {
+            return &pstSheet->astClips[u8Index];
+        }
+    }
+
+    if ((pstSheet->u8ClipCount >= ANIMATION_MAX_CLIPS) ||
+        (strlen(pacName) >= ANIMATION_MAX_NAME_LENGTH))
+    {
+        return NULL;
+    }
+
+    pstClip = &pstSheet->astClips[pstSheet->u8ClipCount];
+    memset(pstClip, 0, sizeof(struct AnimationClip_t));
+    memcpy(pstClip->acName, pacName, strlen(pacName) + 1);
+    pstClip->u8Frames       = 1;
+    pstClip->dFrameDuration = 0.1;
+    pstSheet->u8ClipCount++;
+
+    return pstClip;
+}
+
+static int8_t _ParseInteger(
+    AnimationParser *pstParser,
+    const char      *pacSection,
+    const char      *pacName,
+    const char      *pacValue,
+    long             lMin,
+    long             lMax,
+    long            *plValue)
+{
+    char *pacEnd;
+
+    *plValue = strtol(pacValue, &pacEnd, 10);
+    if ((pacEnd == pacValue) || ('\0' != *pacEnd) || (*plValue < lMin) || (*plValue > lMax))
+    {
+        LOG_ERROR(
+            "InitAnimationSheet(): %s of '%s' must be %ld to %ld.",
+            pacName,
+            pacSection,
+            lMin,
+            lMax);
+        pstParser->s8Error = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int32_t _Handler(
+    void       *pParser,
+    const char *pacSection,
+    const char *pacName,
+    const char *pacValue)
+{
+    AnimationParser *pstParser = (AnimationParser *)pParser;
+    AnimationSheet  *pstSheet  = pstParser->pstSheet;
+    AnimationClip   *pstClip;
+    long             lValue;
+
+    #define MATCH(pacN) strcmp(pacName, pacN) == 0
+    #define PARSE(lMin, lMax) (-1 != _ParseInteger(pstParser, pacSection, pacName, pacValue, lMin, lMax, &lValue))
+
+    if (0 == strcmp(pacSection, "sheet"))
+    {
+        if      (MATCH("width")  && PARSE(1, UINT16_MAX)) { pstSheet->s32FrameWidth  = lValue; }
+        else if (MATCH("height") && PARSE(1, UINT16_MAX)) { pstSheet->s32FrameHeight = lValue; }
+        else
+        {
+            return 0;
+        }
+        return 1;
+    }
+
+    if (0 == strcmp(pacSection, "states"))
+    {
+        for (uint8_t u8State = 0; u8State < ANIMATION_STATE_COUNT; u8State++)
+        {
+            if (MATCH(_apacStateNames[u8State]))
+            {
+                strncpy(pstParser->aacStates[u8State], pacValue, ANIMATION_MAX_NAME_LENGTH - 1);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Every other section is a clip.
+    pstClip = _GetClip(pstSheet, pacSection);
+    if (NULL == pstClip)
+    {
+        LOG_ERROR("InitAnimationSheet(): invalid clip '%s'.", pacSection);
+        pstParser->s8Error = 1;
+        return 0;
+    }
+
+    if      (MATCH("row")   && PARSE(0, UINT8_MAX)) { pstClip->u8Row        = lValue; }
+    else if (MATCH("first") && PARSE(0, UINT8_MAX)) { pstClip->u8FirstFrame = lValue; }
+    else if (MATCH("count") && PARSE(1, UINT8_MAX)) { pstClip->u8Frames     = lValue; }
+    else if (MATCH("fps"))
+    {
+        double dFPS = atof(pacValue);
+        if (dFPS <= 0)
+        {
+            LOG_ERROR("InitAnimationSheet(): clip '%s' has no frame rate.", pacSection);
+            pstParser->s8Error = 1;
+            return 0;
+        }
+        pstClip->dFrameDuration = 1 / dFPS;
+    }
+    else if (MATCH("mode"))
+    {
+        if      (0 == strcmp(pacValue, "loop"))     { pstClip->u8Mode = ANIMATION_LOOP;     }
+        else if (0 == strcmp(pacValue, "once"))     { pstClip->u8Mode = ANIMATION_ONCE;     }
+        else if (0 == strcmp(pacValue, "pingpong")) { pstClip->u8Mode = ANIMATION_PINGPONG; }
+        else
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    #undef PARSE
+    #undef MATCH
+
+    return 1;
+}
+
+static int8_t _Compile(AnimationSheet *pstSheet)
+{
+    uint32_t u32Rects = 0;
+    uint16_t u16Rect  = 0;
+
+    if ((0 == pstSheet->s32FrameWidth) || (0 == pstSheet->s32FrameHeight))
+    {
+        LOG_ERROR("InitAnimationSheet(): [sheet] needs a width and a height.");
+        return -1;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstSheet->u8ClipCount; u8Index++)
+    {
+        AnimationClip *pstClip = &pstSheet->astClips[u8Index];
+
+        if (0 == pstClip->u8Frames)
+        {
+            LOG_ERROR("InitAnimationSheet(): clip '%s' has no frames.", pstClip->acName);
+            return -1;
+        }
+
+        // A ping-pong clip does not repeat its first and last frame.
+        pstClip->u16FrameCount = pstClip->u8Frames;
+        if ((ANIMATION_PINGPONG == pstClip->u8Mode) && (pstClip->u8Frames > 2))
+        {
+            pstClip->u16FrameCount = 2 * pstClip->u8Frames - 2;
+        }
+        u32Rects += pstClip->u16FrameCount;
+    }
+
+    if (u32Rects > UINT16_MAX)
+    {
+        LOG_ERROR("InitAnimationSheet(): too many frames.");
+        return -1;
+    }
+
+    pstSheet->pstRects = AllocMemory(MEMORY_TAG_ANIMATION, u32Rects * sizeof(SDL_Rect));
+    if (NULL == pstSheet->pstRects)
+    {
+        LOG_ERROR("InitAnimationSheet(): error allocating memory.");
+        return -1;
+    }
+    pstSheet->u16RectCount = u32Rects;
+
+    for (uint8_t u8Index = 0; u8Index < pstSheet->u8ClipCount; u8Index++)
+    {
+        AnimationClip *pstClip = &pstSheet->astClips[u8Index];
+
+        pstClip->u16FirstRect = u16Rect;
+        for (uint16_t u16Frame = 0; u16Frame < pstClip->u16FrameCount; u16Frame++)
+        {
+            SDL_Rect *pstRect   = &pstSheet->pstRects[u16Rect++];
+            uint16_t  u16Column = u16Frame;
+
+            if (u16Frame >= pstClip->u8Frames)
+            {
+                u16Column = 2 * (pstClip->u8Frames - 1) - u16Frame;
+            }
+
+            pstRect->x = (pstClip->u8FirstFrame + u16Column) * pstSheet->s32FrameWidth;
+            pstRect->y = pstClip->u8Row * pstSheet->s32FrameHeight;
+            pstRect->w = pstSheet->s32FrameWidth;
+            pstRect->h = pstSheet->s32FrameHeight;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Free AnimationSheet from memory.
+ * @param   pstSheet an AnimationSheet.  See @ref struct AnimationSheet.
+ * @ingroup Animation
+ */
+void FreeAnimationSheet(AnimationSheet *pstSheet)
+{
+    if (NULL == pstSheet)
+    {
+        return;
+    }
+
+    FreeMemory(pstSheet->pstRects);
+    FreeMemory(pstSheet);
+}
+
+/**
+ * @brief   Initialise Animation.  Playback starts with the first frame
+ *          of the idle clip.
+ * @param   pstAnimation an Animation.  See @ref struct Animation.
+ * @param   pstSheet     the AnimationSheet.  See @ref struct AnimationSheet.
+ * @ingroup Animation
+ */
+void InitAnimation(Animation *pstAnimation, const AnimationSheet *pstSheet)
+{
+    const AnimationClip *pstClip = &pstSheet->astClips[pstSheet->au8StateClips[ANIMATION_STATE_IDLE]];
+
+    pstAnimation->pstSheet = pstSheet;
+    pstAnimation->pstRect  = &pstSheet->pstRects[pstClip->u16FirstRect];
+    pstAnimation->dTime    = 0;
+    pstAnimation->u16Frame = 0;
+    pstAnimation->u8Clip   = pstSheet->au8StateClips[ANIMATION_STATE_IDLE];
+}
+
+/**
+ * @brief   Initialise AnimationSheet from an INI file.  The section
+ *          [sheet] holds the frame size, [states] assigns a clip to
+ *          each state and every other section is a clip.
+ * @param   pstPack     the Pack to read from or NULL.  See @ref struct Pack.
+ * @param   pacFilename the filename of the INI file.
+ * @return  an AnimationSheet on success, NULL on failure.
+ * @ingroup Animation
+ */
+AnimationSheet *InitAnimationSheet(Pack *pstPack, const char *pacFilename)
+{
+    AnimationParser        stParser;
+    int32_t                s32Status;
+    static AnimationSheet *pstSheet;
+    pstSheet = AllocZeroedMemory(MEMORY_TAG_ANIMATION, 1, sizeof(struct AnimationSheet_t));
+    if (NULL == pstSheet)
+    {
+        LOG_ERROR("InitAnimationSheet(): error allocating memory.");
+        return NULL;
+    }
+
+    memset(&stParser, 0, sizeof(struct AnimationParser_t));
+    stParser.pstSheet = pstSheet;
+
+    s32Status = ParsePackIni(pstPack, pacFilename, _Handler, &stParser);
+    if (0 > s32Status)
+    {
+        LOG_ERROR("Couldn't load animation configuration: %s", pacFilename);
+        FreeAnimationSheet(pstSheet);
+        return NULL;
+    }
+
+    // A positive status is the first line the handler rejected.
+    if (0 < s32Status)
+    {
+        LOG_ERROR("InitAnimationSheet(): error in %s on line %ld.", pacFilename, (long)s32Status);
+        FreeAnimationSheet(pstSheet);
+        return NULL;
+    }
+
+    if (stParser.s8Error || (-1 == _Compile(pstSheet)))
+    {
+        FreeAnimationSheet(pstSheet);
+        return NULL;
+    }
+
+    // Resolve the clip names once; the state machine only uses indices.
+    for (uint8_t u8State = 0; u8State < ANIMATION_STATE_COUNT; u8State++)
+    {
+        uint8_t u8Index;
+
+        for (u8Index = 0; u8Index < pstSheet->u8ClipCount; u8Index++)
+        {
+            if (0 == strcmp(stParser.aacStates[u8State], pstSheet->astClips[u8Index].acName))
+            {
+                break;
+            }
+        }
+
+        if (u8Index == pstSheet->u8ClipCount)
+        {
+            LOG_ERROR(
+                "InitAnimationSheet(): no clip for state '%s'.",
+                _apacStateNames[u8State]);
+            FreeAnimationSheet(pstSheet);
+            return NULL;
+        }
+        pstSheet->au8StateClips[u8State] = u8Index;
+    }
+
+    return pstSheet;
+}
+
+/**
+ * @brief   Update Animation.  Switches to the clip of the given state
+ *          if it changed and advances the current frame.
+ * @param   pstAnimation an Animation.  See @ref struct Animation.
+ * @param   u8State      the state.  See @ref enum AnimationState.
+ * @param   dDeltaTime   time since last frame in seconds.
+ * @ingroup Animation
+ */
+void UpdateAnimation(
+    Animation *pstAnimation,
+    uint8_t    u8State,
+    double     dDeltaTime)
+{
+    const AnimationSheet *pstSheet = pstAnimation->pstSheet;
+    const AnimationClip  *pstClip;
+    uint8_t               u8Clip   = pstSheet->au8StateClips[u8State];
+
+    if (u8Clip != pstAnimation->u8Clip)
+    {
+        pstAnimation->u8Clip   = u8Clip;
+        pstAnimation->u16Frame = 0;
+        pstAnimation->dTime    = 0;
+    }
+    pstClip = &pstSheet->astClips[u8Clip];
+
+    pstAnimation->dTime += dDeltaTime;
+
+    // Whole cycles, e.g. when catching up after dormancy, change nothing.
+    if (ANIMATION_ONCE != pstClip->u8Mode)
+    {
+        pstAnimation->dTime = fmod(
+            pstAnimation->dTime,
+            pstClip->dFrameDuration * pstClip->u16FrameCount);
+    }
+
+    while (pstAnimation->dTime >= pstClip->dFrameDuration)
+    {
+        pstAnimation->dTime -= pstClip->dFrameDuration;
+        pstAnimation->u16Frame++;
+
+        if (pstAnimation->u16Frame >= pstClip->u16FrameCount)
+        {
+            if (ANIMATION_ONCE == pstClip->u8Mode)
+            {
+                pstAnimation->u16Frame = pstClip->u16FrameCount - 1;
+                pstAnimation->dTime    = 0;
+                break;
+            }
+            pstAnimation->u16Frame = 0;
+        }
+    }
+
+    pstAnimation->pstRect = &pstSheet->pstRects[pstClip->u16FirstRect + pstAnimation->u16Frame];
+}
@@ -0,0 +1,104 @@
+/**
+ * @file    Animation.h
+ * @ingroup Animation
+ */
+
+#ifndef _ANIMATION_H_
+#define _ANIMATION_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Pack.h"
+
+/**
+ * @ingroup Animation
+ */
+enum AnimationLimits
+{
+    ANIMATION_MAX_CLIPS       = 16,
+    ANIMATION_MAX_NAME_LENGTH = 16
+};
+
+/**
+ * @ingroup Animation
+ */
+enum AnimationMode
+{
+    ANIMATION_LOOP     = 0,
+    ANIMATION_ONCE     = 1,
+    ANIMATION_PINGPONG = 2
+};
+
+/**
+ * @brief   States of the animation state machine.  Each state plays the
+ *          clip assigned to it in the [states] section of the sheet.
+ * @ingroup Animation
+ */
+enum AnimationState
+{
+    ANIMATION_STATE_IDLE  = 0,
+    ANIMATION_STATE_RUN   = 1,
+    ANIMATION_STATE_JUMP  = 2,
+    ANIMATION_STATE_FALL  = 3,
+    ANIMATION_STATE_COUNT = 4
+};
+
+/**
+ * @brief   A clip is a run of frame rects in the rect table of its
+ *          sheet.  Ping-pong clips are stored unrolled, so playing any
+ *          clip is just counting up.
+ * @ingroup Animation
+ */
+typedef struct AnimationClip_t
+{
+    char     acName[ANIMATION_MAX_NAME_LENGTH];
+    uint16_t u16FirstRect;
+    uint16_t u16FrameCount;
+    uint8_t  u8Mode;
+    uint8_t  u8Row;
+    uint8_t  u8FirstFrame;
+    uint8_t  u8Frames;
+    double   dFrameDuration;
+} AnimationClip;
+
+/**
+ * @brief   The clips of a sprite sheet, compiled into one flat table of
+ *          source rects.
+ * @ingroup Animation
+ */
+typedef struct AnimationSheet_t
+{
+    SDL_Rect      *pstRects;
+    AnimationClip  astClips[ANIMATION_MAX_CLIPS];
+    uint8_t        au8StateClips[ANIMATION_STATE_COUNT];
+    uint16_t       u16RectCount;
+    uint8_t        u8ClipCount;
+    int32_t        s32FrameWidth;
+    int32_t        s32FrameHeight;
+} AnimationSheet;
+
+/**
+ * @brief   Playback state of one entity.
+ * @ingroup Animation
+ */
+typedef struct Animation_t
+{
+    const AnimationSheet *pstSheet;
+    const SDL_Rect       *pstRect;
+    double                dTime;
+    uint16_t              u16Frame;
+    uint8_t               u8Clip;
+} Animation;
+
+void FreeAnimationSheet(AnimationSheet *pstSheet);
+
+void InitAnimation(Animation *pstAnimation, const AnimationSheet *pstSheet);
+
+AnimationSheet *InitAnimationSheet(Pack *pstPack, const char *pacFilename);
+
+void UpdateAnimation(
+    Animation *pstAnimation,
+    uint8_t    u8State,
+    double     dDeltaTime);
+
+#endif
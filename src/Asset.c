@@ -0,0 +1,687 @@
+/**
+ * @file      Asset.c
+ * @ingroup   Asset
+ * @defgroup  Asset
+ * @brief     Asynchronous image loading.  Images are decoded and
+ *            converted to the pixel format of the renderer on worker
+ *            threads; only creating the textures is left to the render
+ *            thread.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "Asset.h"
+#include "Job.h"
+#include "Log.h"
+#include "Memory.h"
+#include "Pack.h"
+
+/**
+ * @brief This structure is the header of a file in the texture cache,
+ * followed by the deflated pixels.  The cache is never shared between
+ * machines, so the header is written in native byte order.
+ */
+typedef struct AssetCacheHeader_t
+{
+    char     acMagic[4];
+    uint32_t u32Version;
+    uint32_t u32Format;
+    int32_t  s32Width;
+    int32_t  s32Height;
+    int32_t  s32Pitch;
+    uint64_t u64SourceSize;
+    int64_t  s64SourceTime;
+    uint32_t u32StoredSize;
+    uint32_t u32Reserved;
+    char     acFilename[ASSET_MAX_PATH_LENGTH];
+} AssetCacheHeader;
+
+static Asset *_GetAsset(AssetManager *pstAssets, int16_t s16Handle)
+{
+    if ((NULL == pstAssets) || (s16Handle < 0) || (s16Handle >= pstAssets->u16Count))
+    {
+        return NULL;
+    }
+
+    return &pstAssets->astAssets[s16Handle];
+}
+
+/* The state is polled without waiting for the job counter, so it has
+ * to order the fields written by the decoding job itself.
+ * SDL_AtomicSet() only orders like an acquire. */
+static uint8_t _GetState(Asset *pstAsset)
+{
+    uint8_t u8State = SDL_AtomicGet(&pstAsset->stState);
+
+    SDL_MemoryBarrierAcquire();
+
+    return u8State;
+}
+
+static void _SetState(Asset *pstAsset, uint8_t u8State)
+{
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&pstAsset->stState, u8State);
+}
+
+static void _GetCachePath(const Asset *pstAsset, char *pacPath)
+{
+    uint32_t u32Hash = 2166136261u;
+
+    // FNV-1a; the full filename is compared on load anyway.
+    for (const char *pacChar = pstAsset->acFilename; '\0' != *pacChar; pacChar++)
+    {
+        u32Hash = (u32Hash ^ (uint8_t)*pacChar) * 16777619u;
+    }
+
+    snprintf(
+        pacPath,
+        ASSET_MAX_CACHE_PATH_LENGTH,
+        "%s%08x-%08x.tex",
+        pstAsset->pacCacheDirectory,
+        (unsigned int)u32Hash,
+        (unsigned int)pstAsset->u32Format);
+}
+
+static SDL_Surface *_LoadCached(
+    const Asset *pstAsset,
+    uint64_t     u64SourceSize,
+    int64_t      s64SourceTime)
+{
+    char                    acPath[ASSET_MAX_CACHE_PATH_LENGTH];
+    const AssetCacheHeader *pstHeader;
+    uint8_t                *pu8File;
+    SDL_Surface            *pstSurface;
+    size_t                  zFileSize;
+    uLongf                  zSize;
+
+    _GetCachePath(pstAsset, acPath);
+
+    pu8File = SDL_LoadFile(acPath, &zFileSize);
+    if (NULL == pu8File)
+    {
+        return NULL;
+    }
+    pstHeader = (const AssetCacheHeader *)pu8File;
+
+    if ((zFileSize < sizeof(struct AssetCacheHeader_t)) ||
+        (0 != memcmp(pstHeader->acMagic, "BSTC", 4)) ||
+        (ASSET_CACHE_VERSION != pstHeader->u32Version) ||
+        (pstAsset->u32Format != pstHeader->u32Format) ||
+        (u64SourceSize != pstHeader->u64SourceSize) ||
+        (s64SourceTime != pstHeader->s64SourceTime) ||
+        (zFileSize - sizeof(struct AssetCacheHeader_t) != pstHeader->u32StoredSize) ||
+        (0 != strncmp(pstAsset->acFilename, pstHeader->acFilename, ASSET_MAX_PATH_LENGTH)))
+    {
+        SDL_free(pu8File);
+        return NULL;
+    }
+
+    pstSurface = SDL_CreateRGBSurfaceWithFormat(
+        0,
+        pstHeader->s32Width,
+        pstHeader->s32Height,
+        SDL_BITSPERPIXEL(pstHeader->u32Format),
+        pstHeader->u32Format);
+    if ((NULL == pstSurface) || (pstSurface->pitch != pstHeader->s32Pitch))
+    {
+        SDL_FreeSurface(pstSurface);
+        SDL_free(pu8File);
+        return NULL;
+    }
+
+    zSize = (uLongf)pstSurface->pitch * pstSurface->h;
+    if ((Z_OK != uncompress(
+             pstSurface->pixels,
+             &zSize,
+             pu8File + sizeof(struct AssetCacheHeader_t),
+             pstHeader->u32StoredSize)) ||
+        (zSize != (uLongf)pstSurface->pitch * pstSurface->h))
+    {
+        SDL_FreeSurface(pstSurface);
+        pstSurface = NULL;
+    }
+    SDL_free(pu8File);
+
+    return pstSurface;
+}
+
+static void _StoreCached(
+    const Asset *pstAsset,
+    uint64_t     u64SourceSize,
+    int64_t      s64SourceTime)
+{
+    char              acPath[ASSET_MAX_CACHE_PATH_LENGTH];
+    char              acTempPath[ASSET_MAX_CACHE_PATH_LENGTH];
+    AssetCacheHeader  stHeader;
+    SDL_Surface      *pstSurface = pstAsset->pstSurface;
+    SDL_RWops        *pstFile;
+    int8_t            s8Written;
+    uint8_t          *pu8Stored;
+    uLongf            zStoredSize;
+    uLong             zSize      = (uLong)pstSurface->pitch * pstSurface->h;
+
+    zStoredSize = compressBound(zSize);
+    pu8Stored   = AllocMemory(MEMORY_TAG_ASSET, zStoredSize);
+    if (NULL == pu8Stored)
+    {
+        LOG_ERROR("LoadAsset(): error allocating memory.");
+        return;
+    }
+
+    // Favour speed; the cache exists to make loading cheap.
+    if (Z_OK != compress2(pu8Stored, &zStoredSize, pstSurface->pixels, zSize, Z_BEST_SPEED))
+    {
+        FreeMemory(pu8Stored);
+        return;
+    }
+
+    memset(&stHeader, 0, sizeof(struct AssetCacheHeader_t));
+    memcpy(stHeader.acMagic, "BSTC", 4);
+    memcpy(stHeader.acFilename, pstAsset->acFilename, strlen(pstAsset->acFilename) + 1);
+    stHeader.u32Version    = ASSET_CACHE_VERSION;
+    stHeader.u32Format     = pstAsset->u32Format;
+    stHeader.s32Width      = pstSurface->w;
+    stHeader.s32Height     = pstSurface->h;
+    stHeader.s32Pitch      = pstSurface->pitch;
+    stHeader.u64SourceSize = u64SourceSize;
+    stHeader.s64SourceTime = s64SourceTime;
+    stHeader.u32StoredSize = zStoredSize;
+
+    // Written under a name of its own and renamed once complete, so
+    // neither a crash nor another instance leaves a torn file behind.
+    _GetCachePath(pstAsset, acPath);
+    snprintf(acTempPath, sizeof(acTempPath), "%s.%lu.tmp", acPath, SDL_ThreadID());
+
+    pstFile = SDL_RWFromFile(acTempPath, "wb");
+    if (NULL == pstFile)
+    {
+        FreeMemory(pu8Stored);
+        return;
+    }
+
+    s8Written =
+        (1 == SDL_RWwrite(pstFile, &stHeader, sizeof(struct AssetCacheHeader_t), 1)) &&
+        (1 == SDL_RWwrite(pstFile, pu8Stored, zStoredSize, 1));
+    s8Written = (0 == SDL_RWclose(pstFile)) && s8Written;
+    FreeMemory(pu8Stored);
+
+    #ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    if (s8Written)
+    {
+        remove(acPath);
+    }
+    #endif
+
+    if ((! s8Written) || (0 != rename(acTempPath, acPath)))
+    {
+        remove(acTempPath);
+    }
+}
+
+static SDL_Surface *_DecodeImage(const Asset *pstAsset)
+{
+    SDL_Surface *pstImage;
+    SDL_Surface *pstSurface;
+
+    pstImage = IMG_Load_RW(OpenPackFile(pstAsset->pstPack, pstAsset->acFilename), 1);
+    if (NULL == pstImage)
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return NULL;
+    }
+
+    // Converting here spares the renderer from doing it on upload.
+    pstSurface = SDL_ConvertSurfaceFormat(pstImage, pstAsset->u32Format, 0);
+    SDL_FreeSurface(pstImage);
+    if (NULL == pstSurface)
+    {
+        LOG_ERROR("%s", SDL_GetError());
+    }
+
+    return pstSurface;
+}
+
+static void _Decode(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    Asset    *pstAsset = (Asset *)pData;
+    uint64_t  u64Start = SDL_GetPerformanceCounter();
+    uint64_t  u64SourceSize;
+    int64_t   s64SourceTime;
+    uint8_t   u8UseCache;
+
+    (void)u32Begin;
+    (void)u32End;
+
+    u8UseCache =
+        (NULL != pstAsset->pacCacheDirectory) &&
+        (0 == StatPackFile(pstAsset->pstPack, pstAsset->acFilename, &u64SourceSize, &s64SourceTime));
+
+    if (u8UseCache)
+    {
+        pstAsset->pstSurface = _LoadCached(pstAsset, u64SourceSize, s64SourceTime);
+        pstAsset->u8IsCached = (NULL != pstAsset->pstSurface);
+    }
+
+    if (! pstAsset->u8IsCached)
+    {
+        pstAsset->pstSurface = _DecodeImage(pstAsset);
+        if (NULL == pstAsset->pstSurface)
+        {
+            _SetState(pstAsset, ASSET_FAILED);
+            return;
+        }
+    }
+
+    pstAsset->dLoadTime =
+        (double)(SDL_GetPerformanceCounter() - u64Start) * 1000 / SDL_GetPerformanceFrequency();
+    pstAsset->u32Bytes = pstAsset->pstSurface->pitch * pstAsset->pstSurface->h;
+
+    // Not part of the measured time, it only happens once.
+    if (u8UseCache && ! pstAsset->u8IsCached)
+    {
+        _StoreCached(pstAsset, u64SourceSize, s64SourceTime);
+    }
+
+    if (ASSET_SURFACE == pstAsset->u8Usage)
+    {
+        _SetState(pstAsset, ASSET_READY);
+    }
+    else
+    {
+        _SetState(pstAsset, ASSET_DECODED);
+    }
+}
+
+static void _Upload(AssetManager *pstAssets, Asset *pstAsset)
+{
+    SDL_Surface *pstSurface = pstAsset->pstSurface;
+
+    // The pixels already are in the format of the texture.
+    pstAsset->pstTexture = CreateTrackedTexture(
+        MEMORY_TAG_ASSET,
+        pstAssets->pstRenderer,
+        pstAsset->u32Format,
+        SDL_TEXTUREACCESS_STATIC,
+        pstSurface->w,
+        pstSurface->h);
+
+    if ((NULL == pstAsset->pstTexture) ||
+        (0 != SDL_UpdateTexture(pstAsset->pstTexture, NULL, pstSurface->pixels, pstSurface->pitch)))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        if (NULL != pstAsset->pstTexture)
+        {
+            DestroyTrackedTexture(pstAsset->pstTexture);
+            pstAsset->pstTexture = NULL;
+        }
+        SDL_FreeSurface(pstSurface);
+        pstAsset->pstSurface = NULL;
+        _SetState(pstAsset, ASSET_FAILED);
+        return;
+    }
+
+    if (SDL_ISPIXELFORMAT_ALPHA(pstAsset->u32Format))
+    {
+        SDL_SetTextureBlendMode(pstAsset->pstTexture, SDL_BLENDMODE_BLEND);
+    }
+
+    SDL_FreeSurface(pstSurface);
+    pstAsset->pstSurface = NULL;
+    _SetState(pstAsset, ASSET_READY);
+}
+
+/**
+ * @brief   Free AssetManager and all of its assets from memory.
+ *          Pending assets are waited for first.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @ingroup Asset
+ */
+void FreeAssetManager(AssetManager *pstAssets)
+{
+    if (NULL == pstAssets)
+    {
+        return;
+    }
+
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        Asset *pstAsset = &pstAssets->astAssets[u16Index];
+
+        if (NULL != pstAssets->pstJobs)
+        {
+            WaitForJobCounter(pstAssets->pstJobs, &pstAsset->stCounter);
+        }
+
+        if (NULL != pstAsset->pstSurface)
+        {
+            SDL_FreeSurface(pstAsset->pstSurface);
+        }
+
+        if (NULL != pstAsset->pstTexture)
+        {
+            DestroyTrackedTexture(pstAsset->pstTexture);
+        }
+    }
+    FreeMemory(pstAssets);
+}
+
+/**
+ * @brief   Get the state of an asset.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @param   s16Handle the handle returned by LoadAsset().
+ * @return  the state.  See @ref enum AssetState.
+ * @ingroup Asset
+ */
+uint8_t GetAssetState(AssetManager *pstAssets, int16_t s16Handle)
+{
+    Asset *pstAsset = _GetAsset(pstAssets, s16Handle);
+
+    if (NULL == pstAsset)
+    {
+        return ASSET_FAILED;
+    }
+
+    return _GetState(pstAsset);
+}
+
+/**
+ * @brief   Get the time spent loading the images which are ready.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @return  the statistics.  See @ref struct AssetStats.
+ * @ingroup Asset
+ */
+AssetStats GetAssetStats(AssetManager *pstAssets)
+{
+    AssetStats stStats;
+
+    memset(&stStats, 0, sizeof(struct AssetStats_t));
+
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        Asset *pstAsset = &pstAssets->astAssets[u16Index];
+
+        if (ASSET_READY != _GetState(pstAsset))
+        {
+            continue;
+        }
+
+        if (pstAsset->u8IsCached)
+        {
+            stStats.dCacheTime += pstAsset->dLoadTime;
+            stStats.u16Cached++;
+        }
+        else
+        {
+            stStats.dDecodeTime += pstAsset->dLoadTime;
+            stStats.u16Decoded++;
+        }
+    }
+
+    return stStats;
+}
+
+/**
+ * @brief   Get the surface of an asset loaded as ASSET_SURFACE.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @param   s16Handle the handle returned by LoadAsset().
+ * @return  the surface once the asset is ready, NULL otherwise.
+ * @ingroup Asset
+ */
+SDL_Surface *GetAssetSurface(AssetManager *pstAssets, int16_t s16Handle)
+{
+    Asset *pstAsset = _GetAsset(pstAssets, s16Handle);
+
+    if ((NULL == pstAsset) ||
+        (ASSET_SURFACE != pstAsset->u8Usage) ||
+        (ASSET_READY != _GetState(pstAsset)))
+    {
+        return NULL;
+    }
+
+    return pstAsset->pstSurface;
+}
+
+/**
+ * @brief   Get the texture of an asset.  A decoded asset is uploaded
+ *          right away, so this function must only be called from the
+ *          render thread.  It never waits for decoding.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @param   s16Handle the handle returned by LoadAsset().
+ * @return  the texture once the asset is ready, NULL otherwise.
+ * @ingroup Asset
+ */
+SDL_Texture *GetAssetTexture(AssetManager *pstAssets, int16_t s16Handle)
+{
+    Asset *pstAsset = _GetAsset(pstAssets, s16Handle);
+
+    if (NULL == pstAsset)
+    {
+        return NULL;
+    }
+
+    if (ASSET_DECODED == _GetState(pstAsset))
+    {
+        _Upload(pstAssets, pstAsset);
+    }
+
+    return pstAsset->pstTexture;
+}
+
+/**
+ * @brief   Initialise AssetManager.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstJobs     the JobSystem images are decoded on or NULL to
+ *                      decode them right away.
+ * @param   pstPack     the Pack images are read from or NULL to read
+ *                      them from the file system.
+ * @return  an AssetManager on success, NULL on failure.
+ * @ingroup Asset
+ */
+AssetManager *InitAssetManager(
+    SDL_Renderer *pstRenderer,
+    JobSystem    *pstJobs,
+    Pack         *pstPack)
+{
+    SDL_RendererInfo     stInfo;
+    static AssetManager *pstAssets;
+    pstAssets = AllocZeroedMemory(MEMORY_TAG_ASSET, 1, sizeof(struct AssetManager_t));
+    if (NULL == pstAssets)
+    {
+        LOG_ERROR("InitAssetManager(): error allocating memory.");
+        return NULL;
+    }
+
+    pstAssets->pstRenderer = pstRenderer;
+    pstAssets->pstJobs     = pstJobs;
+    pstAssets->pstPack     = pstPack;
+    pstAssets->u32Format   = SDL_PIXELFORMAT_ARGB8888;
+
+    /* The first format is the one the renderer handles best, but
+     * sprites and tiles need their alpha channel. */
+    if ((0 == SDL_GetRendererInfo(pstRenderer, &stInfo)) &&
+        (stInfo.num_texture_formats > 0) &&
+        (! SDL_ISPIXELFORMAT_FOURCC(stInfo.texture_formats[0])) &&
+        (SDL_ISPIXELFORMAT_ALPHA(stInfo.texture_formats[0])))
+    {
+        pstAssets->u32Format = stInfo.texture_formats[0];
+    }
+
+    // Initialise the decoder up front instead of racing on workers.
+    if (0 == (IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+    {
+        LOG_ERROR("%s", IMG_GetError());
+    }
+
+    return pstAssets;
+}
+
+/**
+ * @brief   Start loading an image.  Decoding runs on the JobSystem;
+ *          the returned handle can be used right away.
+ * @param   pstAssets   an AssetManager.  See @ref struct AssetManager.
+ * @param   pacFilename the filename of the image.
+ * @param   u8Usage     what to load the image as.  See @ref enum AssetUsage.
+ * @return  a handle on success, -1 on failure.
+ * @ingroup Asset
+ */
+int16_t LoadAsset(
+    AssetManager *pstAssets,
+    const char   *pacFilename,
+    uint8_t       u8Usage)
+{
+    Asset *pstAsset;
+
+    if (strlen(pacFilename) >= ASSET_MAX_PATH_LENGTH)
+    {
+        LOG_ERROR("LoadAsset(): filename too long: %s", pacFilename);
+        return -1;
+    }
+
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        if ((0 == strcmp(pacFilename, pstAssets->astAssets[u16Index].acFilename)) &&
+            (u8Usage == pstAssets->astAssets[u16Index].u8Usage))
+        {
+            return u16Index;
+        }
+    }
+
+    if (pstAssets->u16Count >= ASSET_MAX_ASSETS)
+    {
+        LOG_ERROR("LoadAsset(): too many assets.");
+        return -1;
+    }
+
+    pstAsset = &pstAssets->astAssets[pstAssets->u16Count];
+    memcpy(pstAsset->acFilename, pacFilename, strlen(pacFilename) + 1);
+    pstAsset->pstPack   = pstAssets->pstPack;
+    pstAsset->u8Usage   = u8Usage;
+    if ('\0' != pstAssets->acCacheDirectory[0])
+    {
+        pstAsset->pacCacheDirectory = pstAssets->acCacheDirectory;
+    }
+    pstAsset->u32Format = pstAssets->u32Format;
+    if (ASSET_SURFACE == u8Usage)
+    {
+        pstAsset->u32Format = SDL_PIXELFORMAT_ARGB8888;
+    }
+    _SetState(pstAsset, ASSET_PENDING);
+    pstAssets->u16Count++;
+
+    if (NULL == pstAssets->pstJobs)
+    {
+        _Decode(pstAsset, 0, 1);
+    }
+    else
+    {
+        RunJob(pstAssets->pstJobs, "DecodeAsset", _Decode, pstAsset, &pstAsset->stCounter);
+    }
+
+    return pstAssets->u16Count - 1;
+}
+
+/**
+ * @brief   Enable the texture cache.  Decoded images are stored in the
+ *          given directory and read back instead of being decoded
+ *          again, as long as their source files are unchanged.  Only
+ *          affects images loaded afterwards.
+ * @param   pstAssets    an AssetManager.  See @ref struct AssetManager.
+ * @param   pacDirectory the directory including the trailing path
+ *                       separator, e.g. as returned by SDL_GetPrefPath().
+ * @return  0 on success, -1 on failure.
+ * @ingroup Asset
+ */
+int8_t SetAssetCache(AssetManager *pstAssets, const char *pacDirectory)
+{
+    // Leave room for the suffix of the file written before renaming.
+    if (strlen(pacDirectory) + sizeof("00000000-00000000.tex.18446744073709551615.tmp") >
+        ASSET_MAX_CACHE_PATH_LENGTH)
+    {
+        LOG_ERROR("SetAssetCache(): path too long: %s", pacDirectory);
+        return -1;
+    }
+
+    memcpy(pstAssets->acCacheDirectory, pacDirectory, strlen(pacDirectory) + 1);
+
+    return 0;
+}
+
+/**
+ * @brief   Upload all decoded assets.  Has to be called once per frame,
+ *          so images which finish decoding in the background don't
+ *          wait for their first GetAssetTexture().  Must only be called
+ *          from the render thread.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @ingroup Asset
+ */
+void UploadAssets(AssetManager *pstAssets)
+{
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        GetAssetTexture(pstAssets, u16Index);
+    }
+}
+
+/**
+ * @brief   Wait until an asset is ready.  The calling thread helps
+ *          decoding in the meantime.  Must only be called from the
+ *          render thread.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @param   s16Handle the handle returned by LoadAsset().
+ * @return  0 on success, -1 on failure.
+ * @ingroup Asset
+ */
+int8_t WaitForAsset(AssetManager *pstAssets, int16_t s16Handle)
+{
+    Asset *pstAsset = _GetAsset(pstAssets, s16Handle);
+
+    if (NULL == pstAsset)
+    {
+        return -1;
+    }
+
+    if (NULL != pstAssets->pstJobs)
+    {
+        WaitForJobCounter(pstAssets->pstJobs, &pstAsset->stCounter);
+    }
+    GetAssetTexture(pstAssets, s16Handle);
+
+    if (ASSET_READY != _GetState(pstAsset))
+    {
+        LOG_ERROR("WaitForAsset(): couldn't load %s", pstAsset->acFilename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Wait until all assets are ready.  Must only be called from
+ *          the render thread.
+ * @param   pstAssets an AssetManager.  See @ref struct AssetManager.
+ * @return  0 on success, -1 if any asset failed to load.
+ * @ingroup Asset
+ */
+int8_t WaitForAssets(AssetManager *pstAssets)
+{
+    int8_t s8Status = 0;
+
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        if (-1 == WaitForAsset(pstAssets, u16Index))
+        {
+            s8Status = -1;
+        }
+    }
+
+    return s8Status;
+}
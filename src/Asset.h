@@ -0,0 +1,131 @@
+/**
+ * @file    Asset.h
+ * @ingroup Asset
+ */
+
+#ifndef _ASSET_H_
+#define _ASSET_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Job.h"
+#include "Pack.h"
+
+/**
+ * @ingroup Asset
+ */
+enum AssetLimits
+{
+    ASSET_MAX_ASSETS            = 64,
+    ASSET_MAX_PATH_LENGTH       = 128,
+    ASSET_MAX_CACHE_PATH_LENGTH = 256,
+    ASSET_CACHE_VERSION         = 1
+};
+
+/**
+ * @brief   What an image is loaded as.  An ASSET_SURFACE is decoded to
+ *          SDL_PIXELFORMAT_ARGB8888 and kept on the CPU instead of
+ *          being uploaded.
+ * @ingroup Asset
+ */
+enum AssetUsage
+{
+    ASSET_TEXTURE = 0,
+    ASSET_SURFACE = 1
+};
+
+/**
+ * @ingroup Asset
+ */
+enum AssetState
+{
+    ASSET_PENDING = 0,
+    ASSET_DECODED = 1,
+    ASSET_READY   = 2,
+    ASSET_FAILED  = 3
+};
+
+/**
+ * @brief   A single image.  pstSurface, dLoadTime, u32Bytes and
+ *          u8IsCached are written by the decoding job and only read
+ *          once stState is no longer ASSET_PENDING.
+ * @ingroup Asset
+ */
+typedef struct Asset_t
+{
+    char          acFilename[ASSET_MAX_PATH_LENGTH];
+    Pack         *pstPack;
+    const char   *pacCacheDirectory;
+    SDL_Surface  *pstSurface;
+    SDL_Texture  *pstTexture;
+    JobCounter    stCounter;
+    SDL_atomic_t  stState;
+    double        dLoadTime;
+    uint32_t      u32Bytes;
+    uint32_t      u32Format;
+    uint8_t       u8Usage;
+    uint8_t       u8IsCached;
+} Asset;
+
+/**
+ * @brief   Time spent loading images, in milliseconds, split into
+ *          images which had to be decoded and images which were read
+ *          from the texture cache.
+ * @ingroup Asset
+ */
+typedef struct AssetStats_t
+{
+    double   dDecodeTime;
+    double   dCacheTime;
+    uint16_t u16Decoded;
+    uint16_t u16Cached;
+} AssetStats;
+
+/**
+ * @brief   Images are decoded on the JobSystem and uploaded on the
+ *          render thread.  Assets are referred to by handle and live as
+ *          long as the AssetManager; loading the same file twice
+ *          returns the same handle.  Decoded pixels are optionally
+ *          kept in a texture cache on disk.
+ * @ingroup Asset
+ */
+typedef struct AssetManager_t
+{
+    Asset         astAssets[ASSET_MAX_ASSETS];
+    char          acCacheDirectory[ASSET_MAX_CACHE_PATH_LENGTH];
+    SDL_Renderer *pstRenderer;
+    JobSystem    *pstJobs;
+    Pack         *pstPack;
+    uint32_t      u32Format;
+    uint16_t      u16Count;
+} AssetManager;
+
+void FreeAssetManager(AssetManager *pstAssets);
+
+uint8_t GetAssetState(AssetManager *pstAssets, int16_t s16Handle);
+
+AssetStats GetAssetStats(AssetManager *pstAssets);
+
+SDL_Surface *GetAssetSurface(AssetManager *pstAssets, int16_t s16Handle);
+
+SDL_Texture *GetAssetTexture(AssetManager *pstAssets, int16_t s16Handle);
+
+AssetManager *InitAssetManager(
+    SDL_Renderer *pstRenderer,
+    JobSystem    *pstJobs,
+    Pack         *pstPack);
+
+int16_t LoadAsset(
+    AssetManager *pstAssets,
+    const char   *pacFilename,
+    uint8_t       u8Usage);
+
+int8_t SetAssetCache(AssetManager *pstAssets, const char *pacDirectory);
+
+void UploadAssets(AssetManager *pstAssets);
+
+int8_t WaitForAsset(AssetManager *pstAssets, int16_t s16Handle);
+
+int8_t WaitForAssets(AssetManager *pstAssets);
+
+#endif
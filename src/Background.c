@@ -2,170 +2,549 @@
  * @file      Background.c
  * @ingroup   Background
  * @defgroup  Background
- * @brief     A handler to manage parallax scrolling backgrounds.
+ * @brief     A handler to manage parallax scrolling backgrounds.  The
+ *            layers are read from an INI file, see
+ *            res/backgrounds/jungle.ini for an example.
  * @author    Michael Fitzmayer
  * @copyright "THE BEER-WARE LICENCE" (Revision 42)
  */
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Asset.h"
 #include "Background.h"
+#include "Log.h"
+#include "Macros.h"
+#include "Map.h"
+#include "Memory.h"
+#include "Pack.h"
+#include "RenderQueue.h"
+#include "inih/ini.h"
 
-static SDL_Texture *_RenderLayer(
-    SDL_Renderer  *pstRenderer,
-    const char    *pacFilename,
-    const int32_t  s32WindowWidth)
+/**
+ * @brief This structure carries the state of the INI parser between
+ * the calls of _Handler().
+ */
+typedef struct BackgroundParser_t
 {
-    SDL_Texture *pstImage       = NULL;
-    SDL_Texture *pstLayer       = NULL;
-    int32_t      s32ImageWidth  = 0;
-    int32_t      s32ImageHeight = 0;
-    int32_t      s32LayerHeight = 0;
-    int32_t      s32LayerWidth  = 0;
-    uint8_t      u8WidthFactor  = 0;
-
-    pstImage = IMG_LoadTexture(pstRenderer, pacFilename);
-    if (NULL == pstImage)
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return NULL;
+    Background   *pstBackground;
+    int8_t        s8Error;
+    char          acSection[64];
+} BackgroundParser;
+
+static int8_t _ReserveGeometry(Background *pstBackground, uint32_t u32Quads)
+{
+    SDL_Vertex *pstVertices;
+    int32_t    *ps32Indices;
+
+    if (u32Quads <= pstBackground->u32QuadCapacity)
+    {
+        return 0;
     }
 
-    if (0 != SDL_QueryTexture(pstImage, NULL, NULL, &s32ImageWidth, &s32ImageHeight))
+    pstVertices = ReallocMemory(MEMORY_TAG_BACKGROUND, pstBackground->pstVertices, u32Quads * 4 * sizeof(SDL_Vertex));
+    if (NULL == pstVertices)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstImage);
-        return NULL;
+        LOG_ERROR("DrawBackground(): error allocating memory.");
+        return -1;
     }
+    pstBackground->pstVertices = pstVertices;
 
-    u8WidthFactor  = ceil((double)s32WindowWidth / (double)s32ImageWidth);
-    s32LayerWidth  = s32ImageWidth * u8WidthFactor;
-    s32LayerHeight = s32ImageHeight;
-    pstLayer       = SDL_CreateTexture(
-        pstRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_TARGET,
-        s32LayerWidth,
-        s32LayerHeight);
+    ps32Indices = ReallocMemory(MEMORY_TAG_BACKGROUND, pstBackground->ps32Indices, u32Quads * 6 * sizeof(int32_t));
+    if (NULL == ps32Indices)
+    {
+        LOG_ERROR("DrawBackground(): error allocating memory.");
+        return -1;
+    }
+    pstBackground->ps32Indices = ps32Indices;
 
-    if (NULL == pstLayer)
+    // The index pattern of a quad strip never changes.
+    for (uint32_t u32Quad = pstBackground->u32QuadCapacity; u32Quad < u32Quads; u32Quad++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstImage);
-        return 0;
+        ps32Indices[u32Quad * 6 + 0] = u32Quad * 4 + 0;
+        ps32Indices[u32Quad * 6 + 1] = u32Quad * 4 + 1;
+        ps32Indices[u32Quad * 6 + 2] = u32Quad * 4 + 2;
+        ps32Indices[u32Quad * 6 + 3] = u32Quad * 4 + 2;
+        ps32Indices[u32Quad * 6 + 4] = u32Quad * 4 + 1;
+        ps32Indices[u32Quad * 6 + 5] = u32Quad * 4 + 3;
     }
+    pstBackground->u32QuadCapacity = u32Quads;
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, pstLayer))
+    return 0;
+}
+
+static int8_t _PushQuad(
+    Background *pstBackground,
+    float       fLeft,
+    float       fTop,
+    float       fRight,
+    float       fBottom,
+    SDL_FRect   stUV)
+{
+    const SDL_Color  stWhite = { 255, 255, 255, 255 };
+    SDL_Vertex      *pstVertex;
+
+    if (pstBackground->u32QuadCount == pstBackground->u32QuadCapacity)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
+        if (-1 == _ReserveGeometry(pstBackground, 2 * pstBackground->u32QuadCapacity + 4))
+        {
+            return -1;
+        }
     }
 
-    SDL_Rect stDst;
-    stDst.x = 0;
-    for (uint8_t u8Index = 0; u8Index < u8WidthFactor; u8Index++)
+    pstVertex = &pstBackground->pstVertices[pstBackground->u32QuadCount * 4];
+    pstBackground->u32QuadCount++;
+
+    for (uint8_t u8Index = 0; u8Index < 4; u8Index++)
     {
-        stDst.y  = 0;
-        stDst.w  = s32ImageWidth;
-        stDst.h  = s32ImageHeight;
-        SDL_RenderCopy(pstRenderer, pstImage, NULL, &stDst);
-        stDst.x += s32ImageWidth;
+        uint8_t u8Right  = u8Index & 1;
+        uint8_t u8Bottom = u8Index >> 1;
+
+        pstVertex[u8Index].position.x  = u8Right  ? fRight  : fLeft;
+        pstVertex[u8Index].position.y  = u8Bottom ? fBottom : fTop;
+        pstVertex[u8Index].color       = stWhite;
+        pstVertex[u8Index].tex_coord.x = stUV.x + u8Right  * stUV.w;
+        pstVertex[u8Index].tex_coord.y = stUV.y + u8Bottom * stUV.h;
     }
 
-    if (0 != SDL_SetTextureBlendMode(pstLayer, SDL_BLENDMODE_BLEND))
+    return 0;
+}
+
+/* Push a textured quad, leaving out every part of it that is hidden
+ * behind opaque map chunks.  See _BuildBands(). */
+static int8_t _PushClippedQuad(
+    Background *pstBackground,
+    SDL_FRect   stDst,
+    SDL_FRect   stUV,
+    uint8_t     u8Clip)
+{
+    if (! u8Clip)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
+        return _PushQuad(
+            pstBackground,
+            stDst.x,
+            stDst.y,
+            stDst.x + stDst.w,
+            stDst.y + stDst.h,
+            stUV);
     }
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, NULL))
+    for (uint16_t u16Band = 0; u16Band < pstBackground->u16BandCount; u16Band++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        SDL_DestroyTexture(pstLayer);
-        SDL_DestroyTexture(pstImage);
-        return NULL;
+        BackgroundBand *pstBand  = &pstBackground->pstBands[u16Band];
+        float           fLeft    = SDL_max(stDst.x, pstBand->fLeft);
+        float           fRight   = SDL_min(stDst.x + stDst.w, pstBand->fRight);
+        float           fBottom  = stDst.y + stDst.h;
+        float           fTop     = stDst.y;
+        SDL_FRect       stPart;
+
+        if (fLeft >= fRight)
+        {
+            continue;
+        }
+
+        stPart.x = stUV.x + (fLeft  - stDst.x) / stDst.w * stUV.w;
+        stPart.w = (fRight - fLeft) / stDst.w * stUV.w;
+
+        for (uint8_t u8Index = 0; u8Index <= pstBand->u8OccluderCount; u8Index++)
+        {
+            float fEnd = fBottom;
+
+            if (u8Index < pstBand->u8OccluderCount)
+            {
+                fEnd = SDL_min(pstBand->afTop[u8Index], fBottom);
+            }
+
+            if (fTop < fEnd)
+            {
+                stPart.y = stUV.y + (fTop - stDst.y) / stDst.h * stUV.h;
+                stPart.h = (fEnd - fTop) / stDst.h * stUV.h;
+
+                if (-1 == _PushQuad(pstBackground, fLeft, fTop, fRight, fEnd, stPart))
+                {
+                    return -1;
+                }
+            }
+
+            if (u8Index < pstBand->u8OccluderCount)
+            {
+                fTop = SDL_max(fTop, pstBand->afBottom[u8Index]);
+            }
+
+            if (fTop >= fBottom)
+            {
+                break;
+            }
+        }
     }
 
-    return pstLayer;
+    return 0;
 }
 
-/**
- * @brief   Draw Background on screen.
- * @param   pstRenderer     a SDL rendering context.  See @ref struct Video.
- * @param   pstBackground   the Background to render.  See @ref struct Background.
- * @param   dCameraPosX     camera position along the x-axis.
- * @param   dCameraPosY     camera position along the y-axis.
- * @return  0 on success, -1 on failure.
- * @ingroup Background
- */
-int8_t DrawBackground(
-    SDL_Renderer *pstRenderer,
-    Background   *pstBackground,
-    double        dCameraPosY)
+/* Split the viewport into vertical bands, one per map chunk column,
+ * and collect the screen spans of each band which are covered by
+ * opaque map tiles.  Anything drawn there would be overdrawn. */
+static int8_t _BuildBands(Background *pstBackground, const Map *pstMap)
 {
-    int32_t  s32Width = 0;
-    double   dPosXa;
-    double   dPosXb;
-    SDL_Rect stDst;
+    double  dChunkWidth;
+    double  dChunkHeight;
+    double  dOriginX;
+    double  dOriginY;
+    int32_t s32First;
+    int32_t s32Last;
 
-    if (0 != SDL_QueryTexture(pstBackground->pstLayer, NULL, NULL, &s32Width, NULL))
+    pstBackground->u16BandCount = 0;
+
+    if ((NULL == pstMap) || (NULL == pstMap->pstCoverage))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        s32First     = 0;
+        s32Last      = 0;
+        dChunkWidth  = pstBackground->s32ViewportWidth;
+        dChunkHeight = 0;
+        dOriginX     = 0;
+        dOriginY     = 0;
+    }
+    else
+    {
+        dChunkWidth  = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_width;
+        dChunkHeight = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_height;
+        dOriginX     = pstMap->dWorldPosX - floor(pstBackground->dCameraPosX);
+        dOriginY     = pstMap->dWorldPosY - floor(pstBackground->dCameraPosY);
+        s32First     = floor(-dOriginX / dChunkWidth);
+        s32Last      = floor((pstBackground->s32ViewportWidth - 1 - dOriginX) / dChunkWidth);
     }
 
-    if (pstBackground->dWorldPosX < -s32Width)
+    if (s32Last - s32First + 1 > pstBackground->u16BandCapacity)
     {
-        pstBackground->dWorldPosX = +s32Width;
+        uint16_t        u16Capacity = s32Last - s32First + 1;
+        BackgroundBand *pstBands    = ReallocMemory(
+            MEMORY_TAG_BACKGROUND,
+            pstBackground->pstBands,
+            u16Capacity * sizeof(struct BackgroundBand_t));
+
+        if (NULL == pstBands)
+        {
+            LOG_ERROR("DrawBackground(): error allocating memory.");
+            return -1;
+        }
+        pstBackground->pstBands        = pstBands;
+        pstBackground->u16BandCapacity = u16Capacity;
     }
 
-    if (pstBackground->dWorldPosX > +s32Width)
+    for (int32_t s32ChunkX = s32First; s32ChunkX <= s32Last; s32ChunkX++)
     {
-        pstBackground->dWorldPosX = -s32Width;
+        BackgroundBand *pstBand = &pstBackground->pstBands[pstBackground->u16BandCount];
+        pstBackground->u16BandCount++;
+
+        pstBand->fLeft           = SDL_max(0, dOriginX + s32ChunkX * dChunkWidth);
+        pstBand->fRight          = SDL_min(pstBackground->s32ViewportWidth, dOriginX + (s32ChunkX + 1) * dChunkWidth);
+        pstBand->u8OccluderCount = 0;
+
+        if ((NULL == pstMap) || (s32ChunkX < 0) || (s32ChunkX >= pstMap->u16ChunkCountX))
+        {
+            continue;
+        }
+
+        for (uint16_t u16ChunkY = 0; u16ChunkY < pstMap->u16ChunkCountY; u16ChunkY++)
+        {
+            const MapCoverage *pstCoverage = &pstMap->pstCoverage[
+                u16ChunkY * pstMap->u16ChunkCountX + s32ChunkX];
+            float              fTop;
+            float              fBottom;
+
+            if (pstCoverage->u8OpaqueTop == pstCoverage->u8OpaqueBottom)
+            {
+                continue;
+            }
+
+            fTop    = dOriginY + u16ChunkY * dChunkHeight + pstCoverage->u8OpaqueTop    * pstMap->pstTmxMap->tile_height;
+            fBottom = dOriginY + u16ChunkY * dChunkHeight + pstCoverage->u8OpaqueBottom * pstMap->pstTmxMap->tile_height;
+
+            // Merge spans which continue across chunk borders.
+            if ((pstBand->u8OccluderCount > 0) &&
+                (pstBand->afBottom[pstBand->u8OccluderCount - 1] == fTop))
+            {
+                pstBand->afBottom[pstBand->u8OccluderCount - 1] = fBottom;
+            }
+            else if (pstBand->u8OccluderCount < BACKGROUND_MAX_OCCLUDERS)
+            {
+                pstBand->afTop[pstBand->u8OccluderCount]    = fTop;
+                pstBand->afBottom[pstBand->u8OccluderCount] = fBottom;
+                pstBand->u8OccluderCount++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Submit the collected quads, either to the RenderQueue or, without
+ * one, directly.  Geometry is built in world pixels and only scaled to
+ * the logical size here, so the Camera zoom never affects the clipping
+ * or the composite. */
+static int8_t _SubmitGeometry(
+    SDL_Renderer  *pstRenderer,
+    RenderQueue   *pstQueue,
+    Background    *pstBackground,
+    SDL_Texture   *pstTexture,
+    SDL_BlendMode  eBlendMode,
+    uint16_t       u16Layer,
+    float          fScale)
+{
+    if (0 == pstBackground->u32QuadCount)
+    {
+        return 0;
+    }
+
+    if (1.f != fScale)
+    {
+        for (uint32_t u32Index = 0; u32Index < pstBackground->u32QuadCount * 4; u32Index++)
+        {
+            pstBackground->pstVertices[u32Index].position.x *= fScale;
+            pstBackground->pstVertices[u32Index].position.y *= fScale;
+        }
+    }
+
+    if (NULL != pstQueue)
+    {
+        return PushRenderQuads(
+            pstQueue,
+            u16Layer,
+            pstTexture,
+            eBlendMode,
+            pstBackground->pstVertices,
+            pstBackground->u32QuadCount);
+    }
+
+    if ((0 != SDL_SetTextureBlendMode(pstTexture, eBlendMode)) ||
+        (0 != SDL_RenderGeometry(
+            pstRenderer,
+            pstTexture,
+            pstBackground->pstVertices,
+            pstBackground->u32QuadCount * 4,
+            pstBackground->ps32Indices,
+            pstBackground->u32QuadCount * 6)))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    return 0;
+}
+
+static int32_t _Handler(
+    void       *pParser,
+    const char *pacSection,
+    const char *pacName,
+    const char *pacValue)
+{
+    BackgroundParser *pstParser     = (BackgroundParser *)pParser;
+    Background       *pstBackground = pstParser->pstBackground;
+    BackgroundLayer  *pstLayer;
+
+    // Every section starts a new layer.
+    if ((0 == pstBackground->u8LayerCount) ||
+        (0 != strncmp(pacSection, pstParser->acSection, sizeof(pstParser->acSection) - 1)))
+    {
+        BackgroundLayer *pstLayers;
+
+        if (UINT8_MAX == pstBackground->u8LayerCount)
+        {
+            LOG_ERROR("InitBackground(): too many layers.");
+            pstParser->s8Error = 1;
+            return 0;
+        }
+
+        pstLayers = ReallocMemory(
+            MEMORY_TAG_BACKGROUND,
+            pstBackground->pstLayers,
+            (pstBackground->u8LayerCount + 1) * sizeof(struct BackgroundLayer_t));
+        if (NULL == pstLayers)
+        {
+            LOG_ERROR("InitBackground(): error allocating memory.");
+            pstParser->s8Error = 1;
+            return 0;
+        }
+
+        pstBackground->pstLayers = pstLayers;
+        pstLayer                 = &pstLayers[pstBackground->u8LayerCount];
+        pstBackground->u8LayerCount++;
+
+        pstLayer->pstLayer       = NULL;
+        pstLayer->pacFilename    = NULL;
+        pstLayer->s16Asset       = -1;
+        pstLayer->s32Width       = 0;
+        pstLayer->s32Height      = 0;
+        pstLayer->u8Repeat       = 1;
+        pstLayer->dScrollFactorX = 1;
+        pstLayer->dScrollFactorY = 1;
+        pstLayer->dOffsetX       = 0;
+        pstLayer->dOffsetY       = 0;
+        pstLayer->dScrollPosX    = 0;
+        pstLayer->dDrawPosX      = 0;
+        pstLayer->dDrawPosY      = 0;
+
+        strncpy(pstParser->acSection, pacSection, sizeof(pstParser->acSection) - 1);
+        pstParser->acSection[sizeof(pstParser->acSection) - 1] = '\0';
     }
 
-    dPosXa = pstBackground->dWorldPosX;
-    if (dPosXa > 0)
+    pstLayer = &pstBackground->pstLayers[pstBackground->u8LayerCount - 1];
+
+    #define MATCH(pacN) strcmp(pacName, pacN) == 0
+
+    if      (MATCH("scrollX")) { pstLayer->dScrollFactorX = atof(pacValue); }
+    else if (MATCH("scrollY")) { pstLayer->dScrollFactorY = atof(pacValue); }
+    else if (MATCH("offsetX")) { pstLayer->dOffsetX       = atof(pacValue); }
+    else if (MATCH("offsetY")) { pstLayer->dOffsetY       = atof(pacValue); }
+    else if (MATCH("repeat"))  { pstLayer->u8Repeat       = atoi(pacValue) ? 1 : 0; }
+    else if (MATCH("image"))
     {
-        dPosXb = dPosXa - s32Width;
+        FreeMemory(pstLayer->pacFilename);
+        pstLayer->pacFilename = AllocMemory(MEMORY_TAG_BACKGROUND, strlen(pacValue) + 1);
+        if (NULL == pstLayer->pacFilename)
+        {
+            LOG_ERROR("InitBackground(): error allocating memory.");
+            pstParser->s8Error = 1;
+            return 0;
+        }
+        memcpy(pstLayer->pacFilename, pacValue, strlen(pacValue) + 1);
     }
     else
     {
-        dPosXb = dPosXa + s32Width;
+        LOG_ERROR("InitBackground(): unknown key '%s' in [%s].", pacName, pacSection);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int8_t _DrawLayers(
+    SDL_Renderer *pstRenderer,
+    RenderQueue  *pstQueue,
+    Background   *pstBackground,
+    uint16_t      u16Layer,
+    uint8_t       u8Clip,
+    float         fScale)
+{
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        BackgroundLayer *pstLayer = &pstBackground->pstLayers[u8Index];
+        const SDL_FRect  stUV     = { 0, 0, 1, 1 };
+        SDL_FRect        stDst;
+        uint32_t         u32Count = 1;
+
+        /* Repeated layers are drawn as one strip of image-sized quads
+         * covering the viewport, starting left of the screen edge. */
+        if (pstLayer->u8Repeat)
+        {
+            u32Count = ceil(
+                (pstBackground->s32ViewportWidth - pstLayer->dDrawPosX) /
+                pstLayer->s32Width);
+        }
+
+        stDst.x = pstLayer->dDrawPosX;
+        stDst.y = pstLayer->dDrawPosY;
+        stDst.w = pstLayer->s32Width;
+        stDst.h = pstLayer->s32Height;
+
+        pstBackground->u32QuadCount = 0;
+        for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+        {
+            if (-1 == _PushClippedQuad(pstBackground, stDst, stUV, u8Clip))
+            {
+                return -1;
+            }
+            stDst.x += pstLayer->s32Width;
+        }
+
+        if (-1 == _SubmitGeometry(
+                pstRenderer,
+                pstQueue,
+                pstBackground,
+                pstLayer->pstLayer,
+                SDL_BLENDMODE_BLEND,
+                u16Layer + u8Index,
+                fScale))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int8_t _RenderComposite(
+    SDL_Renderer *pstRenderer,
+    Background   *pstBackground)
+{
+    SDL_Texture *pstTarget = SDL_GetRenderTarget(pstRenderer);
+    int32_t      s32Width  = 0;
+    int32_t      s32Height = 0;
+    uint8_t      u8Red;
+    uint8_t      u8Green;
+    uint8_t      u8Blue;
+    uint8_t      u8Alpha;
+
+    if (NULL != pstBackground->pstComposite)
+    {
+        SDL_QueryTexture(pstBackground->pstComposite, NULL, NULL, &s32Width, &s32Height);
+        if ((s32Width  != pstBackground->s32ViewportWidth) ||
+            (s32Height != pstBackground->s32ViewportHeight))
+        {
+            DestroyTrackedTexture(pstBackground->pstComposite);
+            pstBackground->pstComposite = NULL;
+        }
     }
 
-    if (pstBackground->dVelocity > 0)
+    if (NULL == pstBackground->pstComposite)
     {
-        if ((pstBackground->u16Flags >> BACKGROUND_SCROLL_DIRECTION) & 1)
+        pstBackground->pstComposite = CreateTrackedTexture(
+            MEMORY_TAG_BACKGROUND,
+            pstRenderer,
+            SDL_PIXELFORMAT_ARGB8888,
+            SDL_TEXTUREACCESS_TARGET,
+            pstBackground->s32ViewportWidth,
+            pstBackground->s32ViewportHeight);
+
+        if (NULL == pstBackground->pstComposite)
         {
-            pstBackground->dWorldPosX -= pstBackground->dVelocity;
+            LOG_ERROR("%s", SDL_GetError());
+            return -1;
         }
-        else
+
+        // The composite is fully opaque, so it can be copied without blending.
+        if (0 != SDL_SetTextureBlendMode(pstBackground->pstComposite, SDL_BLENDMODE_NONE))
         {
-            pstBackground->dWorldPosX += pstBackground->dVelocity;
+            LOG_ERROR("%s", SDL_GetError());
+            return -1;
         }
     }
 
-    stDst.x = dPosXa;
-    stDst.y = pstBackground->dWorldPosY - dCameraPosY;
-    stDst.w = s32Width;
-    stDst.h = pstBackground->s32Height;
+    if (0 != SDL_SetRenderTarget(pstRenderer, pstBackground->pstComposite))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
 
-    if (-1 == SDL_RenderCopyEx(pstRenderer, pstBackground->pstLayer, NULL, &stDst, 0, NULL, SDL_FLIP_NONE))
+    // Clear with the colour the screen is cleared with, opaque.
+    SDL_GetRenderDrawColor(pstRenderer, &u8Red, &u8Green, &u8Blue, &u8Alpha);
+    SDL_SetRenderDrawColor(pstRenderer, u8Red, u8Green, u8Blue, 255);
+    SDL_RenderClear(pstRenderer);
+    SDL_SetRenderDrawColor(pstRenderer, u8Red, u8Green, u8Blue, u8Alpha);
+
+    if (-1 == _DrawLayers(pstRenderer, NULL, pstBackground, 0, 0, 1.f))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
+        SDL_SetRenderTarget(pstRenderer, pstTarget);
         return -1;
     }
 
-    stDst.x = dPosXb;
-    if (-1 == SDL_RenderCopyEx(pstRenderer, pstBackground->pstLayer, NULL, &stDst, 0, NULL, SDL_FLIP_NONE))
+    if (0 != SDL_SetRenderTarget(pstRenderer, pstTarget))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
+        LOG_ERROR("%s", SDL_GetError());
         return -1;
     }
 
@@ -173,54 +552,324 @@ int8_t DrawBackground(
 }
 
 /**
- * @brief   Initialise Background.
- * @param   pstRenderer    a SDL rendering context.  See @ref struct Video.
- * @param   pacFilename    the filename of the image.
- * @param   s32WindowWidth the width of the window.  See @ref struct Video.
+ * @brief   Draw Background on screen.  All layers are pushed to the
+ *          RenderQueue from back to front.  While the layer offsets do
+ *          not change, the layers are composited once into a
+ *          viewport-sized texture which is then reused with a single
+ *          opaque copy per frame.
+ * @param   pstRenderer   a SDL rendering context.  See @ref struct Video.
+ * @param   pstQueue      the RenderQueue.  See @ref struct RenderQueue.
+ * @param   pstBackground the Background to render.  See @ref struct Background.
+ * @param   pstMap        the Map drawn on top of the Background or NULL.
+ *                        Spans hidden behind its opaque chunks are not
+ *                        drawn.  See @ref struct Map.
+ * @param   u16Layer      the render layer of the first Background layer;
+ *                        the others follow.  See @ref struct Scene.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Background
+ */
+int8_t DrawBackground(
+    SDL_Renderer   *pstRenderer,
+    RenderQueue    *pstQueue,
+    Background     *pstBackground,
+    const Map      *pstMap,
+    const uint16_t  u16Layer)
+{
+    const SDL_FRect stUV              = { 0, 0, 1, 1 };
+    SDL_FRect       stDst;
+    uint8_t         u8HasChanged = 0;
+
+    // The viewport is taken over from the Camera by UpdateBackground().
+    if (FLAG_IS_SET(pstBackground->u16Flags, BACKGROUND_VIEWPORT_HAS_CHANGED))
+    {
+        FLAG_CLEAR(pstBackground->u16Flags, BACKGROUND_VIEWPORT_HAS_CHANGED);
+        u8HasChanged = 1;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        BackgroundLayer *pstLayer = &pstBackground->pstLayers[u8Index];
+        double           dPosX    = pstLayer->dOffsetX - pstLayer->dScrollPosX;
+        double           dPosY;
+
+        dPosY =
+            pstBackground->dWorldPosY + pstLayer->dOffsetY -
+            (pstBackground->dCameraPosY * pstLayer->dScrollFactorY);
+
+        if (pstLayer->u8Repeat)
+        {
+            dPosX = fmod(dPosX, pstLayer->s32Width);
+            if (dPosX > 0)
+            {
+                dPosX -= pstLayer->s32Width;
+            }
+        }
+
+        // Snap to whole pixels so an idle camera yields stable offsets.
+        dPosX = floor(dPosX);
+        dPosY = floor(dPosY);
+
+        if ((dPosX != pstLayer->dDrawPosX) || (dPosY != pstLayer->dDrawPosY))
+        {
+            pstLayer->dDrawPosX = dPosX;
+            pstLayer->dDrawPosY = dPosY;
+            u8HasChanged        = 1;
+        }
+    }
+
+    if (-1 == _BuildBands(pstBackground, pstMap))
+    {
+        return -1;
+    }
+
+    if (u8HasChanged)
+    {
+        /* The camera is moving: draw the layers directly.  Recomposing
+         * every frame would only add another full-screen pass. */
+        FLAG_CLEAR(pstBackground->u16Flags, BACKGROUND_COMPOSITE_IS_VALID);
+        return _DrawLayers(pstRenderer, pstQueue, pstBackground, u16Layer, 1, pstBackground->fScale);
+    }
+
+    if (FLAG_IS_NOT_SET(pstBackground->u16Flags, BACKGROUND_COMPOSITE_IS_VALID))
+    {
+        if (-1 == _RenderComposite(pstRenderer, pstBackground))
+        {
+            return _DrawLayers(pstRenderer, pstQueue, pstBackground, u16Layer, 1, pstBackground->fScale);
+        }
+        FLAG_SET(pstBackground->u16Flags, BACKGROUND_COMPOSITE_IS_VALID);
+    }
+
+    // The composite is complete; only its visible spans are copied.
+    stDst.x = 0;
+    stDst.y = 0;
+    stDst.w = pstBackground->s32ViewportWidth;
+    stDst.h = pstBackground->s32ViewportHeight;
+
+    pstBackground->u32QuadCount = 0;
+    if (-1 == _PushClippedQuad(pstBackground, stDst, stUV, 1))
+    {
+        return -1;
+    }
+
+    return _SubmitGeometry(
+        pstRenderer,
+        pstQueue,
+        pstBackground,
+        pstBackground->pstComposite,
+        SDL_BLENDMODE_NONE,
+        u16Layer,
+        pstBackground->fScale);
+}
+
+/**
+ * @brief   Free Background from memory.
+ * @param   pstBackground a Background.  See @ref struct Background.
+ * @ingroup Background
+ */
+void FreeBackground(Background *pstBackground)
+{
+    if (NULL == pstBackground)
+    {
+        return;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        FreeMemory(pstBackground->pstLayers[u8Index].pacFilename);
+    }
+    if (NULL != pstBackground->pstComposite)
+    {
+        DestroyTrackedTexture(pstBackground->pstComposite);
+    }
+    FreeMemory(pstBackground->pstLayers);
+    FreeMemory(pstBackground->pstVertices);
+    FreeMemory(pstBackground->ps32Indices);
+    FreeMemory(pstBackground->pstBands);
+    FreeMemory(pstBackground);
+}
+
+/**
+ * @brief   Initialise Background.  All layers are requested from the
+ *          AssetManager first and waited for afterwards, so they are
+ *          decoded in parallel.
+ * @param   pstAssets   the AssetManager.  See @ref struct AssetManager.
+ * @param   pacFilename the filename of the layer configuration.
  * @return  a Background on success, NULL on failure.
  * @ingroup Background
  */
 Background *InitBackground(
-    SDL_Renderer *pstRenderer,
-    const char   *pacFilename,
-    int32_t       s32WindowWidth)
+    AssetManager *pstAssets,
+    const char   *pacFilename)
 {
+    BackgroundParser   stParser;
+    int32_t            s32Status;
     static Background *pstBackground;
-    pstBackground = malloc(sizeof(struct Background_t));
+    pstBackground = AllocMemory(MEMORY_TAG_BACKGROUND, sizeof(struct Background_t));
 
     if (NULL == pstBackground)
     {
-        fprintf(stderr, "InitBackground(): error allocating memory.\n");
+        LOG_ERROR("InitBackground(): error allocating memory.");
         return NULL;
     }
 
-    pstBackground->u16Flags = 0;
-    pstBackground->pstLayer = _RenderLayer(
-        pstRenderer,
-        pacFilename,
-        s32WindowWidth);
+    pstBackground->pstLayers         = NULL;
+    pstBackground->pstComposite      = NULL;
+    pstBackground->pstVertices       = NULL;
+    pstBackground->ps32Indices       = NULL;
+    pstBackground->pstBands          = NULL;
+    pstBackground->u32QuadCount      = 0;
+    pstBackground->u32QuadCapacity   = 0;
+    pstBackground->u16BandCount      = 0;
+    pstBackground->u16BandCapacity   = 0;
+    pstBackground->u8LayerCount      = 0;
+    pstBackground->u16Flags          = 0;
+    pstBackground->s32Height         = 0;
+    pstBackground->dWorldPosY        = 0;
+    pstBackground->dCameraPosX       = 0;
+    pstBackground->dCameraPosY       = 0;
+    pstBackground->s32ViewportWidth  = 0;
+    pstBackground->s32ViewportHeight = 0;
+    pstBackground->fScale            = 1.f;
+
+    stParser.pstBackground = pstBackground;
+    stParser.s8Error       = 0;
+    stParser.acSection[0]  = '\0';
+
+    s32Status = ParsePackIni(pstAssets->pstPack, pacFilename, _Handler, &stParser);
+    if (0 > s32Status)
+    {
+        LOG_ERROR("Couldn't load background configuration: %s", pacFilename);
+        FreeBackground(pstBackground);
+        return NULL;
+    }
 
-    if (NULL == pstBackground->pstLayer)
+    // A positive status is the first line the handler rejected.
+    if (0 < s32Status)
     {
-        free(pstBackground);
+        LOG_ERROR("InitBackground(): error in %s on line %ld.", pacFilename, (long)s32Status);
+        FreeBackground(pstBackground);
         return NULL;
     }
 
-    if (0 != SDL_QueryTexture(
-            pstBackground->pstLayer,
-            NULL,
-            NULL,
-            &pstBackground->s32Width,
-            &pstBackground->s32Height))
+    if (stParser.s8Error)
     {
-        fprintf(stderr, "InitBackground(): Couldn't query SDL_Texture.\n");
-        free(pstBackground);
+        FreeBackground(pstBackground);
         return NULL;
     }
 
-    pstBackground->dWorldPosX = 0;
-    pstBackground->dWorldPosY = 0;
-    pstBackground->dVelocity  = 0;
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        BackgroundLayer *pstLayer = &pstBackground->pstLayers[u8Index];
+
+        if (NULL == pstLayer->pacFilename)
+        {
+            LOG_ERROR("InitBackground(): layer %u has no image.", u8Index);
+            FreeBackground(pstBackground);
+            return NULL;
+        }
+
+        pstLayer->s16Asset = LoadAsset(pstAssets, pstLayer->pacFilename, ASSET_TEXTURE);
+        if (-1 == pstLayer->s16Asset)
+        {
+            FreeBackground(pstBackground);
+            return NULL;
+        }
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        BackgroundLayer *pstLayer = &pstBackground->pstLayers[u8Index];
+
+        if (-1 == WaitForAsset(pstAssets, pstLayer->s16Asset))
+        {
+            FreeBackground(pstBackground);
+            return NULL;
+        }
+        pstLayer->pstLayer = GetAssetTexture(pstAssets, pstLayer->s16Asset);
+
+        if (0 != SDL_SetTextureBlendMode(pstLayer->pstLayer, SDL_BLENDMODE_BLEND))
+        {
+            LOG_ERROR("%s", SDL_GetError());
+            FreeBackground(pstBackground);
+            return NULL;
+        }
+
+        // Cache the layer dimensions once; they never change.
+        if (0 != SDL_QueryTexture(
+                pstLayer->pstLayer,
+                NULL,
+                NULL,
+                &pstLayer->s32Width,
+                &pstLayer->s32Height))
+        {
+            LOG_ERROR("InitBackground(): Couldn't query SDL_Texture.");
+            FreeBackground(pstBackground);
+            return NULL;
+        }
+
+        if (pstLayer->s32Height > pstBackground->s32Height)
+        {
+            pstBackground->s32Height = pstLayer->s32Height;
+        }
+    }
 
     return pstBackground;
 }
+
+/**
+ * @brief   Update Background.  The scroll position of each layer is
+ *          derived from the camera movement since the last call;
+ *          jumps wider than the viewport are ignored.  This function
+ *          has to be called every frame after UpdateCamera().
+ * @param   pstBackground a Background.  See @ref struct Background.
+ * @param   pstCamera     the Camera.  See @ref struct Camera.
+ * @ingroup Background
+ */
+void UpdateBackground(
+    Background   *pstBackground,
+    const Camera *pstCamera)
+{
+    int32_t s32ViewportWidth  = ceil(pstCamera->dViewportWidth);
+    int32_t s32ViewportHeight = ceil(pstCamera->dViewportHeight);
+    double  dDeltaX           = 0;
+
+    if (FLAG_IS_SET(pstBackground->u16Flags, BACKGROUND_CAMERA_IS_SET))
+    {
+        dDeltaX = pstCamera->dPosX - pstBackground->dCameraPosX;
+
+        /* The camera snaps to targets which have been teleported, e.g.
+         * across the map border; that is no movement to scroll by. */
+        if (fabs(dDeltaX) > pstCamera->dViewportWidth)
+        {
+            dDeltaX = 0;
+        }
+    }
+    FLAG_SET(pstBackground->u16Flags, BACKGROUND_CAMERA_IS_SET);
+    pstBackground->dCameraPosX = pstCamera->dPosX;
+    pstBackground->dCameraPosY = pstCamera->dPosY;
+    pstBackground->fScale      = pstCamera->dScale;
+
+    if ((s32ViewportWidth  != pstBackground->s32ViewportWidth) ||
+        (s32ViewportHeight != pstBackground->s32ViewportHeight))
+    {
+        pstBackground->s32ViewportWidth  = s32ViewportWidth;
+        pstBackground->s32ViewportHeight = s32ViewportHeight;
+        FLAG_SET(pstBackground->u16Flags, BACKGROUND_VIEWPORT_HAS_CHANGED);
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstBackground->u8LayerCount; u8Index++)
+    {
+        BackgroundLayer *pstLayer = &pstBackground->pstLayers[u8Index];
+
+        pstLayer->dScrollPosX += dDeltaX * pstLayer->dScrollFactorX;
+
+        if (pstLayer->u8Repeat)
+        {
+            pstLayer->dScrollPosX = fmod(pstLayer->dScrollPosX, pstLayer->s32Width);
+            if (pstLayer->dScrollPosX < 0)
+            {
+                pstLayer->dScrollPosX += pstLayer->s32Width;
+            }
+        }
+    }
+}
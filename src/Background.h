@@ -8,38 +8,104 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include "Asset.h"
+#include "Camera.h"
+#include "Map.h"
+#include "RenderQueue.h"
+
+/**
+ * @ingroup Background
+ */
+enum BackgroundLimits
+{
+    BACKGROUND_MAX_OCCLUDERS = 4
+};
 
 /**
  * @ingroup Background
  */
 enum BackgroundFlags
 {
-    BACKGROUND_SCROLL_DIRECTION = 0
+    BACKGROUND_CAMERA_IS_SET        = 0,
+    BACKGROUND_COMPOSITE_IS_VALID   = 1,
+    BACKGROUND_VIEWPORT_HAS_CHANGED = 2
 };
 
 /**
- * @file    Background.h
+ * @brief   pstLayer is owned by the AssetManager.
  * @ingroup Background
  */
-typedef struct Background_t
+typedef struct BackgroundLayer_t
 {
     SDL_Texture *pstLayer;
-    uint16_t     u16Flags;
+    char        *pacFilename;
+    int16_t      s16Asset;
     int32_t      s32Width;
     int32_t      s32Height;
-    double       dWorldPosX;
-    double       dWorldPosY;
-    double       dVelocity;
+    uint8_t      u8Repeat;
+    double       dScrollFactorX;
+    double       dScrollFactorY;
+    double       dOffsetX;
+    double       dOffsetY;
+    double       dScrollPosX;
+    double       dDrawPosX;
+    double       dDrawPosY;
+} BackgroundLayer;
+
+/**
+ * @brief   A vertical band of the viewport and the spans of it which are
+ *          covered by opaque map tiles, in screen coordinates.
+ * @ingroup Background
+ */
+typedef struct BackgroundBand_t
+{
+    float   fLeft;
+    float   fRight;
+    uint8_t u8OccluderCount;
+    float   afTop[BACKGROUND_MAX_OCCLUDERS];
+    float   afBottom[BACKGROUND_MAX_OCCLUDERS];
+} BackgroundBand;
+
+/**
+ * @ingroup Background
+ */
+typedef struct Background_t
+{
+    BackgroundLayer *pstLayers;
+    SDL_Texture     *pstComposite;
+    SDL_Vertex      *pstVertices;
+    int32_t         *ps32Indices;
+    BackgroundBand  *pstBands;
+    uint32_t         u32QuadCount;
+    uint32_t         u32QuadCapacity;
+    uint16_t         u16BandCount;
+    uint16_t         u16BandCapacity;
+    uint8_t          u8LayerCount;
+    uint16_t         u16Flags;
+    int32_t          s32Height;
+    int32_t          s32ViewportWidth;
+    int32_t          s32ViewportHeight;
+    float            fScale;
+    double           dWorldPosY;
+    double           dCameraPosX;
+    double           dCameraPosY;
 } Background;
 
 int8_t DrawBackground(
-    SDL_Renderer *pstRenderer,
-    Background   *pstBackground,
-    double        dCameraPosY);
+    SDL_Renderer   *pstRenderer,
+    RenderQueue    *pstQueue,
+    Background     *pstBackground,
+    const Map      *pstMap,
+    const uint16_t  u16Layer);
+
+void FreeBackground(Background *pstBackground);
 
 Background *InitBackground(
-    SDL_Renderer *pstRenderer,
-    const char   *pacFilename,
-    int32_t       s32WindowWidth);
+    AssetManager *pstAssets,
+    const char   *pacFilename);
+
+void UpdateBackground(
+    Background   *pstBackground,
+    const Camera *pstCamera);
 
 #endif
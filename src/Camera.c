@@ -0,0 +1,248 @@
+/**
+ * @file      Camera.c
+ * @ingroup   Camera
+ * @defgroup  Camera
+ * @brief     Camera handler.  Follows a target with a deadzone and
+ *            smoothing, keeps the view inside the map and publishes
+ *            the visible area once per frame.  Zooming does not touch
+ *            the renderer: the logical size stays fixed and everything
+ *            is scaled by dScale when it is drawn.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "AABB.h"
+#include "Camera.h"
+#include "Log.h"
+#include "Macros.h"
+#include "Memory.h"
+#include "Video.h"
+#include "tmx/tmx.h"
+
+static double _Follow(
+    double dCenter,
+    double dTarget,
+    double dDeadzone,
+    double dViewport,
+    double dSmoothing,
+    double dDeltaTime)
+{
+    double dDistance = dTarget - dCenter;
+    double dDesired  = dCenter;
+
+    // Snap to targets which have been teleported, e.g. across the map border.
+    if (fabs(dDistance) > dViewport)
+    {
+        return dTarget;
+    }
+
+    if (dDistance > dDeadzone / 2)
+    {
+        dDesired = dTarget - dDeadzone / 2;
+    }
+    else if (dDistance < -dDeadzone / 2)
+    {
+        dDesired = dTarget + dDeadzone / 2;
+    }
+
+    if (dSmoothing <= 0)
+    {
+        return dDesired;
+    }
+
+    // Frame rate independent exponential approach.
+    return dCenter + (dDesired - dCenter) * (1 - exp(-dSmoothing * dDeltaTime));
+}
+
+static double _Clamp(double dCenter, double dViewport, uint32_t u32Bounds)
+{
+    if (dCenter > u32Bounds - dViewport / 2)
+    {
+        dCenter = u32Bounds - dViewport / 2;
+    }
+
+    if (dCenter < dViewport / 2)
+    {
+        dCenter = dViewport / 2;
+    }
+
+    return dCenter;
+}
+
+static void _UpdateVisibleArea(Camera *pstCamera)
+{
+    double dFirstColumn;
+    double dLastColumn;
+    double dFirstRow;
+    double dLastRow;
+
+    /* dScale maps world pixels to the part of the logical size which
+     * is drawn to, dPixelScale to actual output pixels.  The resolution
+     * scale shrinks what is drawn but not what is visible. */
+    pstCamera->dScale          = pstCamera->dZoomLevel / pstCamera->dLogicalZoomLevel;
+    pstCamera->dViewportWidth  = pstCamera->s32LogicalWidth  / pstCamera->dScale;
+    pstCamera->dViewportHeight = pstCamera->s32LogicalHeight / pstCamera->dScale;
+    pstCamera->dScale         *= pstCamera->dResolutionScale;
+    pstCamera->dPixelScale     = pstCamera->dScale * pstCamera->dOutputScale;
+    pstCamera->dCenterX        = _Clamp(pstCamera->dCenterX, pstCamera->dViewportWidth,  pstCamera->u32BoundsWidth);
+    pstCamera->dCenterY        = _Clamp(pstCamera->dCenterY, pstCamera->dViewportHeight, pstCamera->u32BoundsHeight);
+    pstCamera->dPosX           = pstCamera->dCenterX - pstCamera->dViewportWidth  / 2;
+    pstCamera->dPosY           = pstCamera->dCenterY - pstCamera->dViewportHeight / 2;
+
+    pstCamera->stVisible.dLeft   = pstCamera->dPosX;
+    pstCamera->stVisible.dTop    = pstCamera->dPosY;
+    pstCamera->stVisible.dRight  = pstCamera->dPosX + pstCamera->dViewportWidth;
+    pstCamera->stVisible.dBottom = pstCamera->dPosY + pstCamera->dViewportHeight;
+
+    dFirstColumn = floor(pstCamera->stVisible.dLeft   / pstCamera->u32TileWidth);
+    dLastColumn  = ceil(pstCamera->stVisible.dRight   / pstCamera->u32TileWidth)  - 1;
+    dFirstRow    = floor(pstCamera->stVisible.dTop    / pstCamera->u32TileHeight);
+    dLastRow     = ceil(pstCamera->stVisible.dBottom  / pstCamera->u32TileHeight) - 1;
+
+    if (dFirstColumn < 0)                           { dFirstColumn = 0;                           }
+    if (dFirstRow    < 0)                           { dFirstRow    = 0;                           }
+    if (dLastColumn  > pstCamera->u32MapWidth  - 1) { dLastColumn  = pstCamera->u32MapWidth  - 1; }
+    if (dLastRow     > pstCamera->u32MapHeight - 1) { dLastRow     = pstCamera->u32MapHeight - 1; }
+
+    pstCamera->stTiles.u32FirstColumn = dFirstColumn;
+    pstCamera->stTiles.u32LastColumn  = dLastColumn;
+    pstCamera->stTiles.u32FirstRow    = dFirstRow;
+    pstCamera->stTiles.u32LastRow     = dLastRow;
+}
+
+/**
+ * @brief   Initialise Camera.
+ * @param   pstVideo   Video.  See @ref struct Video.
+ * @param   pstTmxMap  the TMX map the Camera is bound to.  See @ref struct Map.
+ * @param   dZoomLevel the initial zoom level.
+ * @return  a Camera on success, NULL on failure.
+ * @ingroup Camera
+ */
+Camera *InitCamera(
+    const Video   *pstVideo,
+    const tmx_map *pstTmxMap,
+    const double   dZoomLevel)
+{
+    static Camera *pstCamera;
+    pstCamera = AllocMemory(MEMORY_TAG_CAMERA, sizeof(struct Camera_t));
+    if (NULL == pstCamera)
+    {
+        LOG_ERROR("InitCamera(): error allocating memory.");
+        return NULL;
+    }
+
+    pstCamera->dZoomLevel        = dZoomLevel;
+    pstCamera->dZoomLevelInitial = dZoomLevel;
+    pstCamera->dDeadzoneWidth    = 0;
+    pstCamera->dDeadzoneHeight   = 0;
+    pstCamera->dSmoothing        = 0;
+    pstCamera->dResolutionScale  = 1;
+    pstCamera->u16Flags          = 0;
+    pstCamera->dCenterX          = 0;
+    pstCamera->dCenterY          = 0;
+    pstCamera->s32LogicalWidth   = pstVideo->s32LogicalWidth;
+    pstCamera->s32LogicalHeight  = pstVideo->s32LogicalHeight;
+    pstCamera->dLogicalZoomLevel = pstVideo->dZoomLevel;
+    pstCamera->dOutputScale      = pstVideo->dOutputScale;
+    pstCamera->u32BoundsWidth    = pstTmxMap->width  * pstTmxMap->tile_width;
+    pstCamera->u32BoundsHeight   = pstTmxMap->height * pstTmxMap->tile_height;
+    pstCamera->u32TileWidth      = pstTmxMap->tile_width;
+    pstCamera->u32TileHeight     = pstTmxMap->tile_height;
+    pstCamera->u32MapWidth       = pstTmxMap->width;
+    pstCamera->u32MapHeight      = pstTmxMap->height;
+
+    _UpdateVisibleArea(pstCamera);
+
+    return pstCamera;
+}
+
+/**
+ * @brief   Check whether a bounding box is inside the visible area.
+ * @param   pstCamera a Camera.  See @ref struct Camera.
+ * @param   stBox     a bounding box in world coordinates.
+ * @return  1 if the box is visible, 0 if not.
+ * @ingroup Camera
+ */
+uint8_t IsCameraVisible(const Camera *pstCamera, AABB stBox)
+{
+    return AreIntersecting(pstCamera->stVisible, stBox);
+}
+
+/**
+ * @brief   Set Camera resolution scale, i.e. the fraction of the render
+ *          target which is drawn to.  See @ref struct VideoResolution.
+ * @param   pstCamera        a Camera.  See @ref struct Camera.
+ * @param   dResolutionScale the resolution scale.
+ * @ingroup Camera
+ */
+void SetCameraResolutionScale(Camera *pstCamera, double dResolutionScale)
+{
+    pstCamera->dResolutionScale = dResolutionScale;
+    _UpdateVisibleArea(pstCamera);
+}
+
+/**
+ * @brief   Set Camera zoom level.  The zoom level is clamped to
+ *          VIDEO_MIN_ZOOMLEVEL and VIDEO_MAX_ZOOMLEVEL and the visible
+ *          area is updated immediately.  This is pure arithmetic and
+ *          can be called every frame.
+ * @param   pstCamera  a Camera.  See @ref struct Camera.
+ * @param   dZoomLevel the zoom level.
+ * @ingroup Camera
+ */
+void SetCameraZoomLevel(Camera *pstCamera, double dZoomLevel)
+{
+    if (dZoomLevel <= VIDEO_MIN_ZOOMLEVEL) dZoomLevel = VIDEO_MIN_ZOOMLEVEL;
+    if (dZoomLevel >= VIDEO_MAX_ZOOMLEVEL) dZoomLevel = VIDEO_MAX_ZOOMLEVEL;
+
+    pstCamera->dZoomLevel = dZoomLevel;
+    _UpdateVisibleArea(pstCamera);
+}
+
+/**
+ * @brief   Update Camera.  This function has to be called every frame
+ *          before anything is drawn.
+ * @param   pstCamera   a Camera.  See @ref struct Camera.
+ * @param   dTargetPosX the position to follow along the x-axis.
+ * @param   dTargetPosY the position to follow along the y-axis.
+ * @param   dDeltaTime  time since last frame in seconds.
+ * @ingroup Camera
+ */
+void UpdateCamera(
+    Camera *pstCamera,
+    double  dTargetPosX,
+    double  dTargetPosY,
+    double  dDeltaTime)
+{
+    // Start right at the target instead of gliding in from the origin.
+    if (FLAG_IS_NOT_SET(pstCamera->u16Flags, CAMERA_IS_SET))
+    {
+        FLAG_SET(pstCamera->u16Flags, CAMERA_IS_SET);
+        pstCamera->dCenterX = dTargetPosX;
+        pstCamera->dCenterY = dTargetPosY;
+        _UpdateVisibleArea(pstCamera);
+        return;
+    }
+
+    pstCamera->dCenterX = _Follow(
+        pstCamera->dCenterX,
+        dTargetPosX,
+        pstCamera->dDeadzoneWidth,
+        pstCamera->dViewportWidth,
+        pstCamera->dSmoothing,
+        dDeltaTime);
+
+    pstCamera->dCenterY = _Follow(
+        pstCamera->dCenterY,
+        dTargetPosY,
+        pstCamera->dDeadzoneHeight,
+        pstCamera->dViewportHeight,
+        pstCamera->dSmoothing,
+        dDeltaTime);
+
+    _UpdateVisibleArea(pstCamera);
+}
@@ -0,0 +1,90 @@
+/**
+ * @file    Camera.h
+ * @ingroup Camera
+ */
+
+#ifndef _CAMERA_H_
+#define _CAMERA_H_
+
+#include <stdint.h>
+#include "AABB.h"
+#include "Video.h"
+#include "tmx/tmx.h"
+
+/**
+ * @ingroup Camera
+ */
+enum CameraFlags
+{
+    CAMERA_IS_SET = 0
+};
+
+/**
+ * @brief   Range of map tiles touched by the visible area.  Both
+ *          boundaries are inclusive and clamped to the map.
+ * @ingroup Camera
+ */
+typedef struct CameraTileRange_t
+{
+    uint32_t u32FirstColumn;
+    uint32_t u32LastColumn;
+    uint32_t u32FirstRow;
+    uint32_t u32LastRow;
+} CameraTileRange;
+
+/**
+ * @ingroup Camera
+ */
+typedef struct Camera_t
+{
+    double          dZoomLevel;
+    double          dZoomLevelInitial;
+    double          dDeadzoneWidth;
+    double          dDeadzoneHeight;
+    double          dSmoothing;
+    double          dResolutionScale;
+    uint16_t        u16Flags;
+    /* Remark: the following variables are updated once per frame by
+     * UpdateCamera() and are read by everything that needs to know
+     * what is visible. */
+    double          dPosX;
+    double          dPosY;
+    double          dScale;
+    double          dPixelScale;
+    double          dViewportWidth;
+    double          dViewportHeight;
+    AABB            stVisible;
+    CameraTileRange stTiles;
+    /* Remark: the following variables are used internally. */
+    double          dCenterX;
+    double          dCenterY;
+    int32_t         s32LogicalWidth;
+    int32_t         s32LogicalHeight;
+    double          dLogicalZoomLevel;
+    double          dOutputScale;
+    uint32_t        u32BoundsWidth;
+    uint32_t        u32BoundsHeight;
+    uint32_t        u32TileWidth;
+    uint32_t        u32TileHeight;
+    uint32_t        u32MapWidth;
+    uint32_t        u32MapHeight;
+} Camera;
+
+Camera *InitCamera(
+    const Video   *pstVideo,
+    const tmx_map *pstTmxMap,
+    const double   dZoomLevel);
+
+uint8_t IsCameraVisible(const Camera *pstCamera, AABB stBox);
+
+void SetCameraResolutionScale(Camera *pstCamera, double dResolutionScale);
+
+void SetCameraZoomLevel(Camera *pstCamera, double dZoomLevel);
+
+void UpdateCamera(
+    Camera *pstCamera,
+    double  dTargetPosX,
+    double  dTargetPosY,
+    double  dDeltaTime);
+
+#endif
@@ -12,6 +12,7 @@
 #include <string.h>
 #include "Config.h"
 #include "inih/ini.h"
+#include "Log.h"
 
 static int32_t _Handler(
     void* pConfig,
@@ -21,14 +22,42 @@ static int32_t _Handler(
 {
     Config  *pstConfig = (Config*)pConfig;
     int32_t  s32Value  = atoi(pacValue);
+    double   dValue    = atof(pacValue);
 
     #define MATCH(pacS, pacN) strcmp(pacSection, pacS) == 0 && strcmp(pacName, pacN) == 0
 
-    if      (MATCH("Video", "width"))      { pstConfig->stVideo.s32Width     = s32Value; }
-    else if (MATCH("Video", "height"))     { pstConfig->stVideo.s32Height    = s32Value; }
-    else if (MATCH("Video", "fullscreen")) { pstConfig->stVideo.s8Fullscreen = s32Value; }
-    else if (MATCH("Video", "fps"))        { pstConfig->stVideo.s8FPS        = s32Value; }
-    else if (MATCH("Video", "limitFPS"))   { pstConfig->stVideo.s8LimitFPS   = s32Value; }
+    if      (MATCH("Video", "width"))             { pstConfig->stVideo.s32Width            = s32Value; }
+    else if (MATCH("Video", "height"))            { pstConfig->stVideo.s32Height           = s32Value; }
+    else if (MATCH("Video", "nativeWidth"))       { pstConfig->stVideo.s32NativeWidth      = s32Value; }
+    else if (MATCH("Video", "nativeHeight"))      { pstConfig->stVideo.s32NativeHeight     = s32Value; }
+    else if (MATCH("Video", "fullscreen"))        { pstConfig->stVideo.s8Fullscreen        = s32Value; }
+    else if (MATCH("Video", "fps"))               { pstConfig->stVideo.s8FPS               = s32Value; }
+    else if (MATCH("Video", "limitFPS"))          { pstConfig->stVideo.s8LimitFPS          = s32Value; }
+    else if (MATCH("Video", "mipmaps"))           { pstConfig->stVideo.s8Mipmaps           = s32Value; }
+    else if (MATCH("Video", "dynamicResolution")) { pstConfig->stVideo.s8DynamicResolution = s32Value; }
+    else if (MATCH("Video", "minResolution"))     { pstConfig->stVideo.s8MinResolution     = s32Value; }
+    else if (MATCH("Camera", "deadzoneWidth"))    { pstConfig->stCamera.dDeadzoneWidth     = dValue; }
+    else if (MATCH("Camera", "deadzoneHeight"))   { pstConfig->stCamera.dDeadzoneHeight    = dValue; }
+    else if (MATCH("Camera", "smoothing"))        { pstConfig->stCamera.dSmoothing         = dValue; }
+    else if (MATCH("Map", "prefetchBudget"))      { pstConfig->stMap.s32PrefetchBudget     = s32Value; }
+    else if (MATCH("Map", "prefetchChunks"))      { pstConfig->stMap.s16PrefetchChunks     = s32Value; }
+    else if (MATCH("Map", "prefetchLookahead"))   { pstConfig->stMap.dPrefetchLookahead    = dValue; }
+    else if (MATCH("Simulation", "threaded"))     { pstConfig->stSimulation.s8Threaded     = s32Value; }
+    else if (MATCH("Simulation", "rate"))         { pstConfig->stSimulation.s16Rate        = s32Value; }
+    else if (MATCH("Jobs", "workers"))            { pstConfig->stJobs.s8Workers            = s32Value; }
+    else if (MATCH("Assets", "textureCache"))     { pstConfig->stAssets.s8TextureCache     = s32Value; }
+    else if (MATCH("Memory", "animationBudget"))  { pstConfig->stMemory.s32AnimationBudget  = s32Value; }
+    else if (MATCH("Memory", "assetBudget"))      { pstConfig->stMemory.s32AssetBudget      = s32Value; }
+    else if (MATCH("Memory", "backgroundBudget")) { pstConfig->stMemory.s32BackgroundBudget = s32Value; }
+    else if (MATCH("Memory", "cameraBudget"))     { pstConfig->stMemory.s32CameraBudget     = s32Value; }
+    else if (MATCH("Memory", "coreBudget"))       { pstConfig->stMemory.s32CoreBudget       = s32Value; }
+    else if (MATCH("Memory", "entityBudget"))     { pstConfig->stMemory.s32EntityBudget     = s32Value; }
+    else if (MATCH("Memory", "mapBudget"))        { pstConfig->stMemory.s32MapBudget        = s32Value; }
+    else if (MATCH("Memory", "packBudget"))       { pstConfig->stMemory.s32PackBudget       = s32Value; }
+    else if (MATCH("Memory", "rendererBudget"))   { pstConfig->stMemory.s32RendererBudget   = s32Value; }
+    else if (MATCH("Memory", "sceneBudget"))      { pstConfig->stMemory.s32SceneBudget      = s32Value; }
+    else if (MATCH("Memory", "simulationBudget")) { pstConfig->stMemory.s32SimulationBudget = s32Value; }
+    else if (MATCH("Memory", "tmxBudget"))        { pstConfig->stMemory.s32TmxBudget        = s32Value; }
     else
     {
         return 0;
@@ -47,20 +76,77 @@ Config InitConfig(const char *pacFilename)
 {
     static Config stConfig;
 
-    stConfig.stVideo.s32Width      = 800;
-    stConfig.stVideo.s32Height     = 600;
-    stConfig.stVideo.s8Fullscreen  =   0;
-    stConfig.stVideo.s8FPS         =  60;
-    stConfig.stVideo.s8LimitFPS    =   1;
+    stConfig.stVideo.s32Width            = 800;
+    stConfig.stVideo.s32Height           = 600;
+    stConfig.stVideo.s32NativeWidth      =   0;
+    stConfig.stVideo.s32NativeHeight     =   0;
+    stConfig.stVideo.s8Fullscreen        =   0;
+    stConfig.stVideo.s8FPS               =  60;
+    stConfig.stVideo.s8LimitFPS          =   1;
+    stConfig.stVideo.s8Mipmaps           =   2;
+    stConfig.stVideo.s8DynamicResolution =   0;
+    stConfig.stVideo.s8MinResolution     =  50;
+
+    stConfig.stCamera.dDeadzoneWidth  = 0;
+    stConfig.stCamera.dDeadzoneHeight = 0;
+    stConfig.stCamera.dSmoothing      = 0;
+
+    stConfig.stMap.s32PrefetchBudget  = 2000;
+    stConfig.stMap.s16PrefetchChunks  =   16;
+    stConfig.stMap.dPrefetchLookahead =    0.5;
+
+    stConfig.stSimulation.s8Threaded = 0;
+    stConfig.stSimulation.s16Rate    = 60;
+
+    stConfig.stJobs.s8Workers = -1;
+
+    stConfig.stAssets.s8TextureCache = 1;
+
+    stConfig.stMemory.s32AnimationBudget  = 0;
+    stConfig.stMemory.s32AssetBudget      = 0;
+    stConfig.stMemory.s32BackgroundBudget = 0;
+    stConfig.stMemory.s32CameraBudget     = 0;
+    stConfig.stMemory.s32CoreBudget       = 0;
+    stConfig.stMemory.s32EntityBudget     = 0;
+    stConfig.stMemory.s32MapBudget        = 0;
+    stConfig.stMemory.s32PackBudget       = 0;
+    stConfig.stMemory.s32RendererBudget   = 0;
+    stConfig.stMemory.s32SceneBudget      = 0;
+    stConfig.stMemory.s32SimulationBudget = 0;
+    stConfig.stMemory.s32TmxBudget        = 0;
 
     if (0 > ini_parse(pacFilename, _Handler, &stConfig))
     {
-        fprintf(stderr, "Couldn't load configuration file: %s\n", pacFilename);
+        LOG_ERROR("Couldn't load configuration file: %s", pacFilename);
     }
 
     if (0 > stConfig.stVideo.s8FPS)     { stConfig.stVideo.s8FPS     = abs(stConfig.stVideo.s8FPS);     }
     if (0 > stConfig.stVideo.s32Height) { stConfig.stVideo.s32Height = abs(stConfig.stVideo.s32Height); }
     if (0 > stConfig.stVideo.s32Width)  { stConfig.stVideo.s32Width  = abs(stConfig.stVideo.s32Width);  }
+    if (0 > stConfig.stVideo.s8Mipmaps) { stConfig.stVideo.s8Mipmaps = 0;                               }
+
+    if (0 > stConfig.stCamera.dDeadzoneWidth)  { stConfig.stCamera.dDeadzoneWidth  = 0; }
+    if (0 > stConfig.stCamera.dDeadzoneHeight) { stConfig.stCamera.dDeadzoneHeight = 0; }
+    if (0 > stConfig.stCamera.dSmoothing)      { stConfig.stCamera.dSmoothing      = 0; }
+
+    if (0 > stConfig.stMap.s32PrefetchBudget)  { stConfig.stMap.s32PrefetchBudget  = 0; }
+    if (0 > stConfig.stMap.s16PrefetchChunks)  { stConfig.stMap.s16PrefetchChunks  = 0; }
+    if (0 > stConfig.stMap.dPrefetchLookahead) { stConfig.stMap.dPrefetchLookahead = 0; }
+
+    if (0 >= stConfig.stSimulation.s16Rate) { stConfig.stSimulation.s16Rate = 60; }
+
+    if (0 > stConfig.stMemory.s32AnimationBudget)  { stConfig.stMemory.s32AnimationBudget  = 0; }
+    if (0 > stConfig.stMemory.s32AssetBudget)      { stConfig.stMemory.s32AssetBudget      = 0; }
+    if (0 > stConfig.stMemory.s32BackgroundBudget) { stConfig.stMemory.s32BackgroundBudget = 0; }
+    if (0 > stConfig.stMemory.s32CameraBudget)     { stConfig.stMemory.s32CameraBudget     = 0; }
+    if (0 > stConfig.stMemory.s32CoreBudget)       { stConfig.stMemory.s32CoreBudget       = 0; }
+    if (0 > stConfig.stMemory.s32EntityBudget)     { stConfig.stMemory.s32EntityBudget     = 0; }
+    if (0 > stConfig.stMemory.s32MapBudget)        { stConfig.stMemory.s32MapBudget        = 0; }
+    if (0 > stConfig.stMemory.s32PackBudget)       { stConfig.stMemory.s32PackBudget       = 0; }
+    if (0 > stConfig.stMemory.s32RendererBudget)   { stConfig.stMemory.s32RendererBudget   = 0; }
+    if (0 > stConfig.stMemory.s32SceneBudget)      { stConfig.stMemory.s32SceneBudget      = 0; }
+    if (0 > stConfig.stMemory.s32SimulationBudget) { stConfig.stMemory.s32SimulationBudget = 0; }
+    if (0 > stConfig.stMemory.s32TmxBudget)        { stConfig.stMemory.s32TmxBudget        = 0; }
 
     return stConfig;
 }
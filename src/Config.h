@@ -14,16 +14,86 @@
 typedef struct VideoConfig_t {
     int32_t s32Height;
     int32_t s32Width;
+    int32_t s32NativeHeight;
+    int32_t s32NativeWidth;
     int8_t  s8Fullscreen;
     int8_t  s8LimitFPS;
     int8_t  s8FPS;
+    int8_t  s8Mipmaps;
+    int8_t  s8DynamicResolution;
+    int8_t  s8MinResolution;
 } VideoConfig;
 
+/**
+ * @ingroup Config
+ */
+typedef struct CameraConfig_t {
+    double dDeadzoneWidth;
+    double dDeadzoneHeight;
+    double dSmoothing;
+} CameraConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct MapConfig_t {
+    int32_t s32PrefetchBudget;
+    int16_t s16PrefetchChunks;
+    double  dPrefetchLookahead;
+} MapConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct SimulationConfig_t {
+    int8_t  s8Threaded;
+    int16_t s16Rate;
+} SimulationConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct JobsConfig_t {
+    int8_t s8Workers;
+} JobsConfig;
+
+/**
+ * @ingroup Config
+ */
+typedef struct AssetsConfig_t {
+    int8_t s8TextureCache;
+} AssetsConfig;
+
+/**
+ * @brief   Budgets in KiB, 0 means none.
+ * @ingroup Config
+ */
+typedef struct MemoryConfig_t {
+    int32_t s32AnimationBudget;
+    int32_t s32AssetBudget;
+    int32_t s32BackgroundBudget;
+    int32_t s32CameraBudget;
+    int32_t s32CoreBudget;
+    int32_t s32EntityBudget;
+    int32_t s32MapBudget;
+    int32_t s32PackBudget;
+    int32_t s32RendererBudget;
+    int32_t s32SceneBudget;
+    int32_t s32SimulationBudget;
+    int32_t s32TmxBudget;
+} MemoryConfig;
+
 /**
  * @ingroup Config
  */
 typedef struct Config_t {
-    VideoConfig stVideo;
+    VideoConfig      stVideo;
+    CameraConfig     stCamera;
+    MapConfig        stMap;
+    SimulationConfig stSimulation;
+    JobsConfig       stJobs;
+    AssetsConfig     stAssets;
+    MemoryConfig     stMemory;
 } Config;
 
 Config InitConfig(const char *pcFilename);
@@ -9,50 +9,153 @@
  */
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
 #include <stdint.h>
 #include <stdio.h>
 #include "AABB.h"
+#include "Animation.h"
+#include "Asset.h"
+#include "Camera.h"
 #include "Entity.h"
+#include "Log.h"
 #include "Macros.h"
+#include "Memory.h"
+#include "SpriteBatch.h"
+
+static uint8_t _GetAnimationState(const Entity *pstEntity)
+{
+    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_MOVING))
+    {
+        return ANIMATION_STATE_RUN;
+    }
+
+    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR))
+    {
+        /* If the entity is in mid air but isn't jumping, it is
+         * falling downwards. */
+        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_JUMPING))
+        {
+            return ANIMATION_STATE_JUMP;
+        }
+        return ANIMATION_STATE_FALL;
+    }
+
+    return ANIMATION_STATE_IDLE;
+}
+
+static void _UpdatePhysics(Entity *pstEntity, double dDeltaTime)
+{
+    // Update bounding box.
+    pstEntity->stBB.dBottom = pstEntity->dWorldPosY + pstEntity->u8Height;
+    pstEntity->stBB.dLeft   = pstEntity->dWorldPosX;
+    pstEntity->stBB.dRight  = pstEntity->dWorldPosX + pstEntity->u8Width;
+    pstEntity->stBB.dTop    = pstEntity->dWorldPosY;
+
+    // Increase/decrease vertical velocity if entity is in motion.
+    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_MOVING))
+    {
+        pstEntity->dVelocityX += pstEntity->dAcceleration * dDeltaTime;
+    }
+    else
+    {
+        pstEntity->dVelocityX -= pstEntity->dDeceleration * dDeltaTime;
+    }
+
+    // Set vertical velocity limits.
+    if (pstEntity->dVelocityX >= pstEntity->dMaxVelocityX)
+    {
+        pstEntity->dVelocityX = pstEntity->dMaxVelocityX;
+    }
+    if (pstEntity->dVelocityX < 0) { pstEntity->dVelocityX = 0; }
+
+
+    // Set horizontal entity position.
+    if (pstEntity->dVelocityX > 0)
+    {
+        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_DIRECTION))
+        {
+            pstEntity->dWorldPosX -= (pstEntity->dVelocityX * dDeltaTime);
+        }
+        else
+        {
+            pstEntity->dWorldPosX += (pstEntity->dVelocityX * dDeltaTime);
+        }
+    }
+
+    // Apply gravity.
+    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR))
+    {
+        double dG = pstEntity->dWorldMeterInPixel * pstEntity->dWorldGravitation;
+
+        pstEntity->dDistanceY  = dG * dDeltaTime * dDeltaTime;
+        pstEntity->dVelocityY += pstEntity->dDistanceY;
+        pstEntity->dWorldPosY += pstEntity->dVelocityY;
+    }
+    else
+    {
+        // Experimental y-coordinate correction.
+        while (0 != ((int32_t)pstEntity->dWorldPosY % 8))
+        {
+            pstEntity->dWorldPosY = floor(pstEntity->dWorldPosY);
+            pstEntity->dWorldPosY -= 1.0;
+        }
+    }
+
+    // Connect left and right map border and vice versa.
+    if (pstEntity->dWorldPosX < 0 - (pstEntity->u8Width))
+    {
+        pstEntity->dWorldPosX = pstEntity->u32MapWidth - (pstEntity->u8Width);
+    }
+
+    if (pstEntity->dWorldPosX > pstEntity->u32MapWidth - (pstEntity->u8Width))
+    {
+        pstEntity->dWorldPosX = 0 - (pstEntity->u8Width);
+    }
+}
 
 /**
- * @brief   Draw Entity on screen.
- * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @brief   Draw Entity on screen.  Entities outside of the visible
+ *          area of the Camera are skipped, entities without a sprite
+ *          or AnimationSheet are only counted.  See @ref struct SpriteBatchStats.
+ * @param   pstBatch    the SpriteBatch.  See @ref struct SpriteBatch.
  * @param   pstEntity   an Entity.  See @ref struct Entity.
- * @param   dCameraPosX the camera position along the x-axis.
- * @param   dCameraPosY the camera position along the y-axis.
+ * @param   pstCamera   the Camera.  See @ref struct Camera.
  * @return  0 on success, -1 on failure.
  * @ingroup Entity
  */
 int8_t DrawEntity(
-    SDL_Renderer *pstRenderer,
-    Entity       *pstEntity,
-    double        dCameraPosX,
-    double        dCameraPosY)
+    SpriteBatch  *pstBatch,
+    const Entity *pstEntity,
+    const Camera *pstCamera)
 {
+    AABB             stBox;
     double           dRenderPosX;
     double           dRenderPosY;
-    SDL_Rect         stDst;
-    SDL_Rect         stSrc;
+    SDL_FRect        stDst;
     SDL_RendererFlip s8Flip;
 
-    if (NULL == pstEntity->pstSprite)
+    stBox.dLeft   = pstEntity->dWorldPosX;
+    stBox.dTop    = pstEntity->dWorldPosY;
+    stBox.dRight  = pstEntity->dWorldPosX + pstEntity->u8Width;
+    stBox.dBottom = pstEntity->dWorldPosY + pstEntity->u8Height;
+
+    if (! IsCameraVisible(pstCamera, stBox))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        pstBatch->stStats.u32Culled++;
+        return 0;
+    }
+
+    if (NULL == pstEntity->stAnimation.pstRect)
+    {
+        pstBatch->stStats.u32Missing++;
+        return 0;
     }
 
-    dRenderPosX = pstEntity->dWorldPosX - dCameraPosX;
-    dRenderPosY = pstEntity->dWorldPosY - dCameraPosY;
-    stDst.x     = dRenderPosX;
-    stDst.y     = dRenderPosY;
-    stDst.w     = pstEntity->u8Width;
-    stDst.h     = pstEntity->u8Height;
-    stSrc.x     = pstEntity->u8Frame        * pstEntity->u8Width;
-    stSrc.y     = pstEntity->u8FrameOffsetY * pstEntity->u8Height;
-    stSrc.w     = pstEntity->u8Width;
-    stSrc.h     = pstEntity->u8Height;
+    dRenderPosX = pstEntity->dWorldPosX - pstCamera->dPosX;
+    dRenderPosY = pstEntity->dWorldPosY - pstCamera->dPosY;
+    stDst.x     = dRenderPosX * pstCamera->dScale;
+    stDst.y     = dRenderPosY * pstCamera->dScale;
+    stDst.w     = pstEntity->u8Width  * pstCamera->dScale;
+    stDst.h     = pstEntity->u8Height * pstCamera->dScale;
 
     if ((pstEntity->u16Flags >> ENTITY_DIRECTION) & 1)
     {
@@ -63,20 +166,13 @@ int8_t DrawEntity(
         s8Flip = SDL_FLIP_NONE;
     }
 
-    if (-1 == SDL_RenderCopyEx(
-            pstRenderer,
-            pstEntity->pstSprite,
-            &stSrc,
-            &stDst,
-            0,
-            NULL,
-            s8Flip))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
-    }
-
-    return 0;
+    // A sprite which is still loading is counted as missing.
+    return PushSprite(
+        pstBatch,
+        GetAssetTexture(pstEntity->pstAssets, pstEntity->s16Sprite),
+        pstEntity->stAnimation.pstRect,
+        &stDst,
+        s8Flip);
 }
 
 /**
@@ -97,10 +193,10 @@ Entity *InitEntity(
     const uint32_t u32MapWidth)
 {
     static Entity *pstEntity;
-    pstEntity = malloc(sizeof(struct Entity_t));
+    pstEntity = AllocMemory(MEMORY_TAG_ENTITY, sizeof(struct Entity_t));
     if (NULL == pstEntity)
     {
-        fprintf(stderr, "InitEntity(): error allocating memory.\n");
+        LOG_ERROR("InitEntity(): error allocating memory.");
         return NULL;
     }
 
@@ -110,57 +206,58 @@ Entity *InitEntity(
     pstEntity->u8Height            = u8Height;
     pstEntity->u8Width             = u8Width;
     pstEntity->u32MapWidth         = u32MapWidth;
-    pstEntity->dFrameAnimationFPS  =  20;
-    pstEntity->u8FrameStart        =   0;
-    pstEntity->u8FrameEnd          =  12;
-    pstEntity->u8FrameOffsetY      =   0;
     pstEntity->dMaxVelocityX       = 100;
     pstEntity->dWorldMeterInPixel  =  48;
     pstEntity->dWorldGravitation   =   9.81;
     pstEntity->dWorldPosX          = dPosX;
     pstEntity->dWorldPosY          = dPosY;
+    pstEntity->dDormantInterval    =   0.25;
+    pstEntity->dPhysicsStep        =   1.0 / 60;
+    pstEntity->u8Activity          = ENTITY_ACTIVITY_VISIBLE;
 
-    pstEntity->pstSprite           = NULL;
-    pstEntity->u8Frame             =   0;
-    pstEntity->dFrameDuration      =   0;
-    pstEntity->stBB.dBottom        =   0;
-    pstEntity->stBB.dLeft          = u8Height;
-    pstEntity->stBB.dRight         = u8Width;
-    pstEntity->stBB.dTop           =   0;
-    pstEntity->dInitialWorldPosX   = dPosX;
-    pstEntity->dInitialWorldPosY   = dPosY;
-    pstEntity->dDistanceY          =   0;
-    pstEntity->dVelocityX          =   0;
-    pstEntity->dVelocityY          =   0;
+    pstEntity->pstAssets            = NULL;
+    pstEntity->s16Sprite            = -1;
+    pstEntity->stAnimation.pstSheet = NULL;
+    pstEntity->stAnimation.pstRect  = NULL;
+    pstEntity->stBB.dBottom         =   0;
+    pstEntity->stBB.dLeft           = u8Height;
+    pstEntity->stBB.dRight          = u8Width;
+    pstEntity->stBB.dTop            =   0;
+    pstEntity->dInitialWorldPosX    = dPosX;
+    pstEntity->dInitialWorldPosY    = dPosY;
+    pstEntity->dDistanceY           =   0;
+    pstEntity->dVelocityX           =   0;
+    pstEntity->dVelocityY           =   0;
+    pstEntity->dPhysicsLag          =   0;
+    pstEntity->dAnimationLag        =   0;
 
     return pstEntity;
 }
 
 /**
- * @brief   Load the Entity's sprite image.
+ * @brief   Load the Entity's sprite image.  The image is decoded in the
+ *          background; until it is ready, the Entity is not drawn.
  * @param   pstEntity   an Entity.  See @ref struct Entity.
- * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstAssets   the AssetManager.  See @ref struct AssetManager.
  * @param   pacFilename the filename of the image.
  * @return  0 on success, -1 on failure.
  * @ingroup Entity
  */
 int8_t LoadEntitySprite(
     Entity       *pstEntity,
-    SDL_Renderer *pstRenderer,
+    AssetManager *pstAssets,
     const char   *pacFilename)
 {
-    if (NULL != pstEntity->pstSprite)
-    {
-        SDL_DestroyTexture(pstEntity->pstSprite);
-    }
+    int16_t s16Sprite = LoadAsset(pstAssets, pacFilename, ASSET_TEXTURE);
 
-    pstEntity->pstSprite = IMG_LoadTexture(pstRenderer, pacFilename);
-    if (NULL == pstEntity->pstSprite)
+    if (-1 == s16Sprite)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
         return -1;
     }
 
+    pstEntity->pstAssets = pstAssets;
+    pstEntity->s16Sprite = s16Sprite;
+
     return 0;
 }
 
@@ -178,30 +275,26 @@ void ResurrectEntity(Entity *pstEntity)
 }
 
 /**
- * @brief   Set the sprite animation of an Entity.
- * @param   pstEntity          an Entity.  See @ref strucht Entity.
- * @param   u8FrameStart       the animation's first frame.
- * @param   u8FrameEnd         the animation's last frame.
- * @param   u8FrameOffsetY     image offset along the y-axis.
- * @param   dFrameAnimationFPS animation speed in frames per second.
+ * @brief   Set the AnimationSheet of an Entity.  The sheet has to match
+ *          the Entity's sprite and is not copied.
+ * @param   pstEntity an Entity.  See @ref struct Entity.
+ * @param   pstSheet  an AnimationSheet.  See @ref struct AnimationSheet.
  * @ingroup Entity
  */
-void SetEntitySpriteAnimation(
-    Entity  *pstEntity,
-    uint8_t  u8FrameStart,
-    uint8_t  u8FrameEnd,
-    uint8_t  u8FrameOffsetY,
-    double   dFrameAnimationFPS
-)
+void SetEntityAnimationSheet(
+    Entity               *pstEntity,
+    const AnimationSheet *pstSheet)
 {
-    pstEntity->u8FrameStart       = u8FrameStart;
-    pstEntity->u8FrameEnd         = u8FrameEnd;
-    pstEntity->u8FrameOffsetY     = u8FrameOffsetY;
-    pstEntity->dFrameAnimationFPS = dFrameAnimationFPS;
+    InitAnimation(&pstEntity->stAnimation, pstSheet);
 }
 
 /**
  * @brief   Update Entity.  This function has to be called every frame.
+ *          How much is updated depends on the activity tier of the
+ *          Entity: dormant entities only tick their physics every
+ *          dDormantInterval seconds and only visible entities are
+ *          animated.  Skipped time is caught up in steps of at most
+ *          dPhysicsStep seconds once the Entity ticks again.  See @ref enum EntityActivity.
  * @param   pstEentity an Entity.  See @ref struct Entity.
  * @param   dDeltaTime time since last frame in seconds.
  * @ingroup Entity
@@ -210,90 +303,33 @@ void UpdateEntity(
     Entity *pstEntity,
     double dDeltaTime)
 {
-    // Update bounding box.
-    pstEntity->stBB.dBottom = pstEntity->dWorldPosY + pstEntity->u8Height;
-    pstEntity->stBB.dLeft   = pstEntity->dWorldPosX;
-    pstEntity->stBB.dRight  = pstEntity->dWorldPosX + pstEntity->u8Width;
-    pstEntity->stBB.dTop    = pstEntity->dWorldPosY;
-
-    // Increase/decrease vertical velocity if entity is in motion.
-    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_MOVING))
-    {
-        pstEntity->dVelocityX += pstEntity->dAcceleration * dDeltaTime;
-    }
-    else
-    {
-        pstEntity->dVelocityX -= pstEntity->dDeceleration * dDeltaTime;
-    }
-
-    // Set vertical velocity limits.
-    if (pstEntity->dVelocityX >= pstEntity->dMaxVelocityX)
-    {
-        pstEntity->dVelocityX = pstEntity->dMaxVelocityX;
-    }
-    if (pstEntity->dVelocityX < 0) { pstEntity->dVelocityX = 0; }
-
-
-    // Set horizontal entity position.
-    if (pstEntity->dVelocityX > 0)
-    {
-        if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_DIRECTION))
-        {
-            pstEntity->dWorldPosX -= (pstEntity->dVelocityX * dDeltaTime);
-        }
-        else
-        {
-            pstEntity->dWorldPosX += (pstEntity->dVelocityX * dDeltaTime);
-        }
-    }
-
-    // Apply gravity.
-    if (FLAG_IS_SET(pstEntity->u16Flags, ENTITY_IS_IN_MID_AIR))
-    {
-        double dG = pstEntity->dWorldMeterInPixel * pstEntity->dWorldGravitation;
-
-        pstEntity->dDistanceY  = dG * dDeltaTime * dDeltaTime;
-        pstEntity->dVelocityY += pstEntity->dDistanceY;
-        pstEntity->dWorldPosY += pstEntity->dVelocityY;
-    }
-    else
-    {
-        // Experimental y-coordinate correction.
-        while (0 != ((int32_t)pstEntity->dWorldPosY % 8))
-        {
-            pstEntity->dWorldPosY = floor(pstEntity->dWorldPosY);
-            pstEntity->dWorldPosY -= 1.0;
-        }
-    }
-
-    // Connect left and right map border and vice versa.
-    if (pstEntity->dWorldPosX < 0 - (pstEntity->u8Width))
-    {
-        pstEntity->dWorldPosX = pstEntity->u32MapWidth - (pstEntity->u8Width);
-    }
-
-    if (pstEntity->dWorldPosX > pstEntity->u32MapWidth - (pstEntity->u8Width))
-    {
-        pstEntity->dWorldPosX = 0 - (pstEntity->u8Width);
-    }
-
-    // Update frame.
-    pstEntity->dFrameDuration += dDeltaTime;
+    pstEntity->dPhysicsLag   += dDeltaTime;
+    pstEntity->dAnimationLag += dDeltaTime;
 
-    if (pstEntity->u8Frame < pstEntity->u8FrameStart)
+    if ((ENTITY_ACTIVITY_DORMANT == pstEntity->u8Activity) &&
+        (pstEntity->dPhysicsLag < pstEntity->dDormantInterval))
     {
-        pstEntity->u8Frame = pstEntity->u8FrameStart;
+        return;
     }
 
-    if (pstEntity->dFrameDuration > 1 / pstEntity->dFrameAnimationFPS)
+    /* The integrator depends on the step size, so skipped time is
+     * caught up in steps no longer than a regular frame. */
+    while (pstEntity->dPhysicsLag > pstEntity->dPhysicsStep)
     {
-        pstEntity->u8Frame++;
-        pstEntity->dFrameDuration = 0;
+        _UpdatePhysics(pstEntity, pstEntity->dPhysicsStep);
+        pstEntity->dPhysicsLag -= pstEntity->dPhysicsStep;
     }
+    _UpdatePhysics(pstEntity, pstEntity->dPhysicsLag);
+    pstEntity->dPhysicsLag = 0;
 
-    // Loop frame animation.
-    if (pstEntity->u8Frame >= pstEntity->u8FrameEnd)
+    // Advance the animation of the current state.
+    if ((ENTITY_ACTIVITY_VISIBLE == pstEntity->u8Activity) &&
+        (NULL != pstEntity->stAnimation.pstSheet))
     {
-        pstEntity->u8Frame = pstEntity->u8FrameStart;
+        UpdateAnimation(
+            &pstEntity->stAnimation,
+            _GetAnimationState(pstEntity),
+            pstEntity->dAnimationLag);
+        pstEntity->dAnimationLag = 0;
     }
 }
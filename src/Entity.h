@@ -8,6 +8,10 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include "AABB.h"
+#include "Animation.h"
+#include "Asset.h"
+#include "Camera.h"
+#include "SpriteBatch.h"
 
 /**
  * @ingroup Entity
@@ -22,45 +26,58 @@ enum EntityFlags
     ENTITY_IS_MOVING     = 5,
 };
 
+/**
+ * @brief   Activity tiers.  Visible entities are fully updated, near
+ *          entities are not animated and dormant entities only tick
+ *          their physics at a reduced rate.
+ * @ingroup Entity
+ */
+enum EntityActivity
+{
+    ENTITY_ACTIVITY_VISIBLE = 0,
+    ENTITY_ACTIVITY_NEAR    = 1,
+    ENTITY_ACTIVITY_DORMANT = 2
+};
+
 /**
  * @ingroup Entity
  */
 typedef struct Entity_t
 {
-    double       dAcceleration;
-    double       dDeceleration;
-    uint16_t     u16Flags;
-    uint8_t      u8Height;
-    uint8_t      u8Width;
-    uint32_t     u32MapWidth;
-    double       dFrameAnimationFPS;
-    uint8_t      u8FrameStart;
-    uint8_t      u8FrameEnd;
-    uint8_t      u8FrameOffsetY;
-    double       dMaxVelocityX;
-    double       dWorldMeterInPixel;
-    double       dWorldGravitation;
-    double       dWorldPosX;
-    double       dWorldPosY;
+    double        dAcceleration;
+    double        dDeceleration;
+    uint16_t      u16Flags;
+    uint8_t       u8Height;
+    uint8_t       u8Width;
+    uint32_t      u32MapWidth;
+    double        dMaxVelocityX;
+    double        dWorldMeterInPixel;
+    double        dWorldGravitation;
+    double        dWorldPosX;
+    double        dWorldPosY;
+    double        dDormantInterval;
+    double        dPhysicsStep;
+    uint8_t       u8Activity;
     /* Remark: the following variables are used internally to store
      * volatile values and usually do not have to be changed
      * manually. */
-    SDL_Texture *pstSprite;
-    uint8_t      u8Frame;
-    double       dFrameDuration;
-    AABB         stBB;
-    double       dInitialWorldPosX;
-    double       dInitialWorldPosY;
-    double       dVelocityX;
-    double       dVelocityY;
-    double       dDistanceY;
+    AssetManager *pstAssets;
+    int16_t       s16Sprite;
+    Animation     stAnimation;
+    AABB          stBB;
+    double        dInitialWorldPosX;
+    double        dInitialWorldPosY;
+    double        dVelocityX;
+    double        dVelocityY;
+    double        dDistanceY;
+    double        dPhysicsLag;
+    double        dAnimationLag;
 } Entity;
 
 int8_t DrawEntity(
-    SDL_Renderer *pstRenderer,
-    Entity       *pstEntity,
-    double        dCameraPosX,
-    double        dCameraPosY);
+    SpriteBatch  *pstBatch,
+    const Entity *pstEntity,
+    const Camera *pstCamera);
 
 Entity *InitEntity(
     const uint8_t  u8Width,
@@ -71,18 +88,14 @@ Entity *InitEntity(
 
 int8_t LoadEntitySprite(
     Entity       *pstEntity,
-    SDL_Renderer *pstRenderer,
+    AssetManager *pstAssets,
     const char   *pacFilename);
 
 void ResurrectEntity(Entity *pstEntity);
 
-void SetEntitySpriteAnimation(
-    Entity  *pstEntity,
-    uint8_t  u8FrameStart,
-    uint8_t  u8FrameEnd,
-    uint8_t  u8FrameOffsetY,
-    double   dFrameAnimationFPS
-);
+void SetEntityAnimationSheet(
+    Entity               *pstEntity,
+    const AnimationSheet *pstSheet);
 
 void UpdateEntity(
     Entity *pstEntity,
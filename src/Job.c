@@ -0,0 +1,415 @@
+/**
+ * @file      Job.c
+ * @ingroup   Job
+ * @defgroup  Job
+ * @brief     Work-stealing job system.  Every worker thread owns a
+ *            queue; idle workers steal from the others.  Threads which
+ *            wait for a JobCounter run jobs themselves in the meantime,
+ *            so waiting from within a job cannot dead-lock.  Without
+ *            any workers, every job simply runs on the waiting thread.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Job.h"
+#include "Log.h"
+#include "Memory.h"
+
+static uint8_t _GetWorkerIndex(JobSystem *pstSystem)
+{
+    SDL_threadID ulThreadId = SDL_ThreadID();
+
+    for (uint8_t u8Index = 1; u8Index <= pstSystem->u8WorkerCount; u8Index++)
+    {
+        if (ulThreadId == pstSystem->astWorkers[u8Index].ulThreadId)
+        {
+            return u8Index;
+        }
+    }
+
+    return 0;
+}
+
+static int8_t _Push(JobQueue *pstQueue, const Job *pstJob)
+{
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom - pstQueue->u32Top >= JOB_QUEUE_SIZE)
+    {
+        SDL_AtomicUnlock(&pstQueue->stLock);
+        return -1;
+    }
+    pstQueue->astJobs[pstQueue->u32Bottom % JOB_QUEUE_SIZE] = *pstJob;
+    pstQueue->u32Bottom++;
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return 0;
+}
+
+static uint8_t _Pop(JobQueue *pstQueue, Job *pstJob)
+{
+    uint8_t u8HasJob = 0;
+
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom != pstQueue->u32Top)
+    {
+        pstQueue->u32Bottom--;
+        *pstJob  = pstQueue->astJobs[pstQueue->u32Bottom % JOB_QUEUE_SIZE];
+        u8HasJob = 1;
+    }
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return u8HasJob;
+}
+
+static uint8_t _Steal(JobQueue *pstQueue, Job *pstJob)
+{
+    uint8_t u8HasJob = 0;
+
+    SDL_AtomicLock(&pstQueue->stLock);
+    if (pstQueue->u32Bottom != pstQueue->u32Top)
+    {
+        *pstJob  = pstQueue->astJobs[pstQueue->u32Top % JOB_QUEUE_SIZE];
+        pstQueue->u32Top++;
+        u8HasJob = 1;
+    }
+    SDL_AtomicUnlock(&pstQueue->stLock);
+
+    return u8HasJob;
+}
+
+static uint8_t _FindJob(JobSystem *pstSystem, uint8_t u8Worker, Job *pstJob)
+{
+    JobWorker *pstWorker = &pstSystem->astWorkers[u8Worker];
+    uint8_t    u8Count   = pstSystem->u8WorkerCount + 1;
+
+    if (_Pop(&pstWorker->stQueue, pstJob))
+    {
+        return 1;
+    }
+
+    // Start with the next worker, so thieves spread over all queues.
+    for (uint8_t u8Offset = 1; u8Offset < u8Count; u8Offset++)
+    {
+        if (_Steal(&pstSystem->astWorkers[(u8Worker + u8Offset) % u8Count].stQueue, pstJob))
+        {
+            SDL_AtomicAdd(&pstWorker->stStolen, 1);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void _Execute(JobSystem *pstSystem, uint8_t u8Worker, const Job *pstJob)
+{
+    if (pstSystem->pfnBegin)
+    {
+        pstSystem->pfnBegin(pstSystem->pHookData, u8Worker, pstJob->pacName);
+    }
+
+    pstJob->pfnFunction(pstJob->pData, pstJob->u32Begin, pstJob->u32End);
+
+    if (pstSystem->pfnEnd)
+    {
+        pstSystem->pfnEnd(pstSystem->pHookData, u8Worker, pstJob->pacName);
+    }
+
+    SDL_AtomicAdd(&pstSystem->astWorkers[u8Worker].stExecuted, 1);
+
+    if (pstJob->pstCounter)
+    {
+        SDL_AtomicAdd(&pstJob->pstCounter->stPending, -1);
+    }
+}
+
+static int32_t _Work(void *pData)
+{
+    JobWorker *pstWorker = (JobWorker *)pData;
+    JobSystem *pstSystem = pstWorker->pstSystem;
+    Job        stJob;
+
+    /* Let InitJobSystem() know the thread ID, then wait until it has
+     * set the number of workers. */
+    pstWorker->ulThreadId = SDL_ThreadID();
+    SDL_SemPost(pstSystem->pstStarted);
+    SDL_LockMutex(pstSystem->pstStartup);
+    SDL_UnlockMutex(pstSystem->pstStartup);
+
+    while (SDL_AtomicGet(&pstSystem->stIsRunning))
+    {
+        if (_FindJob(pstSystem, pstWorker->u8Index, &stJob))
+        {
+            _Execute(pstSystem, pstWorker->u8Index, &stJob);
+        }
+        else
+        {
+            SDL_SemWaitTimeout(pstSystem->pstSignal, 10);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Free JobSystem from memory.  Running jobs are finished,
+ *          queued jobs are dropped.
+ * @param   pstSystem a JobSystem.  See @ref struct JobSystem.
+ * @ingroup Job
+ */
+void FreeJobSystem(JobSystem *pstSystem)
+{
+    if (NULL == pstSystem)
+    {
+        return;
+    }
+
+    SDL_AtomicSet(&pstSystem->stIsRunning, 0);
+
+    for (uint8_t u8Index = 1; u8Index <= pstSystem->u8WorkerCount; u8Index++)
+    {
+        SDL_SemPost(pstSystem->pstSignal);
+    }
+
+    for (uint8_t u8Index = 1; u8Index <= pstSystem->u8WorkerCount; u8Index++)
+    {
+        SDL_WaitThread(pstSystem->astWorkers[u8Index].pstThread, NULL);
+    }
+
+    if (NULL != pstSystem->pstSignal)
+    {
+        SDL_DestroySemaphore(pstSystem->pstSignal);
+    }
+
+    if (NULL != pstSystem->pstStarted)
+    {
+        SDL_DestroySemaphore(pstSystem->pstStarted);
+    }
+
+    if (NULL != pstSystem->pstStartup)
+    {
+        SDL_DestroyMutex(pstSystem->pstStartup);
+    }
+    FreeMemory(pstSystem);
+}
+
+/**
+ * @brief   Initialise JobSystem.
+ * @param   u8WorkerCount the number of worker threads, at most
+ *                        JOB_MAX_WORKERS.  With 0 workers, jobs run on
+ *                        the thread which waits for them.
+ * @return  a JobSystem on success, NULL on failure.
+ * @ingroup Job
+ */
+JobSystem *InitJobSystem(uint8_t u8WorkerCount)
+{
+    static JobSystem *pstSystem;
+    pstSystem = AllocZeroedMemory(MEMORY_TAG_CORE, 1, sizeof(struct JobSystem_t));
+    if (NULL == pstSystem)
+    {
+        LOG_ERROR("InitJobSystem(): error allocating memory.");
+        return NULL;
+    }
+
+    pstSystem->pstSignal  = SDL_CreateSemaphore(0);
+    pstSystem->pstStarted = SDL_CreateSemaphore(0);
+    pstSystem->pstStartup = SDL_CreateMutex();
+    if ((NULL == pstSystem->pstSignal) || (NULL == pstSystem->pstStarted) || (NULL == pstSystem->pstStartup))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        FreeJobSystem(pstSystem);
+        return NULL;
+    }
+
+    if (u8WorkerCount > JOB_MAX_WORKERS)
+    {
+        u8WorkerCount = JOB_MAX_WORKERS;
+    }
+
+    SDL_AtomicSet(&pstSystem->stIsRunning, 1);
+    pstSystem->astWorkers[0].pstSystem  = pstSystem;
+    pstSystem->astWorkers[0].ulThreadId = SDL_ThreadID();
+
+    // The workers must not look at u8WorkerCount before it is final.
+    SDL_LockMutex(pstSystem->pstStartup);
+    for (uint8_t u8Index = 1; u8Index <= u8WorkerCount; u8Index++)
+    {
+        JobWorker *pstWorker = &pstSystem->astWorkers[u8Index];
+
+        pstWorker->pstSystem = pstSystem;
+        pstWorker->u8Index   = u8Index;
+        pstWorker->pstThread = SDL_CreateThread(_Work, "Job", pstWorker);
+        if (NULL == pstWorker->pstThread)
+        {
+            // Carry on with the workers we have.
+            LOG_ERROR("%s", SDL_GetError());
+            u8WorkerCount = u8Index - 1;
+            break;
+        }
+    }
+
+    // Every worker has stored its thread ID once it has started.
+    for (uint8_t u8Index = 1; u8Index <= u8WorkerCount; u8Index++)
+    {
+        SDL_SemWait(pstSystem->pstStarted);
+    }
+    pstSystem->u8WorkerCount = u8WorkerCount;
+    SDL_UnlockMutex(pstSystem->pstStartup);
+
+    return pstSystem;
+}
+
+/**
+ * @brief   Run a single job.  If the queue of the calling thread is
+ *          full, the job is run right away.
+ * @param   pstSystem   a JobSystem.  See @ref struct JobSystem.
+ * @param   pacName     the name passed to the instrumentation hooks.
+ * @param   pfnFunction the job function.
+ * @param   pData       the data passed to the job function.
+ * @param   pstCounter  a JobCounter to wait for or NULL.
+ * @ingroup Job
+ */
+void RunJob(
+    JobSystem   *pstSystem,
+    const char  *pacName,
+    JobFunction  pfnFunction,
+    void        *pData,
+    JobCounter  *pstCounter)
+{
+    uint8_t u8Worker = _GetWorkerIndex(pstSystem);
+    Job     stJob;
+
+    stJob.pfnFunction = pfnFunction;
+    stJob.pData       = pData;
+    stJob.pacName     = pacName;
+    stJob.pstCounter  = pstCounter;
+    stJob.u32Begin    = 0;
+    stJob.u32End      = 1;
+
+    if (pstCounter)
+    {
+        SDL_AtomicAdd(&pstCounter->stPending, 1);
+    }
+
+    if (-1 == _Push(&pstSystem->astWorkers[u8Worker].stQueue, &stJob))
+    {
+        _Execute(pstSystem, u8Worker, &stJob);
+        return;
+    }
+    SDL_SemPost(pstSystem->pstSignal);
+}
+
+/**
+ * @brief   Run a job function over the range [0, u32Count), split into
+ *          parts of u32Grain elements.  Ranges which fit into a single
+ *          part are run right away.
+ * @param   pstSystem   a JobSystem.  See @ref struct JobSystem.
+ * @param   pacName     the name passed to the instrumentation hooks.
+ * @param   pfnFunction the job function.
+ * @param   pData       the data passed to the job function.
+ * @param   u32Count    the number of elements.
+ * @param   u32Grain    the number of elements per job; 0 splits the
+ *                      range into a few jobs per worker.
+ * @param   pstCounter  a JobCounter to wait for or NULL.
+ * @ingroup Job
+ */
+void RunParallelFor(
+    JobSystem   *pstSystem,
+    const char  *pacName,
+    JobFunction  pfnFunction,
+    void        *pData,
+    uint32_t     u32Count,
+    uint32_t     u32Grain,
+    JobCounter  *pstCounter)
+{
+    uint8_t u8Worker = _GetWorkerIndex(pstSystem);
+    Job     stJob;
+
+    if (0 == u32Grain)
+    {
+        u32Grain = u32Count / (4 * (pstSystem->u8WorkerCount + 1)) + 1;
+    }
+
+    stJob.pfnFunction = pfnFunction;
+    stJob.pData       = pData;
+    stJob.pacName     = pacName;
+    stJob.pstCounter  = NULL;
+
+    // Not worth the trip through the queues.
+    if ((u32Count <= u32Grain) || (0 == pstSystem->u8WorkerCount))
+    {
+        stJob.u32Begin = 0;
+        stJob.u32End   = u32Count;
+        if (u32Count > 0)
+        {
+            _Execute(pstSystem, u8Worker, &stJob);
+        }
+        return;
+    }
+
+    for (uint32_t u32Begin = 0; u32Begin < u32Count; u32Begin += u32Grain)
+    {
+        stJob.pstCounter = pstCounter;
+        stJob.u32Begin   = u32Begin;
+        stJob.u32End     = SDL_min(u32Begin + u32Grain, u32Count);
+
+        if (pstCounter)
+        {
+            SDL_AtomicAdd(&pstCounter->stPending, 1);
+        }
+
+        if (-1 == _Push(&pstSystem->astWorkers[u8Worker].stQueue, &stJob))
+        {
+            _Execute(pstSystem, u8Worker, &stJob);
+            continue;
+        }
+        SDL_SemPost(pstSystem->pstSignal);
+    }
+}
+
+/**
+ * @brief   Set instrumentation hooks.
+ * @param   pstSystem a JobSystem.  See @ref struct JobSystem.
+ * @param   pfnBegin  called before each job or NULL.
+ * @param   pfnEnd    called after each job or NULL.
+ * @param   pHookData passed to the hooks.
+ * @ingroup Job
+ */
+void SetJobHooks(
+    JobSystem *pstSystem,
+    JobHook    pfnBegin,
+    JobHook    pfnEnd,
+    void      *pHookData)
+{
+    pstSystem->pfnBegin  = pfnBegin;
+    pstSystem->pfnEnd    = pfnEnd;
+    pstSystem->pHookData = pHookData;
+}
+
+/**
+ * @brief   Wait until all jobs of a JobCounter have finished.  The
+ *          calling thread runs queued jobs in the meantime.
+ * @param   pstSystem  a JobSystem.  See @ref struct JobSystem.
+ * @param   pstCounter a JobCounter.  See @ref struct JobCounter.
+ * @ingroup Job
+ */
+void WaitForJobCounter(JobSystem *pstSystem, JobCounter *pstCounter)
+{
+    uint8_t u8Worker = _GetWorkerIndex(pstSystem);
+    Job     stJob;
+
+    while (SDL_AtomicGet(&pstCounter->stPending) > 0)
+    {
+        if (_FindJob(pstSystem, u8Worker, &stJob))
+        {
+            _Execute(pstSystem, u8Worker, &stJob);
+        }
+        else
+        {
+            SDL_Delay(0);
+        }
+    }
+}
@@ -0,0 +1,139 @@
+/**
+ * @file    Job.h
+ * @ingroup Job
+ */
+
+#ifndef _JOB_H_
+#define _JOB_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @ingroup Job
+ */
+enum JobLimits
+{
+    JOB_MAX_WORKERS = 16,
+    JOB_QUEUE_SIZE  = 1024
+};
+
+/**
+ * @brief   Job function.  Single jobs are called with the range [0, 1),
+ *          parallel-for jobs with a part of the whole range.
+ * @ingroup Job
+ */
+typedef void (*JobFunction)(void *pData, uint32_t u32Begin, uint32_t u32End);
+
+/**
+ * @brief   Instrumentation hook, called before and after each job.
+ *          Worker 0 is any thread which is not a worker, e.g. the main
+ *          thread helping out while it waits.
+ * @ingroup Job
+ */
+typedef void (*JobHook)(void *pHookData, uint8_t u8Worker, const char *pacName);
+
+/**
+ * @brief   Number of unfinished jobs.  A zero-initialised counter can
+ *          be passed to any number of jobs and waited for, which is how
+ *          dependencies are expressed.
+ * @ingroup Job
+ */
+typedef struct JobCounter_t
+{
+    SDL_atomic_t stPending;
+} JobCounter;
+
+/**
+ * @ingroup Job
+ */
+typedef struct Job_t
+{
+    JobFunction  pfnFunction;
+    void        *pData;
+    const char  *pacName;
+    JobCounter  *pstCounter;
+    uint32_t     u32Begin;
+    uint32_t     u32End;
+} Job;
+
+/**
+ * @brief   Double-ended queue of a worker.  The owner pushes and pops
+ *          at the bottom, other threads steal from the top.
+ * @ingroup Job
+ */
+typedef struct JobQueue_t
+{
+    Job          astJobs[JOB_QUEUE_SIZE];
+    SDL_SpinLock stLock;
+    uint32_t     u32Top;
+    uint32_t     u32Bottom;
+} JobQueue;
+
+/**
+ * @brief   stExecuted and stStolen count the jobs run and stolen by a
+ *          worker.  They are atomic since worker 0 is shared by several
+ *          threads.
+ * @ingroup Job
+ */
+typedef struct JobWorker_t
+{
+    struct JobSystem_t *pstSystem;
+    SDL_Thread         *pstThread;
+    SDL_threadID        ulThreadId;
+    JobQueue            stQueue;
+    SDL_atomic_t        stExecuted;
+    SDL_atomic_t        stStolen;
+    uint8_t             u8Index;
+} JobWorker;
+
+/**
+ * @brief   Work-stealing job system.  Worker 0 belongs to the thread
+ *          which created the system and to every other thread which is
+ *          not a worker; it is only run while such a thread waits.
+ *          pstStarted and pstStartup hold the workers back until
+ *          u8WorkerCount has been set.
+ * @ingroup Job
+ */
+typedef struct JobSystem_t
+{
+    JobWorker     astWorkers[JOB_MAX_WORKERS + 1];
+    SDL_sem      *pstSignal;
+    SDL_sem      *pstStarted;
+    SDL_mutex    *pstStartup;
+    SDL_atomic_t  stIsRunning;
+    JobHook       pfnBegin;
+    JobHook       pfnEnd;
+    void         *pHookData;
+    uint8_t       u8WorkerCount;
+} JobSystem;
+
+void FreeJobSystem(JobSystem *pstSystem);
+
+JobSystem *InitJobSystem(uint8_t u8WorkerCount);
+
+void RunJob(
+    JobSystem   *pstSystem,
+    const char  *pacName,
+    JobFunction  pfnFunction,
+    void        *pData,
+    JobCounter  *pstCounter);
+
+void RunParallelFor(
+    JobSystem   *pstSystem,
+    const char  *pacName,
+    JobFunction  pfnFunction,
+    void        *pData,
+    uint32_t     u32Count,
+    uint32_t     u32Grain,
+    JobCounter  *pstCounter);
+
+void SetJobHooks(
+    JobSystem *pstSystem,
+    JobHook    pfnBegin,
+    JobHook    pfnEnd,
+    void      *pHookData);
+
+void WaitForJobCounter(JobSystem *pstSystem, JobCounter *pstCounter);
+
+#endif
@@ -0,0 +1,583 @@
+/**
+ * @file      Log.c
+ * @ingroup   Log
+ * @defgroup  Log
+ * @brief     Asynchronous logging.  Callers capture the format and its
+ *            arguments into a lock-free ring buffer; a flusher thread
+ *            formats and writes them.  Every call site is rate limited,
+ *            so an error repeated every frame costs next to nothing.
+ *            Until InitLog() is called, or if the flusher can't be
+ *            started, messages are written right away.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Log.h"
+
+/**
+ * @brief   A conversion specification, e.g. "%-8.2f".
+ * @ingroup Log
+ */
+typedef struct LogSpec_t
+{
+    size_t  zLength;
+    size_t  zPrefixLength;
+    char    cConversion;
+    uint8_t u8Modifier;
+} LogSpec;
+
+/**
+ * @ingroup Log
+ */
+enum LogModifier
+{
+    LOG_MODIFIER_NONE = 0,
+    LOG_MODIFIER_LONG,
+    LOG_MODIFIER_LONG_LONG,
+    LOG_MODIFIER_SIZE
+};
+
+static Log         *_pstLog;
+static SDL_atomic_t _stWriters;
+
+static void _ParseSpec(const char *pacSpec, LogSpec *pstSpec)
+{
+    const char *pacChar = pacSpec + 1;
+
+    while (('\0' != *pacChar) && (NULL != strchr("-+ #0", *pacChar)))
+    {
+        pacChar++;
+    }
+    while ((('0' <= *pacChar) && ('9' >= *pacChar)) || ('.' == *pacChar))
+    {
+        pacChar++;
+    }
+    pstSpec->zPrefixLength = pacChar - pacSpec;
+    pstSpec->u8Modifier    = LOG_MODIFIER_NONE;
+
+    // Short arguments are promoted to int anyway.
+    while ('h' == *pacChar)
+    {
+        pacChar++;
+    }
+
+    if ('l' == *pacChar)
+    {
+        pacChar++;
+        pstSpec->u8Modifier = LOG_MODIFIER_LONG;
+        if ('l' == *pacChar)
+        {
+            pacChar++;
+            pstSpec->u8Modifier = LOG_MODIFIER_LONG_LONG;
+        }
+    }
+    else if ('z' == *pacChar)
+    {
+        pacChar++;
+        pstSpec->u8Modifier = LOG_MODIFIER_SIZE;
+    }
+
+    pstSpec->cConversion = *pacChar;
+    pstSpec->zLength     = pacChar - pacSpec + ('\0' != *pacChar);
+}
+
+static uint8_t _GetArgType(char cConversion)
+{
+    if ('\0' == cConversion)
+    {
+        return LOG_ARG_NONE;
+    }
+    if (NULL != strchr("dic", cConversion))
+    {
+        return LOG_ARG_SIGNED;
+    }
+    if (NULL != strchr("ouxX", cConversion))
+    {
+        return LOG_ARG_UNSIGNED;
+    }
+    if (NULL != strchr("fFeEgGaA", cConversion))
+    {
+        return LOG_ARG_DOUBLE;
+    }
+    if ('s' == cConversion)
+    {
+        return LOG_ARG_STRING;
+    }
+    if ('p' == cConversion)
+    {
+        return LOG_ARG_POINTER;
+    }
+
+    return LOG_ARG_NONE;
+}
+
+static int64_t _GetSigned(uint8_t u8Modifier, va_list *pstArgs)
+{
+    switch (u8Modifier)
+    {
+        case LOG_MODIFIER_LONG:
+            return va_arg(*pstArgs, long);
+        case LOG_MODIFIER_LONG_LONG:
+            return va_arg(*pstArgs, long long);
+        case LOG_MODIFIER_SIZE:
+            return (int64_t)va_arg(*pstArgs, size_t);
+        default:
+            return va_arg(*pstArgs, int);
+    }
+}
+
+static uint64_t _GetUnsigned(uint8_t u8Modifier, va_list *pstArgs)
+{
+    switch (u8Modifier)
+    {
+        case LOG_MODIFIER_LONG:
+            return va_arg(*pstArgs, unsigned long);
+        case LOG_MODIFIER_LONG_LONG:
+            return va_arg(*pstArgs, unsigned long long);
+        case LOG_MODIFIER_SIZE:
+            return va_arg(*pstArgs, size_t);
+        default:
+            return va_arg(*pstArgs, unsigned int);
+    }
+}
+
+static void _Capture(LogRecord *pstRecord, const char *pacFormat, va_list *pstArgs)
+{
+    size_t zStrings = 0;
+
+    pstRecord->pacFormat  = pacFormat;
+    pstRecord->u8ArgCount = 0;
+    pstRecord->acStrings[LOG_MAX_STRING_LENGTH - 1] = '\0';
+
+    for (const char *pacChar = pacFormat; '\0' != *pacChar; pacChar++)
+    {
+        LogSpec  stSpec;
+        LogArg  *pstArg;
+        uint8_t  u8Type;
+
+        if ('%' != *pacChar)
+        {
+            continue;
+        }
+
+        _ParseSpec(pacChar, &stSpec);
+        pacChar += stSpec.zLength - 1;
+
+        u8Type = _GetArgType(stSpec.cConversion);
+        if (LOG_ARG_NONE == u8Type)
+        {
+            continue;
+        }
+
+        // Anything beyond is printed as it is.
+        if (pstRecord->u8ArgCount >= LOG_MAX_ARGS)
+        {
+            break;
+        }
+
+        pstArg         = &pstRecord->astArgs[pstRecord->u8ArgCount];
+        pstArg->u8Type = u8Type;
+        pstRecord->u8ArgCount++;
+
+        switch (u8Type)
+        {
+            case LOG_ARG_SIGNED:
+                pstArg->unValue.s64Value = _GetSigned(stSpec.u8Modifier, pstArgs);
+                break;
+            case LOG_ARG_UNSIGNED:
+                pstArg->unValue.u64Value = _GetUnsigned(stSpec.u8Modifier, pstArgs);
+                break;
+            case LOG_ARG_DOUBLE:
+                pstArg->unValue.dValue = va_arg(*pstArgs, double);
+                break;
+            case LOG_ARG_POINTER:
+                pstArg->unValue.pValue = va_arg(*pstArgs, void *);
+                break;
+            case LOG_ARG_STRING:
+            {
+                // The string may be gone by the time it's flushed.
+                const char *pacString = va_arg(*pstArgs, const char *);
+                size_t      zCopy;
+
+                if (NULL == pacString)
+                {
+                    pacString = "(null)";
+                }
+
+                // Once the strings are used up, point at the final NUL.
+                if (zStrings >= LOG_MAX_STRING_LENGTH - 1)
+                {
+                    pstArg->unValue.u64Value = LOG_MAX_STRING_LENGTH - 1;
+                    break;
+                }
+
+                zCopy = strlen(pacString);
+                if (zCopy > LOG_MAX_STRING_LENGTH - 1 - zStrings)
+                {
+                    zCopy = LOG_MAX_STRING_LENGTH - 1 - zStrings;
+                }
+
+                memcpy(&pstRecord->acStrings[zStrings], pacString, zCopy);
+                pstRecord->acStrings[zStrings + zCopy] = '\0';
+                pstArg->unValue.u64Value = zStrings;
+                zStrings += zCopy + 1;
+                break;
+            }
+        }
+    }
+}
+
+static void _Format(const LogRecord *pstRecord, char *pacLine, size_t zSize)
+{
+    const char *pacChar  = pstRecord->pacFormat;
+    size_t      zLength  = 0;
+    uint8_t     u8Arg    = 0;
+
+    while (('\0' != *pacChar) && (zLength < zSize - 1))
+    {
+        const LogArg *pstArg;
+        LogSpec       stSpec;
+        char          acSpec[32];
+        int32_t       s32Written = 0;
+
+        if ('%' != *pacChar)
+        {
+            pacLine[zLength++] = *pacChar++;
+            continue;
+        }
+
+        _ParseSpec(pacChar, &stSpec);
+        if ('%' == stSpec.cConversion)
+        {
+            pacLine[zLength++] = '%';
+            pacChar += stSpec.zLength;
+            continue;
+        }
+
+        if ((LOG_ARG_NONE == _GetArgType(stSpec.cConversion)) ||
+            (u8Arg >= pstRecord->u8ArgCount) ||
+            (stSpec.zPrefixLength > sizeof(acSpec) - 4))
+        {
+            pacLine[zLength++] = *pacChar++;
+            continue;
+        }
+
+        // Integers were widened when captured.
+        pstArg = &pstRecord->astArgs[u8Arg++];
+        memcpy(acSpec, pacChar, stSpec.zPrefixLength);
+        acSpec[stSpec.zPrefixLength] = '\0';
+        if ((('c' != stSpec.cConversion) && (LOG_ARG_SIGNED == pstArg->u8Type)) ||
+            (LOG_ARG_UNSIGNED == pstArg->u8Type))
+        {
+            strcat(acSpec, "ll");
+        }
+        strncat(acSpec, &stSpec.cConversion, 1);
+
+        switch (pstArg->u8Type)
+        {
+            case LOG_ARG_SIGNED:
+                if ('c' == stSpec.cConversion)
+                {
+                    s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, (int)pstArg->unValue.s64Value);
+                }
+                else
+                {
+                    s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, (long long)pstArg->unValue.s64Value);
+                }
+                break;
+            case LOG_ARG_UNSIGNED:
+                s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, (unsigned long long)pstArg->unValue.u64Value);
+                break;
+            case LOG_ARG_DOUBLE:
+                s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, pstArg->unValue.dValue);
+                break;
+            case LOG_ARG_STRING:
+                s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, &pstRecord->acStrings[pstArg->unValue.u64Value]);
+                break;
+            case LOG_ARG_POINTER:
+                s32Written = snprintf(&pacLine[zLength], zSize - zLength, acSpec, pstArg->unValue.pValue);
+                break;
+        }
+
+        if (s32Written > 0)
+        {
+            zLength += (size_t)s32Written < zSize - zLength ? (size_t)s32Written : zSize - zLength - 1;
+        }
+        pacChar += stSpec.zLength;
+    }
+
+    pacLine[zLength] = '\0';
+}
+
+static void _Emit(uint8_t u8Level, char *pacLine, uint32_t u32Suppressed)
+{
+    FILE   *pstStream = (LOG_LEVEL_ERROR == u8Level) ? stderr : stdout;
+    size_t  zLength   = strlen(pacLine);
+
+    // Messages carried their own line breaks before.
+    while ((zLength > 0) && ('\n' == pacLine[zLength - 1]))
+    {
+        pacLine[--zLength] = '\0';
+    }
+
+    if (u32Suppressed > 0)
+    {
+        fprintf(pstStream, "%s (%u similar messages suppressed)\n", pacLine, (unsigned int)u32Suppressed);
+    }
+    else
+    {
+        fprintf(pstStream, "%s\n", pacLine);
+    }
+}
+
+static int8_t _Admit(LogSite *pstSite, uint32_t *pu32Suppressed)
+{
+    // 0 marks a site which never wrote anything.
+    uint32_t u32Now    = SDL_GetTicks() | 1;
+    uint32_t u32Window = (uint32_t)SDL_AtomicGet(&pstSite->stWindow);
+
+    *pu32Suppressed = 0;
+
+    // Only the thread which moves the window on resets the count.
+    if ((0 == u32Window) || (u32Now - u32Window >= LOG_SITE_INTERVAL))
+    {
+        if (SDL_AtomicCAS(&pstSite->stWindow, (int)u32Window, (int)u32Now))
+        {
+            SDL_AtomicSet(&pstSite->stCount, 0);
+        }
+    }
+
+    if (SDL_AtomicAdd(&pstSite->stCount, 1) >= LOG_SITE_BURST)
+    {
+        SDL_AtomicAdd(&pstSite->stSuppressed, 1);
+        return -1;
+    }
+
+    *pu32Suppressed = (uint32_t)SDL_AtomicSet(&pstSite->stSuppressed, 0);
+    return 0;
+}
+
+static LogRecord *_Claim(Log *pstLog, uint32_t *pu32Position)
+{
+    uint32_t u32Position = (uint32_t)SDL_AtomicGet(&pstLog->stTail);
+
+    for (;;)
+    {
+        LogRecord *pstRecord     = &pstLog->astRecords[u32Position & (LOG_RING_SIZE - 1)];
+        int32_t    s32Difference = (int32_t)((uint32_t)SDL_AtomicGet(&pstRecord->stSequence) - u32Position);
+
+        if (0 == s32Difference)
+        {
+            if (SDL_AtomicCAS(&pstLog->stTail, (int)u32Position, (int)(u32Position + 1)))
+            {
+                *pu32Position = u32Position;
+                return pstRecord;
+            }
+        }
+        else if (s32Difference < 0)
+        {
+            // The flusher is a full lap behind.
+            return NULL;
+        }
+
+        u32Position = (uint32_t)SDL_AtomicGet(&pstLog->stTail);
+    }
+}
+
+static void _Drain(Log *pstLog)
+{
+    char    acLine[LOG_MAX_LINE_LENGTH];
+    int32_t s32Dropped;
+
+    for (;;)
+    {
+        LogRecord *pstRecord = &pstLog->astRecords[pstLog->u32Head & (LOG_RING_SIZE - 1)];
+
+        if ((uint32_t)SDL_AtomicGet(&pstRecord->stSequence) != pstLog->u32Head + 1)
+        {
+            break;
+        }
+
+        // Don't read the record before it has been published.
+        SDL_MemoryBarrierAcquire();
+
+        _Format(pstRecord, acLine, LOG_MAX_LINE_LENGTH);
+        _Emit(pstRecord->u8Level, acLine, pstRecord->u32Suppressed);
+
+        // Hand the slot back to the producers of the next lap.
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&pstRecord->stSequence, (int)(pstLog->u32Head + LOG_RING_SIZE));
+        pstLog->u32Head++;
+    }
+
+    s32Dropped = SDL_AtomicSet(&pstLog->stDropped, 0);
+    if (s32Dropped > 0)
+    {
+        fprintf(stderr, "Log: %d messages dropped.\n", s32Dropped);
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+}
+
+static int32_t _Flush(void *pData)
+{
+    Log *pstLog = (Log *)pData;
+
+    while (SDL_AtomicGet(&pstLog->stIsRunning))
+    {
+        SDL_SemWaitTimeout(pstLog->pstWake, LOG_FLUSH_INTERVAL);
+        _Drain(pstLog);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Flush all pending messages and stop the flusher.  Messages
+ *          written afterwards are written right away.
+ * @ingroup Log
+ */
+void FreeLog(void)
+{
+    Log *pstLog = (Log *)SDL_AtomicSetPtr((void **)&_pstLog, NULL);
+
+    if (NULL == pstLog)
+    {
+        return;
+    }
+
+    /* Writers coming in from now on write right away; wait for those
+     * which still push into the ring. */
+    while (0 != SDL_AtomicGet(&_stWriters))
+    {
+        SDL_Delay(1);
+    }
+
+    SDL_AtomicSet(&pstLog->stIsRunning, 0);
+    if (NULL != pstLog->pstThread)
+    {
+        SDL_SemPost(pstLog->pstWake);
+        SDL_WaitThread(pstLog->pstThread, NULL);
+    }
+
+    // Whatever came in while the flusher shut down.
+    _Drain(pstLog);
+
+    if (NULL != pstLog->pstWake)
+    {
+        SDL_DestroySemaphore(pstLog->pstWake);
+    }
+    free(pstLog);
+}
+
+/**
+ * @brief   Start the flusher thread.  Should be called before any other
+ *          subsystem is initialised and freed after all of them.
+ * @return  0 on success, -1 on failure.  On failure, messages are
+ *          still written, just not asynchronously.
+ * @ingroup Log
+ */
+int8_t InitLog(void)
+{
+    static Log *pstLog;
+    pstLog = calloc(1, sizeof(struct Log_t));
+    if (NULL == pstLog)
+    {
+        fprintf(stderr, "InitLog(): error allocating memory.\n");
+        return -1;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < LOG_RING_SIZE; u32Index++)
+    {
+        SDL_AtomicSet(&pstLog->astRecords[u32Index].stSequence, (int)u32Index);
+    }
+
+    pstLog->pstWake = SDL_CreateSemaphore(0);
+    if (NULL == pstLog->pstWake)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        free(pstLog);
+        return -1;
+    }
+
+    SDL_AtomicSet(&pstLog->stIsRunning, 1);
+    pstLog->pstThread = SDL_CreateThread(_Flush, "Log", pstLog);
+    if (NULL == pstLog->pstThread)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        SDL_DestroySemaphore(pstLog->pstWake);
+        free(pstLog);
+        return -1;
+    }
+
+    SDL_AtomicSetPtr((void **)&_pstLog, pstLog);
+    return 0;
+}
+
+/**
+ * @brief   Write a message.  Only the arguments are captured here;
+ *          strings are copied, so they needn't outlive the call.  Use
+ *          LOG_ERROR() or LOG_INFO() rather than calling this directly.
+ * @param   pstSite   the LogSite of the caller.  See @ref struct LogSite.
+ * @param   u8Level   the LogLevel.
+ * @param   pacFormat a printf-style format which must stay valid until
+ *                    the message is flushed, i.e. a string literal.
+ * @ingroup Log
+ */
+void WriteLog(LogSite *pstSite, uint8_t u8Level, const char *pacFormat, ...)
+{
+    Log       *pstLog;
+    LogRecord *pstRecord;
+    va_list    stArgs;
+    uint32_t   u32Position;
+    uint32_t   u32Suppressed;
+
+    if (-1 == _Admit(pstSite, &u32Suppressed))
+    {
+        return;
+    }
+
+    va_start(stArgs, pacFormat);
+
+    // Keeps FreeLog() from freeing the ring while it is written to.
+    SDL_AtomicAdd(&_stWriters, 1);
+    pstLog = (Log *)SDL_AtomicGetPtr((void **)&_pstLog);
+
+    if ((NULL == pstLog) || ! SDL_AtomicGet(&pstLog->stIsRunning))
+    {
+        char acLine[LOG_MAX_LINE_LENGTH];
+
+        SDL_AtomicAdd(&_stWriters, -1);
+        vsnprintf(acLine, LOG_MAX_LINE_LENGTH, pacFormat, stArgs);
+        _Emit(u8Level, acLine, u32Suppressed);
+        va_end(stArgs);
+        return;
+    }
+
+    pstRecord = _Claim(pstLog, &u32Position);
+    if (NULL == pstRecord)
+    {
+        SDL_AtomicAdd(&pstLog->stDropped, 1);
+        SDL_AtomicAdd(&_stWriters, -1);
+        va_end(stArgs);
+        return;
+    }
+
+    pstRecord->u8Level       = u8Level;
+    pstRecord->u32Suppressed = u32Suppressed;
+    _Capture(pstRecord, pacFormat, &stArgs);
+    va_end(stArgs);
+
+    /* SDL_AtomicSet() only orders like an acquire, so make sure the
+     * record is complete before the flusher can see it. */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&pstRecord->stSequence, (int)(u32Position + 1));
+    SDL_AtomicAdd(&_stWriters, -1);
+}
@@ -0,0 +1,151 @@
+/**
+ * @file    Log.h
+ * @ingroup Log
+ */
+
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @brief   Write an error message to stderr.  Takes a printf-style
+ *          format, which must be a string literal.
+ * @ingroup Log
+ */
+#define LOG_ERROR(...) LOG_WRITE(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+/**
+ * @brief   Write an informational message to stdout.  Takes a
+ *          printf-style format, which must be a string literal.
+ * @ingroup Log
+ */
+#define LOG_INFO(...)  LOG_WRITE(LOG_LEVEL_INFO, __VA_ARGS__)
+
+/**
+ * @brief   Every call site gets a LogSite of its own, so a message
+ *          repeated every frame only suppresses itself.
+ * @ingroup Log
+ */
+#define LOG_WRITE(u8Level, ...)                          \
+    do                                                   \
+    {                                                    \
+        static LogSite _stLogSite;                       \
+        WriteLog(&_stLogSite, u8Level, __VA_ARGS__);     \
+    } while (0)
+
+/**
+ * @ingroup Log
+ */
+enum LogLimits
+{
+    LOG_RING_SIZE         = 256,
+    LOG_MAX_ARGS          = 8,
+    LOG_MAX_STRING_LENGTH = 256,
+    LOG_MAX_LINE_LENGTH   = 512,
+    LOG_SITE_BURST        = 5,
+    LOG_SITE_INTERVAL     = 1000,
+    LOG_FLUSH_INTERVAL    = 50
+};
+
+/**
+ * @ingroup Log
+ */
+enum LogLevel
+{
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_INFO
+};
+
+/**
+ * @ingroup Log
+ */
+enum LogArgType
+{
+    LOG_ARG_NONE = 0,
+    LOG_ARG_SIGNED,
+    LOG_ARG_UNSIGNED,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER
+};
+
+/**
+ * @brief   Rate limit of a call site.  At most LOG_SITE_BURST messages
+ *          pass per LOG_SITE_INTERVAL milliseconds; the next one that
+ *          passes reports how many were suppressed.
+ * @ingroup Log
+ */
+typedef struct LogSite_t
+{
+    SDL_atomic_t stWindow;
+    SDL_atomic_t stCount;
+    SDL_atomic_t stSuppressed;
+} LogSite;
+
+/**
+ * @brief   An argument captured by the caller.  Strings are copied into
+ *          the record, u64Value holds their offset.
+ * @ingroup Log
+ */
+typedef struct LogArg_t
+{
+    union
+    {
+        int64_t     s64Value;
+        uint64_t    u64Value;
+        double      dValue;
+        const void *pValue;
+    } unValue;
+    uint8_t u8Type;
+} LogArg;
+
+/**
+ * @brief   A message waiting to be formatted.  stSequence tells whether
+ *          the slot is free, being written or ready to be flushed.
+ * @ingroup Log
+ */
+typedef struct LogRecord_t
+{
+    SDL_atomic_t  stSequence;
+    const char   *pacFormat;
+    LogArg        astArgs[LOG_MAX_ARGS];
+    char          acStrings[LOG_MAX_STRING_LENGTH];
+    uint32_t      u32Suppressed;
+    uint8_t       u8Level;
+    uint8_t       u8ArgCount;
+} LogRecord;
+
+/**
+ * @brief   Multi-producer ring buffer drained by a flusher thread.
+ *          Callers only capture their arguments; formatting and output
+ *          happen on the flusher.  If the ring is full, messages are
+ *          dropped and counted rather than blocking the caller.
+ * @ingroup Log
+ */
+typedef struct Log_t
+{
+    LogRecord     astRecords[LOG_RING_SIZE];
+    SDL_atomic_t  stTail;
+    SDL_atomic_t  stDropped;
+    SDL_atomic_t  stIsRunning;
+    SDL_Thread   *pstThread;
+    SDL_sem      *pstWake;
+    uint32_t      u32Head;
+} Log;
+
+void FreeLog(void);
+
+int8_t InitLog(void);
+
+/* The format is only parsed on the flusher, so let the compiler check
+ * the arguments against it instead. */
+#ifdef __GNUC__
+void WriteLog(LogSite *pstSite, uint8_t u8Level, const char *pacFormat, ...)
+    __attribute__((format(printf, 3, 4)));
+#else
+void WriteLog(LogSite *pstSite, uint8_t u8Level, const char *pacFormat, ...);
+#endif
+
+#endif
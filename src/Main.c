@@ -7,19 +7,31 @@
 #include <SDL2/SDL.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "AABB.h"
+#include "Animation.h"
+#include "Asset.h"
 #include "Background.h"
+#include "Camera.h"
 #include "Config.h"
 #include "Entity.h"
+#include "Job.h"
+#include "Log.h"
 #include "Macros.h"
 #include "Map.h"
+#include "Memory.h"
+#include "Pack.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "Simulation.h"
+#include "SpriteBatch.h"
+#include "Startup.h"
 #include "Video.h"
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
-#define CAMERA_IS_LOCKED 0
 #define EXIT_UNSET       2
 static  int32_t _s32ExecStatus = EXIT_UNSET;
 
@@ -30,27 +42,85 @@ static  int32_t _s32ExecStatus = EXIT_UNSET;
  */
 typedef struct MainLoopBundle_t
 {
-    Background *pstBG[5];
-    Entity     *pstSam;
-    Map        *pstMap;
-    Video      *pstVideo;
-    double      dTimeA;
-    double      dTimeB;
-    double      dDeltaTime;
-    double      dCameraPosX;
-    double      dCameraPosY;
-    double      dCameraMaxPosX;
-    double      dCameraMaxPosY;
+    AssetManager   *pstAssets;
+    Background     *pstBG;
+    Map            *pstMap;
+    RenderQueue    *pstQueue;
+    Scene          *pstScene;
+    Simulation     *pstSimulation;
+    StartupProfile *pstProfile;
+    Video          *pstVideo;
+    double          dTimeA;
+    double          dTimeB;
+    double          dDeltaTime;
+    double          dStatsTime;
+    uint8_t         u8ShowStats;
+    uint8_t         u8StartupOnly;
 } MainLoopBundle;
 
+static void _ReportMapCache(const Map *pstMap)
+{
+    MapCacheStats stCache    = GetMapCacheStats(pstMap);
+    uint32_t      u32Lookups = stCache.u32Hits + stCache.u32Misses;
+
+    LOG_INFO(
+        "Map cache: %u hits, %u misses (%.1f%% hit rate), %u prefetched, worst hitch %.2f ms",
+        stCache.u32Hits,
+        stCache.u32Misses,
+        u32Lookups ? 100.0 * stCache.u32Hits / u32Lookups : 100.0,
+        stCache.u32Prefetched,
+        stCache.dWorstHitch);
+}
+
+/* Print the statistics of the frame just drawn, at most once per
+ * second. */
+static void _ReportFrameStats(MainLoopBundle *pstBundle)
+{
+    MapStats         stMapStats;
+    SpriteBatchStats stSpriteStats;
+
+    pstBundle->dStatsTime += pstBundle->dDeltaTime;
+    if (pstBundle->dStatsTime < 1)
+    {
+        return;
+    }
+    pstBundle->dStatsTime = 0;
+
+    stMapStats = GetMapStats(pstBundle->pstMap);
+    LOG_INFO(
+        "Map: %u px blended, %u px opaque, %u px skipped, %u chunks skipped, %u mipmapped",
+        stMapStats.u32BlendedPixels,
+        stMapStats.u32OpaquePixels,
+        stMapStats.u32SkippedPixels,
+        stMapStats.u32SkippedChunks,
+        stMapStats.u32MipmappedChunks);
+    _ReportMapCache(pstBundle->pstMap);
+
+    stSpriteStats = GetSpriteBatchStats(pstBundle->pstScene->pstSprites);
+    LOG_INFO(
+        "Sprites: %u drawn in %u batches, %u culled, %u missing",
+        stSpriteStats.u32Sprites,
+        stSpriteStats.u32Batches,
+        stSpriteStats.u32Culled,
+        stSpriteStats.u32Missing);
+}
+
 static void _MainLoop(void *pArg)
 {
-    uint16_t        u16Flags  = 0;
     MainLoopBundle *pstBundle = (MainLoopBundle *)pArg;
     pstBundle->dTimeB         = SDL_GetTicks();
     pstBundle->dDeltaTime     = (pstBundle->dTimeB - pstBundle->dTimeA) / 1000;
     pstBundle->dTimeA         = pstBundle->dTimeB;
 
+    const SimulationSnapshot *pstSnapshot;
+    Camera                    stView;
+    uint16_t                  u16Input = 0;
+
+    BeginVideoFrame(pstBundle->pstVideo);
+
+    // Images decoded since the last frame become textures here.
+    UploadAssets(pstBundle->pstAssets);
+
     // Process keyboard input.
     const uint8_t *u8KeyState;
     SDL_PumpEvents();
@@ -60,9 +130,6 @@ static void _MainLoop(void *pArg)
     }
     u8KeyState = SDL_GetKeyboardState(NULL);
 
-    // Reset ENTITY_IS_MOVING flag (in case no key is pressed).
-    FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_IS_MOVING);
-
     #ifndef __EMSCRIPTEN__
     if (u8KeyState[SDL_SCANCODE_Q])
     {
@@ -70,196 +137,73 @@ static void _MainLoop(void *pArg)
     }
     #endif
 
-    if (u8KeyState[SDL_SCANCODE_0])
-    {
-        SetVideoZoomLevel(
-            pstBundle->pstVideo,
-            pstBundle->pstVideo->dZoomLevelInitial);
-    }
+    if (u8KeyState[SDL_SCANCODE_0])     { FLAG_SET(u16Input, SIMULATION_INPUT_ZOOM_RESET); }
+    if (u8KeyState[SDL_SCANCODE_1])     { FLAG_SET(u16Input, SIMULATION_INPUT_ZOOM_OUT);   }
+    if (u8KeyState[SDL_SCANCODE_2])     { FLAG_SET(u16Input, SIMULATION_INPUT_ZOOM_IN);    }
+    if (u8KeyState[SDL_SCANCODE_LEFT])  { FLAG_SET(u16Input, SIMULATION_INPUT_LEFT);       }
+    if (u8KeyState[SDL_SCANCODE_RIGHT]) { FLAG_SET(u16Input, SIMULATION_INPUT_RIGHT);      }
 
-    if (u8KeyState[SDL_SCANCODE_1])
-    {
-        pstBundle->pstVideo->dZoomLevel -= pstBundle->dDeltaTime;
-        SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
-    }
-
-    if (u8KeyState[SDL_SCANCODE_2])
-    {
-        pstBundle->pstVideo->dZoomLevel += pstBundle->dDeltaTime;
-        SetVideoZoomLevel(pstBundle->pstVideo, pstBundle->pstVideo->dZoomLevel);
-    }
+    SetSimulationInput(pstBundle->pstSimulation, u16Input);
 
-    if (u8KeyState[SDL_SCANCODE_LEFT])
+    // Without a simulation thread, the simulation steps along with the frame.
+    if (NULL == pstBundle->pstSimulation->pstThread)
     {
-        FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_MOVING);
-        FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION);
+        StepSimulation(pstBundle->pstSimulation, pstBundle->dDeltaTime);
     }
 
-    if (u8KeyState[SDL_SCANCODE_RIGHT])
-    {
-        FLAG_SET(pstBundle->pstSam->u16Flags,   ENTITY_IS_MOVING);
-        FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION);
-    }
+    /* Everything drawn below reads the latest snapshot only.  The view
+     * is a copy of its Camera scaled to the current resolution. */
+    pstSnapshot = GetSimulationSnapshot(pstBundle->pstSimulation);
+    stView      = pstSnapshot->stCamera;
+    SetCameraResolutionScale(&stView, pstBundle->pstVideo->stResolution.dScale);
 
-    // Set camera position.
-    pstBundle->dCameraPosX =
-        pstBundle->pstSam->dWorldPosX         -
-        pstBundle->pstVideo->s32WindowWidth   /
-        (pstBundle->pstVideo->dZoomLevel * 2) +
-        (pstBundle->pstSam->u8Width      / 2);
+    // Scroll background along with the camera.
+    UpdateBackground(pstBundle->pstBG, &stView);
 
-    pstBundle->dCameraPosY =
-        pstBundle->pstSam->dWorldPosY         -
-        pstBundle->pstVideo->s32WindowHeight  /
-        (pstBundle->pstVideo->dZoomLevel * 2) +
-        (pstBundle->pstSam->u8Height     / 2);
+    #ifdef __EMSCRIPTEN__
+    SDL_RenderClear(pstBundle->pstVideo->pstRenderer);
+    #endif
 
-    UpdateEntity(pstBundle->pstSam, pstBundle->dDeltaTime);
+    // Render scene.
+    ResetMapStats(pstBundle->pstMap);
+    ResetSpriteBatchStats(pstBundle->pstScene->pstSprites);
 
-    if (FLAG_IS_NOT_SET(pstBundle->pstSam->u16Flags, ENTITY_DIRECTION))
-    {
-        for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
-        {
-            FLAG_SET(
-                pstBundle->pstBG[u8Index]->u16Flags,
-                BACKGROUND_SCROLL_DIRECTION);
-        }
-    }
+    DrawScene(
+        pstBundle->pstVideo->pstRenderer,
+        pstBundle->pstQueue,
+        pstBundle->pstScene,
+        pstBundle->pstBG,
+        pstBundle->pstMap,
+        pstSnapshot->pstEntities,
+        &stView);
 
-    // Set camera boundaries to map size.
-    pstBundle->dCameraMaxPosX = pstBundle->pstMap->u32Width -
-        (pstBundle->pstVideo->s32WindowWidth  / pstBundle->pstVideo->dZoomLevel);
-    pstBundle->dCameraMaxPosY = pstBundle->pstMap->u32Height -
-        (pstBundle->pstVideo->s32WindowHeight / pstBundle->pstVideo->dZoomLevel);
+    DrawRenderQueue(pstBundle->pstVideo->pstRenderer, pstBundle->pstQueue);
 
-    if (pstBundle->dCameraPosX < 0)
-    {
-        FLAG_SET(u16Flags, CAMERA_IS_LOCKED);
-        pstBundle->dCameraPosX = 0;
-    }
-    else if (pstBundle->dCameraPosX > pstBundle->dCameraMaxPosX)
+    if (pstBundle->u8ShowStats)
     {
-        FLAG_SET(u16Flags, CAMERA_IS_LOCKED);
-        pstBundle->dCameraPosX = pstBundle->dCameraMaxPosX;
-    }
-    else
-    {
-        FLAG_CLEAR(u16Flags, CAMERA_IS_LOCKED);
+        _ReportFrameStats(pstBundle);
     }
 
-    if (pstBundle->dCameraPosY < 0)
-    {
-        pstBundle->dCameraPosY = 0;
-    }
-    else if (pstBundle->dCameraPosY > pstBundle->dCameraMaxPosY)
-    {
-        pstBundle->dCameraPosY = pstBundle->dCameraMaxPosY;
-    }
+    UpdateVideo(pstBundle->pstVideo);
 
-    // Scroll background if camera is not locked.
-    if (FLAG_IS_NOT_SET(u16Flags, CAMERA_IS_LOCKED))
-    {
-        pstBundle->pstBG[4]->dVelocity = pstBundle->pstSam->dVelocityX  * pstBundle->dDeltaTime;
-    }
-    else
+    // The startup ends with the first presented frame.
+    if ((NULL != pstBundle->pstProfile) && ! pstBundle->pstProfile->u8IsReported)
     {
-        pstBundle->pstBG[4]->dVelocity = 0;
-    }
-
-    pstBundle->pstBG[3]->dVelocity = pstBundle->pstBG[4]->dVelocity / 2;
-    pstBundle->pstBG[2]->dVelocity = pstBundle->pstBG[4]->dVelocity / 3;
-    pstBundle->pstBG[1]->dVelocity = pstBundle->pstBG[4]->dVelocity / 4;
-    pstBundle->pstBG[0]->dVelocity = pstBundle->pstBG[4]->dVelocity / 5;
-
-    // Set sprite animation.
-    if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IDLING))
-    {
-        SetEntitySpriteAnimation(pstBundle->pstSam, 0, 11, 0, 10);
-    }
-    if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IN_MID_AIR))
-    {
-        if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_JUMPING))
-        {
-            SetEntitySpriteAnimation(pstBundle->pstSam, 14, 14, 0, 20);
-        }
-        else
+        ReportStartupProfile(pstBundle->pstProfile, pstBundle->pstAssets);
+        if (pstBundle->u8StartupOnly)
         {
-            /* If the entity is in mid air but isn't jumping, it is
-             * falling downwards. */
-            SetEntitySpriteAnimation(pstBundle->pstSam, 14, 14, 1, 20);
+            _s32ExecStatus = EXIT_SUCCESS;
         }
     }
-    if (FLAG_IS_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_MOVING))
-    {
-        SetEntitySpriteAnimation(pstBundle->pstSam, 0, 7, 1, 20);
-    }
-    FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IDLING);
-
-    // Set up collision detection.
-    if (IsMapCoordOfType(
-            pstBundle->pstMap,
-            "Floor",
-            pstBundle->pstSam->dWorldPosX + pstBundle->pstSam->u8Width,
-            pstBundle->pstSam->dWorldPosY + pstBundle->pstSam->u8Height))
-    {
-        FLAG_CLEAR(pstBundle->pstSam->u16Flags, ENTITY_IS_IN_MID_AIR);
-    }
-    else
-    {
-        FLAG_SET(pstBundle->pstSam->u16Flags, ENTITY_IS_IN_MID_AIR);
-    }
-
-    #ifdef __EMSCRIPTEN__
-    SDL_RenderClear(pstBundle->pstVideo->pstRenderer);
-    #endif
-
-    // Render scene.
-    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
-    {
-        DrawBackground(
-            pstBundle->pstVideo->pstRenderer,
-            pstBundle->pstBG[u8Index],
-            pstBundle->dCameraPosY);
-
-            FLAG_CLEAR(
-                pstBundle->pstBG[u8Index]->u16Flags,
-                BACKGROUND_SCROLL_DIRECTION);
-    }
-
-    DrawMap(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstMap,
-        "Background",
-        1,
-        0,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
-
-    DrawEntity(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstSam,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
 
-    DrawMap(
+    /* Bake what is about to become visible.  This happens after the
+     * present, so it doesn't count towards the frame time measured for
+     * dynamic resolution and doesn't delay the frame on screen. */
+    PrefetchMap(
         pstBundle->pstVideo->pstRenderer,
         pstBundle->pstMap,
-        "World",
-        0,
-        1,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
-
-    DrawMap(
-        pstBundle->pstVideo->pstRenderer,
-        pstBundle->pstMap,
-        "Foreground",
-        0,
-        2,
-        pstBundle->dCameraPosX,
-        pstBundle->dCameraPosY);
-
-    UpdateVideo(pstBundle->pstVideo->pstRenderer);
+        &stView,
+        pstBundle->dDeltaTime);
 
     #ifdef __EMSCRIPTEN__
     if (EXIT_UNSET != _s32ExecStatus)
@@ -271,32 +215,86 @@ static void _MainLoop(void *pArg)
 
 int32_t main(int32_t s32ArgC, char *pacArgV[])
 {
-    Background     *pstBG[5]  = { NULL };
-    MainLoopBundle *pstBundle = NULL;
+    Background     *pstBG         = NULL;
+    AnimationSheet *pstSheet      = NULL;
+    AssetManager   *pstAssets     = NULL;
+    Camera         *pstCamera     = NULL;
+    MainLoopBundle *pstBundle     = NULL;
     Config          stConfig;
-    Entity         *pstSam    = NULL;
-    Map            *pstMap    = NULL;
-    Video          *pstVideo  = NULL;
+    Entity         *pstSam        = NULL;
+    JobSystem      *pstJobs       = NULL;
+    Map            *pstMap        = NULL;
+    Pack           *pstPack       = NULL;
+    RenderQueue    *pstQueue      = NULL;
+    Scene          *pstScene      = NULL;
+    Simulation     *pstSim        = NULL;
+    StartupProfile *pstProfile;
+    Video          *pstVideo      = NULL;
+    const char     *pacConfig     = NULL;
+    uint8_t         u8ShowStats   = 0;
+    uint8_t         u8StartupOnly = 0;
+
+    // Runs without profiling if it cannot be allocated.
+    pstProfile = InitStartupProfile();
+
+    // Logs synchronously if the flusher cannot be started.
+    #ifndef __EMSCRIPTEN__
+    InitLog();
+    #endif
 
-    if (s32ArgC > 1)
+    for (int32_t s32Index = 1; s32Index < s32ArgC; s32Index++)
     {
-        stConfig = InitConfig(pacArgV[1]);
+        // Exit after the first frame, e.g. to measure cold starts.
+        if (0 == strcmp(pacArgV[s32Index], "--startup-only"))
+        {
+            u8StartupOnly = 1;
+        }
+        else if (0 == strcmp(pacArgV[s32Index], "--stats"))
+        {
+            // Print the draw statistics once per second.
+            u8ShowStats = 1;
+        }
+        else
+        {
+            pacConfig = pacArgV[s32Index];
+        }
     }
-    else
+
+    if (NULL == pacConfig)
     {
         #ifndef __EMSCRIPTEN__
-        stConfig = InitConfig("default.ini");
+        pacConfig = "default.ini";
         #else
-        stConfig = InitConfig("emscripten.ini");
+        pacConfig = "emscripten.ini";
         #endif
     }
 
+    BeginStartupPhase(pstProfile, "InitConfig", pacConfig);
+    stConfig = InitConfig(pacConfig);
+
+    SetMemoryBudget(MEMORY_TAG_ANIMATION,  (size_t)stConfig.stMemory.s32AnimationBudget  * 1024);
+    SetMemoryBudget(MEMORY_TAG_ASSET,      (size_t)stConfig.stMemory.s32AssetBudget      * 1024);
+    SetMemoryBudget(MEMORY_TAG_BACKGROUND, (size_t)stConfig.stMemory.s32BackgroundBudget * 1024);
+    SetMemoryBudget(MEMORY_TAG_CAMERA,     (size_t)stConfig.stMemory.s32CameraBudget     * 1024);
+    SetMemoryBudget(MEMORY_TAG_CORE,       (size_t)stConfig.stMemory.s32CoreBudget       * 1024);
+    SetMemoryBudget(MEMORY_TAG_ENTITY,     (size_t)stConfig.stMemory.s32EntityBudget     * 1024);
+    SetMemoryBudget(MEMORY_TAG_MAP,        (size_t)stConfig.stMemory.s32MapBudget        * 1024);
+    SetMemoryBudget(MEMORY_TAG_PACK,       (size_t)stConfig.stMemory.s32PackBudget       * 1024);
+    SetMemoryBudget(MEMORY_TAG_RENDERER,   (size_t)stConfig.stMemory.s32RendererBudget   * 1024);
+    SetMemoryBudget(MEMORY_TAG_SCENE,      (size_t)stConfig.stMemory.s32SceneBudget      * 1024);
+    SetMemoryBudget(MEMORY_TAG_SIMULATION, (size_t)stConfig.stMemory.s32SimulationBudget * 1024);
+    SetMemoryBudget(MEMORY_TAG_TMX,        (size_t)stConfig.stMemory.s32TmxBudget        * 1024);
+
+    BeginStartupPhase(pstProfile, "InitVideo", NULL);
+
     pstVideo = InitVideo(
         "Boondock Sam",
         stConfig.stVideo.s32Width,
         stConfig.stVideo.s32Height,
         stConfig.stVideo.s8Fullscreen,
-        1 + stConfig.stVideo.s32Height / 216); // 216 = Background height.
+        1 + stConfig.stVideo.s32Height / 216, // 216 = Background height.
+        stConfig.stVideo.s32NativeWidth,
+        stConfig.stVideo.s32NativeHeight);
     if (NULL == pstVideo)
     {
         _s32ExecStatus = EXIT_FAILURE;
@@ -304,71 +302,187 @@ int32_t main(int32_t s32ArgC, char *pacArgV[])
     }
     atexit(SDL_Quit);
 
-    pstMap = InitMap("res/maps/demo.tmx", "res/tilesets/jungle.png");
-    if (NULL == pstMap)
+    if (stConfig.stVideo.s8DynamicResolution)
+    {
+        if (-1 == SetVideoDynamicResolution(
+                pstVideo,
+                stConfig.stVideo.s8MinResolution / 100.0,
+                1000.0 / stConfig.stVideo.s8FPS))
+        {
+            _s32ExecStatus = EXIT_FAILURE;
+            goto quit;
+        }
+    }
+
+    #ifndef __EMSCRIPTEN__
+    if (0 > stConfig.stJobs.s8Workers)
+    {
+        stConfig.stJobs.s8Workers = SDL_max(SDL_GetCPUCount() - 1, 0);
+    }
+    #else
+    stConfig.stJobs.s8Workers = 0;
+    #endif
+
+    BeginStartupPhase(pstProfile, "InitJobSystem", NULL);
+    pstJobs = InitJobSystem(stConfig.stJobs.s8Workers);
+    if (NULL == pstJobs)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    // Without an archive, everything is read from res/ instead.
+    BeginStartupPhase(pstProfile, "InitPack", "res.pack");
+    pstPack = InitPack("res.pack");
+
+    // Images are decoded on the workers from here on.
+    BeginStartupPhase(pstProfile, "InitAssetManager", NULL);
+    pstAssets = InitAssetManager(pstVideo->pstRenderer, pstJobs, pstPack);
+    if (NULL == pstAssets)
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
 
-    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    #ifndef __EMSCRIPTEN__
+    if (stConfig.stAssets.s8TextureCache)
     {
-        const char *pacBackgroundList[5] = {
-            "res/backgrounds/plx-1.png",
-            "res/backgrounds/plx-2.png",
-            "res/backgrounds/plx-3.png",
-            "res/backgrounds/plx-4.png",
-            "res/backgrounds/plx-5.png"
-        };
-
-        pstBG[u8Index] = InitBackground(
-            pstVideo->pstRenderer,
-            pacBackgroundList[u8Index],
-            pstVideo->s32WindowWidth);
-
-        if (NULL == pstBG[u8Index])
+        char *pacCacheDirectory = SDL_GetPrefPath("mupfelofen-de", "boondock-sam");
+
+        // Without a cache directory, images are simply decoded each time.
+        if (NULL != pacCacheDirectory)
         {
-            _s32ExecStatus = EXIT_FAILURE;
-            goto quit;
+            SetAssetCache(pstAssets, pacCacheDirectory);
+            SDL_free(pacCacheDirectory);
         }
+    }
+    #endif
+
+    BeginStartupPhase(pstProfile, "InitMap", "res/maps/demo.tmx");
+    pstMap = InitMap("res/maps/demo.tmx", "res/tilesets/jungle.png", pstAssets);
+    if (NULL == pstMap)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
 
-        pstBG[u8Index]->dWorldPosY = pstMap->u32Height - pstBG[u8Index]->s32Height;
+    pstMap->u8MipmapCount      = SDL_min(stConfig.stVideo.s8Mipmaps, MAP_MAX_MIPMAPS);
+    pstMap->u32PrefetchBudget  = stConfig.stMap.s32PrefetchBudget;
+    pstMap->u16PrefetchChunks  = stConfig.stMap.s16PrefetchChunks;
+    pstMap->dPrefetchLookahead = stConfig.stMap.dPrefetchLookahead;
+
+    BeginStartupPhase(pstProfile, "InitCamera", NULL);
+    pstCamera = InitCamera(pstVideo, pstMap->pstTmxMap, pstVideo->dZoomLevel);
+    if (NULL == pstCamera)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
     }
+    pstCamera->dDeadzoneWidth  = stConfig.stCamera.dDeadzoneWidth;
+    pstCamera->dDeadzoneHeight = stConfig.stCamera.dDeadzoneHeight;
+    pstCamera->dSmoothing      = stConfig.stCamera.dSmoothing;
 
+    BeginStartupPhase(pstProfile, "InitEntity", NULL);
     pstSam = InitEntity(24, 40, 264, 200, pstMap->u32Width);
     if (NULL == pstSam)
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
-    if (-1 == LoadEntitySprite(pstSam, pstVideo->pstRenderer, "res/sprites/sam.png"))
+    if (-1 == LoadEntitySprite(pstSam, pstAssets, "res/sprites/sam.png"))
     {
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
 
-    pstBundle = malloc(sizeof(struct MainLoopBundle_t));
-    if (NULL == pstBundle)
+    // Waits for the background layers only; the rest keeps loading.
+    BeginStartupPhase(pstProfile, "InitBackground", "res/backgrounds/jungle.ini");
+    pstBG = InitBackground(pstAssets, "res/backgrounds/jungle.ini");
+    if (NULL == pstBG)
     {
-        fprintf(stderr, "stBundle: error allocating memory.\n");
         _s32ExecStatus = EXIT_FAILURE;
         goto quit;
     }
+    pstBG->dWorldPosY = pstMap->u32Height - pstBG->s32Height;
 
-    pstBundle->pstVideo       = pstVideo;
-    pstBundle->pstMap         = pstMap;
-    pstBundle->pstSam         = pstSam;
-    pstBundle->dTimeA         = SDL_GetTicks();
-    pstBundle->dCameraPosX    = 0;
-    pstBundle->dCameraPosY    = 0;
-    pstBundle->dCameraMaxPosX = 0;
-    pstBundle->dCameraMaxPosY = 0;
+    BeginStartupPhase(pstProfile, "InitAnimationSheet", "res/sprites/sam.ini");
+    pstSheet = InitAnimationSheet(pstPack, "res/sprites/sam.ini");
+    if (NULL == pstSheet)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+    SetEntityAnimationSheet(pstSam, pstSheet);
+
+    BeginStartupPhase(pstProfile, "InitScene", NULL);
+    pstQueue = InitRenderQueue();
+    if (NULL == pstQueue)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstScene = InitScene(pstMap);
+    if (NULL == pstScene)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+    if (-1 == AddSceneEntity(pstScene, pstSam, 0))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    pstScene->pstJobs = pstJobs;
+    pstMap->pstJobs   = pstJobs;
+
+    BeginStartupPhase(pstProfile, "WaitForAssets", NULL);
+    if (-1 == WaitForAssets(pstAssets))
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    BeginStartupPhase(pstProfile, "InitSimulation", NULL);
+    pstSim = InitSimulation(pstScene, pstCamera, pstMap, pstSam);
+    if (NULL == pstSim)
+    {
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
+    }
+
+    #ifndef __EMSCRIPTEN__
+    if (stConfig.stSimulation.s8Threaded)
+    {
+        // Stay single-threaded if the thread cannot be started.
+        StartSimulationThread(pstSim, stConfig.stSimulation.s16Rate);
+    }
+    #endif
 
-    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    pstBundle = AllocMemory(MEMORY_TAG_CORE, sizeof(struct MainLoopBundle_t));
+    if (NULL == pstBundle)
     {
-        pstBundle->pstBG[u8Index] = pstBG[u8Index];
+        LOG_ERROR("stBundle: error allocating memory.");
+        _s32ExecStatus = EXIT_FAILURE;
+        goto quit;
     }
 
+    pstBundle->pstVideo      = pstVideo;
+    pstBundle->pstMap        = pstMap;
+    pstBundle->dTimeA        = SDL_GetTicks();
+    pstBundle->pstAssets     = pstAssets;
+    pstBundle->pstBG         = pstBG;
+    pstBundle->pstQueue      = pstQueue;
+    pstBundle->pstScene      = pstScene;
+    pstBundle->pstSimulation = pstSim;
+    pstBundle->pstProfile    = pstProfile;
+    pstBundle->dStatsTime    = 0;
+    pstBundle->u8ShowStats   = u8ShowStats;
+    pstBundle->u8StartupOnly = u8StartupOnly;
+
+    BeginStartupPhase(pstProfile, "FirstFrame", NULL);
+
     #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop_arg(_MainLoop, (void *)pstBundle, 0, 1);
     #else
@@ -385,14 +499,28 @@ int32_t main(int32_t s32ArgC, char *pacArgV[])
     #endif
 
 quit:
-    for (uint8_t u8Index = 0; u8Index < 5; u8Index++)
+    // Peaks cover the whole run.
+    ReportMemory();
+    if (NULL != pstMap)
     {
-        free(pstBG[u8Index]);
+        _ReportMapCache(pstMap);
     }
+
+    FreeSimulation(pstSim);
+    FreeBackground(pstBG);
     FreeMap(pstMap);
-    free(pstSam);
-    free(pstBundle);
+    FreeRenderQueue(pstQueue);
+    FreeScene(pstScene);
+    FreeAnimationSheet(pstSheet);
+    FreeAssetManager(pstAssets);
+    FreeJobSystem(pstJobs);
+    FreePack(pstPack);
+    FreeMemory(pstCamera);
+    FreeMemory(pstSam);
+    FreeMemory(pstBundle);
+    FreeStartupProfile(pstProfile);
     TerminateVideo(pstVideo);
+    FreeLog();
 
     return _s32ExecStatus;
 }
@@ -8,15 +8,969 @@
  */
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
 #include <stdint.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "tmx/tmx.h"
+#include "tmx/tsx.h"
+#include "Asset.h"
+#include "Camera.h"
+#include "Job.h"
+#include "Log.h"
 #include "Map.h"
+#include "Memory.h"
+#include "Pack.h"
+#include "RenderQueue.h"
+
+#if defined(__SSE2__)
+#define MAP_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief This structure is shared by the jobs baking a list of chunks.
+ * Each item of the list is a chunk index times MAP_MAX_LAYERS plus the
+ * layer index.
+ */
+typedef struct MapBake_t
+{
+    Map            *pstMap;
+    const uint32_t *pu32Items;
+    SDL_atomic_t    stError;
+} MapBake;
+
+static int8_t _ClassifyTiles(Map *pstMap, SDL_Surface *pstTileset)
+{
+    tmx_map *pstTmxMap = pstMap->pstTmxMap;
+
+    pstMap->pu8TileIsOpaque = AllocZeroedMemory(MEMORY_TAG_MAP, pstTmxMap->tilecount, sizeof(uint8_t));
+    if (NULL == pstMap->pu8TileIsOpaque)
+    {
+        LOG_ERROR("DrawMap(): error allocating memory.");
+        return -1;
+    }
+
+    if (0 != SDL_LockSurface(pstTileset))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    // A tile is opaque if the alpha value of each of its pixels is 255.
+    for (uint32_t u32Gid = 0; u32Gid < pstTmxMap->tilecount; u32Gid++)
+    {
+        tmx_tile *pstTile = pstTmxMap->tiles[u32Gid];
+        uint8_t   u8IsOpaque = 1;
+
+        if (NULL == pstTile)
+        {
+            continue;
+        }
+
+        if ((pstTile->ul_x + pstTile->tileset->tile_width  > (uint32_t)pstTileset->w) ||
+            (pstTile->ul_y + pstTile->tileset->tile_height > (uint32_t)pstTileset->h))
+        {
+            continue;
+        }
+
+        for (uint32_t u32Y = 0; u8IsOpaque && u32Y < pstTile->tileset->tile_height; u32Y++)
+        {
+            const uint32_t *pu32Row = (const uint32_t *)(
+                (const uint8_t *)pstTileset->pixels +
+                (pstTile->ul_y + u32Y) * pstTileset->pitch) + pstTile->ul_x;
+
+            for (uint32_t u32X = 0; u32X < pstTile->tileset->tile_width; u32X++)
+            {
+                if (0xFF != (pu32Row[u32X] >> 24))
+                {
+                    u8IsOpaque = 0;
+                    break;
+                }
+            }
+        }
+
+        pstMap->pu8TileIsOpaque[u32Gid] = u8IsOpaque;
+    }
+
+    SDL_UnlockSurface(pstTileset);
+
+    return 0;
+}
+
+/* A layer group is every visible tile layer whose name contains the
+ * name of the group. */
+static uint8_t _IsLayerInGroup(const tmx_layer *pstLayer, const char *pacLayerName)
+{
+    return (L_LAYER == pstLayer->type) &&
+           (pstLayer->visible)         &&
+           (NULL != strstr(pstLayer->name, pacLayerName));
+}
+
+/* Tell whether a layer belongs to any layer group set up so far
+ * which is drawn in front of the Background. */
+static uint8_t _IsLayerOccluding(const Map *pstMap, const tmx_layer *pstLayer)
+{
+    for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+    {
+        if ((NULL != pstMap->pstChunks[u8Index])      &&
+            (pstMap->u8OccluderMask & (1 << u8Index)) &&
+            (_IsLayerInGroup(pstLayer, pstMap->aacLayerNames[u8Index])))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Rebuilt whenever a layer group is set up or the occluders change,
+ * so only layers which are actually drawn in front of the Background
+ * hide it. */
+static int8_t _BuildCoverage(Map *pstMap)
+{
+    tmx_map   *pstTmxMap = pstMap->pstTmxMap;
+    tmx_layer *pstLayers = pstTmxMap->ly_head;
+    uint32_t   u32Count  = pstMap->u16ChunkCountX * pstMap->u16ChunkCountY;
+    uint8_t   *pu8IsOpaque;
+
+    if (NULL == pstMap->pstCoverage)
+    {
+        pstMap->pstCoverage = AllocZeroedMemory(MEMORY_TAG_MAP, u32Count, sizeof(struct MapCoverage_t));
+    }
+    pu8IsOpaque = AllocZeroedMemory(MEMORY_TAG_MAP, pstTmxMap->width * pstTmxMap->height, sizeof(uint8_t));
+    if ((NULL == pstMap->pstCoverage) || (NULL == pu8IsOpaque))
+    {
+        LOG_ERROR("DrawMap(): error allocating memory.");
+        FreeMemory(pu8IsOpaque);
+        return -1;
+    }
+    memset(pstMap->pstCoverage, 0, u32Count * sizeof(struct MapCoverage_t));
+
+    // A cell is opaque if any occluding layer has an opaque tile on it.
+    while (pstLayers)
+    {
+        if (_IsLayerOccluding(pstMap, pstLayers))
+        {
+            for (uint32_t u32Index = 0; u32Index < pstTmxMap->width * pstTmxMap->height; u32Index++)
+            {
+                uint32_t u32Gid = pstLayers->content.gids[u32Index] & TMX_FLIP_BITS_REMOVAL;
+
+                if ((u32Gid < pstTmxMap->tilecount) && (pstMap->pu8TileIsOpaque[u32Gid]))
+                {
+                    pu8IsOpaque[u32Index] = 1;
+                }
+            }
+        }
+        pstLayers = pstLayers->next;
+    }
+
+    // Find the longest run of completely opaque tile rows per chunk.
+    for (uint16_t u16ChunkY = 0; u16ChunkY < pstMap->u16ChunkCountY; u16ChunkY++)
+    {
+        for (uint16_t u16ChunkX = 0; u16ChunkX < pstMap->u16ChunkCountX; u16ChunkX++)
+        {
+            MapCoverage *pstCoverage = &pstMap->pstCoverage[
+                u16ChunkY * pstMap->u16ChunkCountX + u16ChunkX];
+            uint32_t     u32StartX   = u16ChunkX * MAP_CHUNK_SIZE;
+            uint32_t     u32StartY   = u16ChunkY * MAP_CHUNK_SIZE;
+            uint8_t      u8RunTop    = 0;
+
+            for (uint8_t u8Row = 0; u8Row <= MAP_CHUNK_SIZE; u8Row++)
+            {
+                uint8_t u8RowIsOpaque = (u8Row < MAP_CHUNK_SIZE) && (u32StartY + u8Row < pstTmxMap->height);
+
+                for (uint32_t u32X = u32StartX;
+                     u8RowIsOpaque && u32X < u32StartX + MAP_CHUNK_SIZE && u32X < pstTmxMap->width;
+                     u32X++)
+                {
+                    u8RowIsOpaque = pu8IsOpaque[(u32StartY + u8Row) * pstTmxMap->width + u32X];
+                }
+
+                if (u8RowIsOpaque)
+                {
+                    continue;
+                }
+
+                if (u8Row - u8RunTop > pstCoverage->u8OpaqueBottom - pstCoverage->u8OpaqueTop)
+                {
+                    pstCoverage->u8OpaqueTop    = u8RunTop;
+                    pstCoverage->u8OpaqueBottom = u8Row;
+                }
+                u8RunTop = u8Row + 1;
+            }
+        }
+    }
+
+    FreeMemory(pu8IsOpaque);
+
+    return 0;
+}
+
+/* Find the rows of a chunk which contain any tile of the layer group
+ * and the longest run of rows completely covered by opaque tiles. */
+static void _ClassifyChunk(
+    const Map  *pstMap,
+    const char *pacLayerName,
+    uint32_t    u32StartX,
+    uint32_t    u32StartY,
+    uint32_t    u32Columns,
+    uint32_t    u32Rows,
+    MapChunk   *pstChunk)
+{
+    tmx_map *pstTmxMap = pstMap->pstTmxMap;
+    uint8_t  u8RunTop  = 0;
+
+    pstChunk->u8UsedTop               = u32Rows;
+    pstChunk->u8UsedBottom            = 0;
+    pstChunk->stOpaque.u8OpaqueTop    = 0;
+    pstChunk->stOpaque.u8OpaqueBottom = 0;
+
+    for (uint8_t u8Row = 0; u8Row <= u32Rows; u8Row++)
+    {
+        uint8_t u8IsUsed   = 0;
+        uint8_t u8IsOpaque = (u8Row < u32Rows);
+
+        for (uint32_t u32X = 0; (u8Row < u32Rows) && (u32X < u32Columns); u32X++)
+        {
+            uint32_t   u32Cell        = (u32StartY + u8Row) * pstTmxMap->width + u32StartX + u32X;
+            uint8_t    u8CellIsOpaque = 0;
+            tmx_layer *pstLayers      = pstTmxMap->ly_head;
+
+            while (pstLayers)
+            {
+                if (_IsLayerInGroup(pstLayers, pacLayerName))
+                {
+                    uint32_t u32Gid = pstLayers->content.gids[u32Cell] & TMX_FLIP_BITS_REMOVAL;
+
+                    if ((u32Gid < pstTmxMap->tilecount) && (NULL != pstTmxMap->tiles[u32Gid]))
+                    {
+                        u8IsUsed        = 1;
+                        u8CellIsOpaque |= pstMap->pu8TileIsOpaque[u32Gid];
+                    }
+                }
+                pstLayers = pstLayers->next;
+            }
+
+            u8IsOpaque &= u8CellIsOpaque;
+        }
+
+        if (u8IsUsed)
+        {
+            if (u8Row < pstChunk->u8UsedTop)
+            {
+                pstChunk->u8UsedTop = u8Row;
+            }
+            pstChunk->u8UsedBottom = u8Row + 1;
+        }
+
+        if (u8IsOpaque)
+        {
+            continue;
+        }
+
+        if (u8Row - u8RunTop > pstChunk->stOpaque.u8OpaqueBottom - pstChunk->stOpaque.u8OpaqueTop)
+        {
+            pstChunk->stOpaque.u8OpaqueTop    = u8RunTop;
+            pstChunk->stOpaque.u8OpaqueBottom = u8Row;
+        }
+        u8RunTop = u8Row + 1;
+    }
+
+    // Without opaque rows, all used rows are drawn blended.
+    if (pstChunk->stOpaque.u8OpaqueTop == pstChunk->stOpaque.u8OpaqueBottom)
+    {
+        pstChunk->stOpaque.u8OpaqueTop    = pstChunk->u8UsedBottom;
+        pstChunk->stOpaque.u8OpaqueBottom = pstChunk->u8UsedBottom;
+    }
+}
+
+#ifdef MAP_USE_SSE2
+/* Blend eight channels widened to 16 bits.  x / 255 is computed as
+ * (x + 1 + (x >> 8)) >> 8, which is exact for every x that fits. */
+static __m128i _BlendChannels(__m128i stSrc, __m128i stDst, __m128i stAlpha)
+{
+    __m128i stValue;
+
+    stValue = _mm_add_epi16(
+        _mm_mullo_epi16(stSrc, stAlpha),
+        _mm_mullo_epi16(stDst, _mm_sub_epi16(_mm_set1_epi16(255), stAlpha)));
+    stValue = _mm_add_epi16(stValue, _mm_set1_epi16(127));
+    stValue = _mm_add_epi16(stValue, _mm_add_epi16(_mm_set1_epi16(1), _mm_srli_epi16(stValue, 8)));
+
+    return _mm_srli_epi16(stValue, 8);
+}
+
+/* Blend a row four pixels at a time and return how many pixels were
+ * done; the rest is left to the scalar loop.  The source alpha is
+ * blended as 255, since (255 * a + d * (255 - a) + 127) / 255 equals
+ * a + (d * (255 - a) + 127) / 255, so both paths give the same pixels. */
+static uint32_t _BlendRow(const uint32_t *pu32Src, uint32_t *pu32Dst, uint32_t u32Width)
+{
+    const __m128i stZero      = _mm_setzero_si128();
+    const __m128i stAlphaMask = _mm_slli_epi32(_mm_set1_epi32(0xFF), 24);
+    uint32_t      u32X        = 0;
+
+    for (; u32X + 4 <= u32Width; u32X += 4)
+    {
+        __m128i stSrc   = _mm_loadu_si128((const __m128i *)(pu32Src + u32X));
+        __m128i stAlpha = _mm_srli_epi32(stSrc, 24);
+        __m128i stDst;
+        __m128i stLow;
+        __m128i stHigh;
+
+        // Fully transparent pixels leave the chunk untouched.
+        if (0xFFFF == _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(stSrc, stAlphaMask), stZero)))
+        {
+            continue;
+        }
+
+        // Spread the alpha of each pixel to all four of its channels.
+        stAlpha = _mm_or_si128(stAlpha, _mm_slli_epi32(stAlpha, 8));
+        stAlpha = _mm_or_si128(stAlpha, _mm_slli_epi32(stAlpha, 16));
+        stSrc   = _mm_or_si128(stSrc, stAlphaMask);
+        stDst   = _mm_loadu_si128((const __m128i *)(pu32Dst + u32X));
+
+        stLow  = _BlendChannels(
+            _mm_unpacklo_epi8(stSrc,   stZero),
+            _mm_unpacklo_epi8(stDst,   stZero),
+            _mm_unpacklo_epi8(stAlpha, stZero));
+        stHigh = _BlendChannels(
+            _mm_unpackhi_epi8(stSrc,   stZero),
+            _mm_unpackhi_epi8(stDst,   stZero),
+            _mm_unpackhi_epi8(stAlpha, stZero));
+
+        _mm_storeu_si128((__m128i *)(pu32Dst + u32X), _mm_packus_epi16(stLow, stHigh));
+    }
+
+    return u32X;
+}
+#endif
+
+/* Composite a tile onto a chunk the same way SDL_BLENDMODE_BLEND
+ * does.  Opaque tiles are copied row by row, translucent ones are
+ * blended with SSE2 where available. */
+static void _BlendTile(
+    const SDL_Surface *pstTileset,
+    const tmx_tile    *pstTile,
+    SDL_Surface       *pstTarget,
+    uint32_t           u32PosX,
+    uint32_t           u32PosY,
+    uint8_t            u8IsOpaque)
+{
+    uint32_t u32Width  = pstTile->tileset->tile_width;
+    uint32_t u32Height = pstTile->tileset->tile_height;
+
+    // Clip to both surfaces.
+    if ((pstTile->ul_x >= (uint32_t)pstTileset->w) ||
+        (pstTile->ul_y >= (uint32_t)pstTileset->h) ||
+        (u32PosX       >= (uint32_t)pstTarget->w)  ||
+        (u32PosY       >= (uint32_t)pstTarget->h))
+    {
+        return;
+    }
+    u32Width  = SDL_min(u32Width,  (uint32_t)pstTileset->w - pstTile->ul_x);
+    u32Width  = SDL_min(u32Width,  (uint32_t)pstTarget->w  - u32PosX);
+    u32Height = SDL_min(u32Height, (uint32_t)pstTileset->h - pstTile->ul_y);
+    u32Height = SDL_min(u32Height, (uint32_t)pstTarget->h  - u32PosY);
+
+    for (uint32_t u32Y = 0; u32Y < u32Height; u32Y++)
+    {
+        const uint32_t *pu32Src = (const uint32_t *)(
+            (const uint8_t *)pstTileset->pixels +
+            (pstTile->ul_y + u32Y) * pstTileset->pitch) + pstTile->ul_x;
+        uint32_t       *pu32Dst = (uint32_t *)(
+            (uint8_t *)pstTarget->pixels +
+            (u32PosY + u32Y) * pstTarget->pitch) + u32PosX;
+        uint32_t        u32X    = 0;
+
+        if (u8IsOpaque)
+        {
+            memcpy(pu32Dst, pu32Src, u32Width * sizeof(uint32_t));
+            continue;
+        }
+
+        #ifdef MAP_USE_SSE2
+        u32X = _BlendRow(pu32Src, pu32Dst, u32Width);
+        #endif
+
+        for (; u32X < u32Width; u32X++)
+        {
+            uint32_t u32Src   = pu32Src[u32X];
+            uint32_t u32Dst   = pu32Dst[u32X];
+            uint32_t u32Alpha = u32Src >> 24;
+            uint32_t u32Inv   = 255 - u32Alpha;
+            uint32_t u32Pixel;
+
+            if (0 == u32Alpha)
+            {
+                continue;
+            }
+
+            if (0xFF == u32Alpha)
+            {
+                pu32Dst[u32X] = u32Src;
+                continue;
+            }
+
+            u32Pixel = (u32Alpha + ((u32Dst >> 24) * u32Inv + 127) / 255) << 24;
+            for (uint8_t u8Shift = 0; u8Shift < 24; u8Shift += 8)
+            {
+                uint32_t u32S = (u32Src >> u8Shift) & 0xFF;
+                uint32_t u32D = (u32Dst >> u8Shift) & 0xFF;
+
+                u32Pixel |= ((u32S * u32Alpha + u32D * u32Inv + 127) / 255) << u8Shift;
+            }
+            pu32Dst[u32X] = u32Pixel;
+        }
+    }
+}
+
+/* Bake a range of the chunk list into surfaces.  Runs on any thread,
+ * so the renderer must not be touched here. */
+static void _BakeChunks(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    MapBake *pstBake   = (MapBake *)pData;
+    Map     *pstMap    = pstBake->pstMap;
+    tmx_map *pstTmxMap = pstMap->pstTmxMap;
+
+    for (uint32_t u32Item = u32Begin; u32Item < u32End; u32Item++)
+    {
+        uint32_t    u32Chunk     = pstBake->pu32Items[u32Item] / MAP_MAX_LAYERS;
+        uint8_t     u8Index      = pstBake->pu32Items[u32Item] % MAP_MAX_LAYERS;
+        const char *pacLayerName = pstMap->aacLayerNames[u8Index];
+        MapChunk   *pstChunk     = &pstMap->pstChunks[u8Index][u32Chunk];
+        uint32_t    u32StartX    = (u32Chunk % pstMap->u16ChunkCountX) * MAP_CHUNK_SIZE;
+        uint32_t    u32StartY    = (u32Chunk / pstMap->u16ChunkCountX) * MAP_CHUNK_SIZE;
+        uint32_t    u32Columns   = SDL_min(MAP_CHUNK_SIZE, pstTmxMap->width  - u32StartX);
+        uint32_t    u32Rows      = SDL_min(MAP_CHUNK_SIZE, pstTmxMap->height - u32StartY);
+        tmx_layer  *pstLayers    = pstTmxMap->ly_head;
+
+        _ClassifyChunk(pstMap, pacLayerName, u32StartX, u32StartY, u32Columns, u32Rows, pstChunk);
+
+        // Empty chunks are skipped entirely and need no texture.
+        if (pstChunk->u8UsedTop >= pstChunk->u8UsedBottom)
+        {
+            continue;
+        }
+
+        // Left over from an attempt which failed.
+        SDL_FreeSurface(pstChunk->pstSurface);
+        pstChunk->pstSurface = SDL_CreateRGBSurfaceWithFormat(
+            0,
+            u32Columns * pstTmxMap->tile_width,
+            u32Rows    * pstTmxMap->tile_height,
+            32,
+            SDL_PIXELFORMAT_ARGB8888);
+
+        if (NULL == pstChunk->pstSurface)
+        {
+            LOG_ERROR("%s", SDL_GetError());
+            SDL_AtomicSet(&pstBake->stError, 1);
+            return;
+        }
+        memset(pstChunk->pstSurface->pixels, 0, pstChunk->pstSurface->h * pstChunk->pstSurface->pitch);
+
+        while(pstLayers)
+        {
+            if (_IsLayerInGroup(pstLayers, pacLayerName))
+            {
+                for (uint32_t u32IndexH = 0; u32IndexH < u32Rows; u32IndexH++)
+                {
+                    for (uint32_t u32IndexW = 0; u32IndexW < u32Columns; u32IndexW++)
+                    {
+                        uint32_t  u32Gid;
+                        tmx_tile *pstTile;
+
+                        u32Gid = pstLayers->content.gids[
+                            ((u32StartY + u32IndexH) * pstTmxMap->width) + u32StartX + u32IndexW]
+                            & TMX_FLIP_BITS_REMOVAL;
+                        if ((u32Gid >= pstTmxMap->tilecount) || (NULL == pstTmxMap->tiles[u32Gid]))
+                        {
+                            continue;
+                        }
+
+                        pstTile = pstTmxMap->tiles[u32Gid];
+                        _BlendTile(
+                            pstMap->pstTileset,
+                            pstTile,
+                            pstChunk->pstSurface,
+                            u32IndexW * pstTile->tileset->tile_width,
+                            u32IndexH * pstTile->tileset->tile_height,
+                            pstMap->pu8TileIsOpaque[u32Gid]);
+                    }
+                }
+            }
+            pstLayers = pstLayers->next;
+        }
+    }
+}
+
+static int8_t _UploadChunk(SDL_Renderer *pstRenderer, MapChunk *pstChunk)
+{
+    SDL_Surface *pstSurface = pstChunk->pstSurface;
+
+    pstChunk->pstTexture = CreateTrackedTexture(
+        MEMORY_TAG_MAP,
+        pstRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC,
+        pstSurface->w,
+        pstSurface->h);
+
+    if ((NULL == pstChunk->pstTexture) ||
+        (0 != SDL_UpdateTexture(pstChunk->pstTexture, NULL, pstSurface->pixels, pstSurface->pitch)))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        if (NULL != pstChunk->pstTexture)
+        {
+            DestroyTrackedTexture(pstChunk->pstTexture);
+            pstChunk->pstTexture = NULL;
+        }
+        SDL_FreeSurface(pstSurface);
+        pstChunk->pstSurface = NULL;
+        return -1;
+    }
+
+    SDL_FreeSurface(pstSurface);
+    pstChunk->pstSurface = NULL;
+
+    return 0;
+}
+
+/* Bake a list of chunks on the CPU, in parallel if there is a
+ * JobSystem, and upload them on the calling thread afterwards. */
+static int8_t _BakeList(
+    SDL_Renderer   *pstRenderer,
+    Map            *pstMap,
+    const uint32_t *pu32Items,
+    uint32_t        u32Count)
+{
+    MapBake    stBake;
+    JobCounter stCounter = { { 0 } };
+    int8_t     s8Status  = 0;
+
+    stBake.pstMap    = pstMap;
+    stBake.pu32Items = pu32Items;
+    SDL_AtomicSet(&stBake.stError, 0);
+
+    if (NULL == pstMap->pstJobs)
+    {
+        _BakeChunks(&stBake, 0, u32Count);
+    }
+    else
+    {
+        RunParallelFor(pstMap->pstJobs, "BakeMapChunk", _BakeChunks, &stBake, u32Count, 1, &stCounter);
+        WaitForJobCounter(pstMap->pstJobs, &stCounter);
+    }
+
+    if (SDL_AtomicGet(&stBake.stError))
+    {
+        s8Status = -1;
+    }
+
+    for (uint32_t u32Item = 0; u32Item < u32Count; u32Item++)
+    {
+        MapChunk *pstChunk = &pstMap->pstChunks[pu32Items[u32Item] % MAP_MAX_LAYERS][
+            pu32Items[u32Item] / MAP_MAX_LAYERS];
+
+        if ((0 == s8Status) &&
+            (NULL != pstChunk->pstSurface) &&
+            (-1 == _UploadChunk(pstRenderer, pstChunk)))
+        {
+            s8Status = -1;
+        }
+
+        // After a failure, the rest of the list is baked again next time.
+        if (-1 == s8Status)
+        {
+            SDL_FreeSurface(pstChunk->pstSurface);
+            pstChunk->pstSurface = NULL;
+            continue;
+        }
+        pstChunk->u8IsBaked = 1;
+    }
+
+    return s8Status;
+}
+
+/* The tileset is decoded in the background while the game starts up.
+ * Classifying its tiles has to wait until it is there. */
+static int8_t _LoadTileset(Map *pstMap)
+{
+    SDL_Surface *pstTileset;
+
+    if (-1 == WaitForAsset(pstMap->pstAssets, pstMap->s16Tileset))
+    {
+        return -1;
+    }
+    pstTileset = GetAssetSurface(pstMap->pstAssets, pstMap->s16Tileset);
+
+    if (-1 == _ClassifyTiles(pstMap, pstTileset))
+    {
+        return -1;
+    }
+
+    // Kept for baking the chunks on the CPU.
+    pstMap->pstTileset = pstTileset;
+
+    return 0;
+}
+
+/* Set up a layer group on first use.  Its chunks are baked on demand. */
+static int8_t _InitLayer(
+    Map          *pstMap,
+    const char   *pacLayerName,
+    const uint8_t u8Index)
+{
+    if (strlen(pacLayerName) >= MAP_MAX_NAME_LENGTH)
+    {
+        LOG_ERROR("DrawMap(): layer name '%s' is too long.", pacLayerName);
+        return -1;
+    }
+
+    pstMap->pstChunks[u8Index] = AllocZeroedMemory(
+        MEMORY_TAG_MAP,
+        pstMap->u16ChunkCountX * pstMap->u16ChunkCountY,
+        sizeof(struct MapChunk_t));
+    if (NULL == pstMap->pstChunks[u8Index])
+    {
+        LOG_ERROR("DrawMap(): error allocating memory.");
+        return -1;
+    }
+    memcpy(pstMap->aacLayerNames[u8Index], pacLayerName, strlen(pacLayerName) + 1);
+
+    return 0;
+}
+
+/* Downsample the previous level of a chunk into a texture of half its
+ * size.  Linear filtering at exactly half the size averages each 2x2
+ * block of texels. */
+static int8_t _BuildMipmap(
+    SDL_Renderer *pstRenderer,
+    MapChunk     *pstChunk,
+    uint8_t       u8Level)
+{
+    SDL_Texture *pstSource = pstChunk->pstTexture;
+    SDL_Texture *pstTarget = SDL_GetRenderTarget(pstRenderer);
+    SDL_Texture *pstMipmap;
+    int32_t      s32Width;
+    int32_t      s32Height;
+    uint8_t      u8Red;
+    uint8_t      u8Green;
+    uint8_t      u8Blue;
+    uint8_t      u8Alpha;
+    int8_t       s8Status = 0;
+
+    if (u8Level > 1)
+    {
+        pstSource = pstChunk->pstMipmaps[u8Level - 2];
+    }
+
+    SDL_QueryTexture(pstSource, NULL, NULL, &s32Width, &s32Height);
+
+    pstMipmap = CreateTrackedTexture(
+        MEMORY_TAG_MAP,
+        pstRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        SDL_max(1, s32Width  / 2),
+        SDL_max(1, s32Height / 2));
+
+    if (NULL == pstMipmap)
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    if (0 != SDL_SetRenderTarget(pstRenderer, pstMipmap))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        s8Status = -1;
+    }
+    else
+    {
+        SDL_GetRenderDrawColor(pstRenderer, &u8Red, &u8Green, &u8Blue, &u8Alpha);
+        SDL_SetRenderDrawColor(pstRenderer, 0, 0, 0, 0);
+        SDL_RenderClear(pstRenderer);
+        SDL_SetRenderDrawColor(pstRenderer, u8Red, u8Green, u8Blue, u8Alpha);
+
+        SDL_SetTextureBlendMode(pstSource, SDL_BLENDMODE_NONE);
+        SDL_SetTextureScaleMode(pstSource, SDL_ScaleModeLinear);
+        SDL_RenderCopy(pstRenderer, pstSource, NULL, NULL);
+        SDL_SetTextureScaleMode(pstSource, SDL_ScaleModeNearest);
+    }
+
+    // The caller's target is restored whether or not the level was
+    // drawn, so a failure never leaves the frame rendering into it.
+    if (0 != SDL_SetRenderTarget(pstRenderer, pstTarget))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        s8Status = -1;
+    }
+
+    if (-1 == s8Status)
+    {
+        // Destroying a bound texture resets the target, so try once more
+        // to get the caller's one back.
+        DestroyTrackedTexture(pstMipmap);
+        SDL_SetRenderTarget(pstRenderer, pstTarget);
+        return -1;
+    }
+
+    // Only a completed level is stored; an empty slot is rebuilt.
+    pstChunk->pstMipmaps[u8Level - 1] = pstMipmap;
+
+    return 0;
+}
+
+/* Pick the coarsest level which still provides at least one texel per
+ * output pixel. */
+static uint8_t _SelectMipmapLevel(const Map *pstMap, const Camera *pstCamera)
+{
+    uint8_t u8Level = 0;
+    double  dScale  = pstCamera->dPixelScale;
+
+    while ((u8Level < pstMap->u8MipmapCount) && (dScale <= 0.5))
+    {
+        dScale *= 2;
+        u8Level++;
+    }
+
+    return u8Level;
+}
+
+static int8_t _DrawChunkRows(
+    RenderQueue   *pstQueue,
+    uint16_t       u16Layer,
+    Map           *pstMap,
+    MapChunk      *pstChunk,
+    SDL_Rect       stDst,
+    double         dScale,
+    uint8_t        u8Level,
+    uint8_t        u8Top,
+    uint8_t        u8Bottom,
+    SDL_BlendMode  eBlendMode)
+{
+    SDL_Texture *pstTexture = pstChunk->pstTexture;
+    SDL_Rect     stSrc;
+    SDL_FRect    stScaled;
+    SDL_FRect    stUV;
+    uint32_t     u32Pixels;
+
+    if (u8Top >= u8Bottom)
+    {
+        return 0;
+    }
+
+    stSrc.x  = 0;
+    stSrc.y  = u8Top * pstMap->pstTmxMap->tile_height;
+    stSrc.w  = stDst.w;
+    stSrc.h  = (u8Bottom - u8Top) * pstMap->pstTmxMap->tile_height;
+    stUV.x   = 0;
+    stUV.y   = (float)stSrc.y / stDst.h;
+    stUV.w   = 1;
+    stUV.h   = (float)stSrc.h / stDst.h;
+    stDst.y += stSrc.y;
+    stDst.h  = stSrc.h;
+
+    // Mipmap levels cover the same area with fewer texels.
+    if (u8Level > 0)
+    {
+        pstTexture = pstChunk->pstMipmaps[u8Level - 1];
+        stSrc.y  >>= u8Level;
+        stSrc.w  >>= u8Level;
+        stSrc.h  >>= u8Level;
+    }
+
+    /* Both edges are scaled on their own so that neighbouring chunks
+     * still share them exactly at fractional zoom levels. */
+    stScaled.x = stDst.x * dScale;
+    stScaled.y = stDst.y * dScale;
+    stScaled.w = (stDst.x + stDst.w) * dScale - stScaled.x;
+    stScaled.h = (stDst.y + stDst.h) * dScale - stScaled.y;
+
+    if (-1 == PushRenderQuad(
+            pstQueue,
+            u16Layer,
+            pstTexture,
+            eBlendMode,
+            &stScaled,
+            &stUV,
+            SDL_FLIP_NONE))
+    {
+        return -1;
+    }
+
+    u32Pixels = stSrc.w * stSrc.h;
+    if (SDL_BLENDMODE_NONE == eBlendMode)
+    {
+        pstMap->stStats.u32OpaquePixels  += u32Pixels;
+    }
+    else
+    {
+        pstMap->stStats.u32BlendedPixels += u32Pixels;
+    }
+
+    return 0;
+}
+
+static const char *_FindText(const char *pacBegin, const char *pacEnd, const char *pacText)
+{
+    size_t zLength = strlen(pacText);
+
+    for (; pacBegin + zLength <= pacEnd; pacBegin++)
+    {
+        if (0 == memcmp(pacBegin, pacText, zLength))
+        {
+            return pacBegin;
+        }
+    }
+
+    return NULL;
+}
+
+static void *_AllocTmx(void *pAddress, size_t zLength)
+{
+    return ReallocMemory(MEMORY_TAG_TMX, pAddress, zLength);
+}
+
+static void _LogTmxError(int32_t s32Code, const char *pacMessage)
+{
+    (void)s32Code;
+    LOG_ERROR("tmx: %s", pacMessage);
+}
+
+static int8_t _LoadExternalTileset(
+    Map        *pstMap,
+    Pack       *pstPack,
+    const char *pacFilename,
+    const char *pacSource)
+{
+    char        acPath[PACK_MAX_PATH_LENGTH];
+    const char *pacSlash   = strrchr(pacFilename, '/');
+    size_t      zDirLength = (NULL == pacSlash) ? 0 : (size_t)(pacSlash - pacFilename + 1);
+    const char *pacData;
+    size_t      zSize;
+    int32_t     s32IsLoaded;
+
+    if (zDirLength + strlen(pacSource) >= PACK_MAX_PATH_LENGTH)
+    {
+        LOG_ERROR("InitMap(): tileset path too long: %s", pacSource);
+        return -1;
+    }
+
+    // The source is relative to the map.
+    memcpy(acPath, pacFilename, zDirLength);
+    memcpy(&acPath[zDirLength], pacSource, strlen(pacSource) + 1);
+
+    pacData = LoadPackFile(pstPack, acPath, &zSize);
+    if (NULL == pacData)
+    {
+        return -1;
+    }
+
+    s32IsLoaded = tmx_load_tileset_buffer(pstMap->pstTilesets, pacData, zSize, pacSource);
+    FreePackFile(pstPack, pacData);
+    // tmx reports the reason through _LogTmxError().
+    if (! s32IsLoaded)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static tmx_map *_LoadTmxMap(Map *pstMap, Pack *pstPack, const char *pacFilename)
+{
+    const char *pacData;
+    const char *pacEnd;
+    const char *pacTag;
+    size_t      zSize;
+    tmx_map    *pstTmxMap;
+
+    pacData = LoadPackFile(pstPack, pacFilename, &zSize);
+    if (NULL == pacData)
+    {
+        return NULL;
+    }
+    pacEnd = pacData + zSize;
+
+    /* The tileset manager is used before tmx sets up its allocator.
+     * libxml2 is set up to allocate through it as well. */
+    if (NULL == tmx_alloc_func)
+    {
+        tmx_alloc_func = _AllocTmx;
+        tmx_free_func  = FreeMemory;
+    }
+    tmx_err_func = _LogTmxError;
+
+    pstMap->pstTilesets = tmx_make_tileset_manager();
+    if (NULL == pstMap->pstTilesets)
+    {
+        LOG_ERROR("InitMap(): error allocating memory.");
+        FreePackFile(pstPack, pacData);
+        return NULL;
+    }
+
+    /* A map read from memory doesn't know where it came from, so its
+     * external tilesets are loaded beforehand and looked up by their
+     * source attribute. */
+    pacTag = pacData;
+    while (NULL != (pacTag = _FindText(pacTag, pacEnd, "<tileset ")))
+    {
+        const char *pacTagEnd = memchr(pacTag, '>', pacEnd - pacTag);
+        const char *pacSource;
+        const char *pacQuote;
+        char        acSource[PACK_MAX_PATH_LENGTH];
+
+        if (NULL == pacTagEnd)
+        {
+            break;
+        }
+
+        pacSource = _FindText(pacTag, pacTagEnd, "source=\"");
+        pacTag    = pacTagEnd;
+        if (NULL == pacSource)
+        {
+            continue;
+        }
+        pacSource += strlen("source=\"");
+
+        pacQuote = memchr(pacSource, '"', pacTagEnd - pacSource);
+        if ((NULL == pacQuote) || (pacQuote - pacSource >= PACK_MAX_PATH_LENGTH))
+        {
+            continue;
+        }
+        memcpy(acSource, pacSource, pacQuote - pacSource);
+        acSource[pacQuote - pacSource] = '\0';
+
+        if (-1 == _LoadExternalTileset(pstMap, pstPack, pacFilename, acSource))
+        {
+            FreePackFile(pstPack, pacData);
+            return NULL;
+        }
+    }
+
+    pstTmxMap = tmx_tsmgr_load_buffer(pstMap->pstTilesets, pacData, zSize);
+    FreePackFile(pstPack, pacData);
+
+    return pstTmxMap;
+}
 
 /**
- * @brief   Draw Map.
+ * @brief   Draw Map.  Each layer is baked into chunks of
+ *          MAP_CHUNK_SIZE x MAP_CHUNK_SIZE tiles, each chunk once it is
+ *          visible unless PrefetchMap() did so before.  Empty chunks are
+ *          skipped, rows of a chunk which are completely covered by
+ *          opaque tiles are drawn without blending and only the
+ *          remaining rows are alpha blended.  Chunks are baked on the
+ *          CPU, in parallel if the Map has a JobSystem, and uploaded
+ *          from the calling thread.  The chunks are pushed to the
+ *          RenderQueue; only building mipmaps draws right away.
  * @param   pstRenderer      a SDL rendering context.  See @ref struct Video.
+ * @param   pstQueue         the RenderQueue.  See @ref struct RenderQueue.
  * @param   pstMap           the Map.  See @ref struct Map.
  * @param   pacLayerName     substring of the layer(s) to render.
  * @param   u8RenderBgColour a boolean value to set whether the background
@@ -24,133 +978,147 @@
  * @param   u8Index          the layer index.  The total amount of layers per map
  *                           is defined by MAP_MAX_LAYERS.  Not to confused with
                              the layers used by Tiled which can be grouped by name.
- * @param   dCameraPosX      camera position along the x-axis.
- * @param   dCameraPosY      camera position along the y-axis.
+ * @param   u16Layer         the render layer.  See @ref enum RenderLayer.
+ * @param   pstCamera        the Camera.  Only chunks which overlap its
+ *                           visible tile range are drawn.  See @ref struct Camera.
  * @return  0 on success, -1 on failure.
  * @ingroup Map
  */
 int8_t DrawMap(
     SDL_Renderer  *pstRenderer,
+    RenderQueue   *pstQueue,
     Map           *pstMap,
     const char    *pacLayerName,
     const uint8_t  u8RenderBgColour,
     const uint8_t  u8Index,
-    const double   dCameraPosX,
-    const double   dCameraPosY)
+    const uint16_t u16Layer,
+    const Camera  *pstCamera)
 {
-    SDL_Texture *pstTileset = NULL;
-    tmx_layer   *pstLayers  = pstMap->pstTmxMap->ly_head;
+    int32_t  s32ChunkWidth  = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_width;
+    int32_t  s32ChunkHeight = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_height;
+    int32_t  s32RenderPosX  = pstMap->dWorldPosX - pstCamera->dPosX;
+    int32_t  s32RenderPosY  = pstMap->dWorldPosY - pstCamera->dPosY;
+    uint16_t u16FirstChunkX = pstCamera->stTiles.u32FirstColumn / MAP_CHUNK_SIZE;
+    uint16_t u16LastChunkX  = pstCamera->stTiles.u32LastColumn  / MAP_CHUNK_SIZE;
+    uint16_t u16FirstChunkY = pstCamera->stTiles.u32FirstRow    / MAP_CHUNK_SIZE;
+    uint16_t u16LastChunkY  = pstCamera->stTiles.u32LastRow     / MAP_CHUNK_SIZE;
+    uint8_t  u8Level        = _SelectMipmapLevel(pstMap, pstCamera);
+    uint32_t u32Missing     = 0;
 
-    // Draw layer in case it has already been rendered.
-    if (pstMap->pstLayer[u8Index])
+    if ((NULL == pstMap->pstTileset) && (-1 == _LoadTileset(pstMap)))
     {
-        double dRenderPosX = pstMap->dWorldPosX - dCameraPosX;
-        double dRenderPosY = pstMap->dWorldPosY - dCameraPosY;
+        return -1;
+    }
 
-        SDL_Rect stDst =
+    if (NULL == pstMap->pstChunks[u8Index])
+    {
+        if ((-1 == _InitLayer(pstMap, pacLayerName, u8Index)) || (-1 == _BuildCoverage(pstMap)))
         {
-            dRenderPosX,
-            dRenderPosY,
-            pstMap->pstTmxMap->width  * pstMap->pstTmxMap->tile_width,
-            pstMap->pstTmxMap->height * pstMap->pstTmxMap->tile_height
-        };
-        if (-1 == SDL_RenderCopyEx(
-                pstRenderer,
-                pstMap->pstLayer[u8Index],
-                NULL,
-                &stDst,
-                0,
-                NULL,
-                SDL_FLIP_NONE))
-        {
-            fprintf(stderr, "%s\n", SDL_GetError());
             return -1;
         }
-        return 0;
-    }
-    // Else: render layer once.
-    pstMap->pstLayer[u8Index] = SDL_CreateTexture(
-        pstRenderer,
-        SDL_PIXELFORMAT_ARGB8888,
-        SDL_TEXTUREACCESS_TARGET,
-        pstMap->pstTmxMap->width  * pstMap->pstTmxMap->tile_width,
-        pstMap->pstTmxMap->height * pstMap->pstTmxMap->tile_height);
 
-    if (NULL == pstMap->pstLayer[u8Index])
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+        if (u8RenderBgColour)
+        {
+            SDL_SetRenderDrawColor(
+                pstRenderer,
+                (pstMap->pstTmxMap->backgroundcolor >> 16) & 0xFF,
+                (pstMap->pstTmxMap->backgroundcolor >>  8) & 0xFF,
+                (pstMap->pstTmxMap->backgroundcolor)       & 0xFF,
+                255);
+        }
     }
 
-    pstTileset = IMG_LoadTexture(
-        pstRenderer,
-        pstMap->pacTilesetImageFilename);
-    if (NULL == pstTileset)
+    // Visible chunks which have not been prefetched are baked right away.
+    for (uint16_t u16ChunkY = u16FirstChunkY; u16ChunkY <= u16LastChunkY; u16ChunkY++)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
-    }
+        for (uint16_t u16ChunkX = u16FirstChunkX; u16ChunkX <= u16LastChunkX; u16ChunkX++)
+        {
+            uint32_t u32Chunk = u16ChunkY * pstMap->u16ChunkCountX + u16ChunkX;
 
-    if (0 != SDL_SetRenderTarget(pstRenderer, pstMap->pstLayer[u8Index]))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+            if (pstMap->pstChunks[u8Index][u32Chunk].u8IsBaked)
+            {
+                pstMap->stCache.u32Hits++;
+                continue;
+            }
+            pstMap->pu32BakeList[u32Missing++] = u32Chunk * MAP_MAX_LAYERS + u8Index;
+        }
     }
 
-    if (u8RenderBgColour)
+    if (u32Missing > 0)
     {
-        SDL_SetRenderDrawColor(
-            pstRenderer,
-            (pstMap->pstTmxMap->backgroundcolor >> 16) & 0xFF,
-            (pstMap->pstTmxMap->backgroundcolor >>  8) & 0xFF,
-            (pstMap->pstTmxMap->backgroundcolor)       & 0xFF,
-            255);
+        uint64_t u64Start = SDL_GetPerformanceCounter();
+        double   dHitch;
+
+        if (-1 == _BakeList(pstRenderer, pstMap, pstMap->pu32BakeList, u32Missing))
+        {
+            return -1;
+        }
+
+        dHitch = (double)(SDL_GetPerformanceCounter() - u64Start) * 1000 / SDL_GetPerformanceFrequency();
+        pstMap->stCache.u32Misses += u32Missing;
+        if (dHitch > pstMap->stCache.dWorstHitch)
+        {
+            pstMap->stCache.dWorstHitch = dHitch;
+        }
     }
 
-    while(pstLayers)
+    // Only the chunks touched by the visible tile range are considered.
+    for (uint16_t u16ChunkY = u16FirstChunkY; u16ChunkY <= u16LastChunkY; u16ChunkY++)
     {
-        uint32_t     u32Gid;
-        SDL_Rect     stDst;
-        SDL_Rect     stSrc;
-        tmx_tileset *pstTS;
-
-        if ((pstLayers->visible) && (NULL != strstr(pstLayers->name, pacLayerName)))
+        for (uint16_t u16ChunkX = u16FirstChunkX; u16ChunkX <= u16LastChunkX; u16ChunkX++)
         {
-            for (uint32_t u32IndexH = 0; u32IndexH < pstMap->pstTmxMap->height; u32IndexH++)
+            MapChunk *pstChunk = &pstMap->pstChunks[u8Index][
+                u16ChunkY * pstMap->u16ChunkCountX + u16ChunkX];
+            uint32_t  u32Rows;
+            SDL_Rect  stDst;
+
+            if (NULL == pstChunk->pstTexture)
+            {
+                pstMap->stStats.u32SkippedChunks++;
+                continue;
+            }
+
+            stDst.x = s32RenderPosX + u16ChunkX * s32ChunkWidth;
+            stDst.y = s32RenderPosY + u16ChunkY * s32ChunkHeight;
+            SDL_QueryTexture(pstChunk->pstTexture, NULL, NULL, &stDst.w, &stDst.h);
+
+            // Levels are built from the full resolution bake on first use.
+            for (uint8_t u8Mipmap = 1; u8Mipmap <= u8Level; u8Mipmap++)
             {
-                for (uint32_t u32IndexW = 0; u32IndexW < pstMap->pstTmxMap->width; u32IndexW++)
+                if ((NULL == pstChunk->pstMipmaps[u8Mipmap - 1]) &&
+                    (-1 == _BuildMipmap(pstRenderer, pstChunk, u8Mipmap)))
                 {
-                    u32Gid = pstLayers->content.gids[
-                        (u32IndexH * pstMap->pstTmxMap->width) + u32IndexW]
-                        & TMX_FLIP_BITS_REMOVAL;
-                    if (NULL != pstMap->pstTmxMap->tiles[u32Gid])
-                    {
-                        pstTS    = pstMap->pstTmxMap->tiles[u32Gid]->tileset;
-                        stSrc.x  = pstMap->pstTmxMap->tiles[u32Gid]->ul_x;
-                        stSrc.y  = pstMap->pstTmxMap->tiles[u32Gid]->ul_y;
-                        stSrc.w  = stDst.w   = pstTS->tile_width;
-                        stSrc.h  = stDst.h   = pstTS->tile_height;
-                        stDst.x  = u32IndexW * pstTS->tile_width;
-                        stDst.y  = u32IndexH * pstTS->tile_height;
-                        SDL_RenderCopy(pstRenderer, pstTileset, &stSrc, &stDst);
-                    }
+                    return -1;
                 }
             }
-        }
-        pstLayers = pstLayers->next;
-    }
 
-    // Switch back to default render target.
-    if (0 != SDL_SetRenderTarget(pstRenderer, NULL))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
-    }
+            if (u8Level > 0)
+            {
+                pstMap->stStats.u32MipmappedChunks++;
+            }
 
-    if (0 != SDL_SetTextureBlendMode(pstMap->pstLayer[u8Index], SDL_BLENDMODE_BLEND))
-    {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        return -1;
+            if ((-1 == _DrawChunkRows(
+                    pstQueue, u16Layer, pstMap, pstChunk, stDst, pstCamera->dScale, u8Level,
+                    pstChunk->u8UsedTop, pstChunk->stOpaque.u8OpaqueTop,
+                    SDL_BLENDMODE_BLEND)) ||
+                (-1 == _DrawChunkRows(
+                    pstQueue, u16Layer, pstMap, pstChunk, stDst, pstCamera->dScale, u8Level,
+                    pstChunk->stOpaque.u8OpaqueTop, pstChunk->stOpaque.u8OpaqueBottom,
+                    SDL_BLENDMODE_NONE)) ||
+                (-1 == _DrawChunkRows(
+                    pstQueue, u16Layer, pstMap, pstChunk, stDst, pstCamera->dScale, u8Level,
+                    pstChunk->stOpaque.u8OpaqueBottom, pstChunk->u8UsedBottom,
+                    SDL_BLENDMODE_BLEND)))
+            {
+                return -1;
+            }
+
+            // Rows without any tile are not drawn at all.
+            u32Rows = stDst.h / pstMap->pstTmxMap->tile_height;
+            pstMap->stStats.u32SkippedPixels +=
+                stDst.w * pstMap->pstTmxMap->tile_height *
+                (u32Rows - (pstChunk->u8UsedBottom - pstChunk->u8UsedTop));
+        }
     }
 
     return 0;
@@ -163,44 +1131,135 @@ int8_t DrawMap(
  */
 void FreeMap(Map *pstMap)
 {
+    for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+    {
+        if (NULL == pstMap->pstChunks[u8Index])
+        {
+            continue;
+        }
+
+        for (uint32_t u32Chunk = 0; u32Chunk < (uint32_t)pstMap->u16ChunkCountX * pstMap->u16ChunkCountY; u32Chunk++)
+        {
+            MapChunk *pstChunk = &pstMap->pstChunks[u8Index][u32Chunk];
+
+            if (NULL != pstChunk->pstTexture)
+            {
+                DestroyTrackedTexture(pstChunk->pstTexture);
+            }
+
+            if (NULL != pstChunk->pstSurface)
+            {
+                SDL_FreeSurface(pstChunk->pstSurface);
+            }
+
+            for (uint8_t u8Mipmap = 0; u8Mipmap < MAP_MAX_MIPMAPS; u8Mipmap++)
+            {
+                if (NULL != pstChunk->pstMipmaps[u8Mipmap])
+                {
+                    DestroyTrackedTexture(pstChunk->pstMipmaps[u8Mipmap]);
+                }
+            }
+        }
+        FreeMemory(pstMap->pstChunks[u8Index]);
+    }
+
+    // External tilesets belong to the tileset manager.
     tmx_map_free(pstMap->pstTmxMap);
-    free(pstMap->pacTilesetImageFilename);
-    free(pstMap);
+    tmx_free_tileset_manager(pstMap->pstTilesets);
+    FreeMemory(pstMap->pacTilesetImageFilename);
+    FreeMemory(pstMap->pu8TileIsOpaque);
+    FreeMemory(pstMap->pstCoverage);
+    FreeMemory(pstMap->pu32BakeList);
+    FreeMemory(pstMap);
+}
+
+/**
+ * @brief   Get the chunk cache statistics since the Map has been loaded.
+ * @param   pstMap a Map.  See @ref struct Map.
+ * @return  the statistics.  See @ref struct MapCacheStats.
+ * @ingroup Map
+ */
+MapCacheStats GetMapCacheStats(const Map *pstMap)
+{
+    return pstMap->stCache;
+}
+
+/**
+ * @brief   Get the draw statistics of the last frame.
+ * @param   pstMap a Map.  See @ref struct Map.
+ * @return  the statistics.  See @ref struct MapStats.
+ * @ingroup Map
+ */
+MapStats GetMapStats(const Map *pstMap)
+{
+    return pstMap->stStats;
 }
 
 /**
- * @brief   Initialise Map.
+ * @brief   Check whether a layer name passed to DrawMap() matches any
+ *          layer of the map.
+ * @param   pstMap       a Map.  See @ref struct Map.
+ * @param   pacLayerName substring of the layer(s) to render.
+ * @return  1 if at least one layer matches, 0 otherwise.
+ * @ingroup Map
+ */
+uint8_t HasMapLayer(const Map *pstMap, const char *pacLayerName)
+{
+    tmx_layer *pstLayer = pstMap->pstTmxMap->ly_head;
+
+    while (pstLayer)
+    {
+        if (_IsLayerInGroup(pstLayer, pacLayerName))
+        {
+            return 1;
+        }
+        pstLayer = pstLayer->next;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Initialise Map.  The map is read through the Pack of the
+ *          AssetManager.  The tileset image is loaded in the background
+ *          and needed by the first call of DrawMap().
  * @param   pacFilename             the filename of the TMX map.
  * @param   pacTilesetImageFilename the filename of the tileset image.
+ * @param   pstAssets               the AssetManager.  See @ref struct AssetManager.
  * @return  a Map on success, NULL on failure.
  * @ingroup Map
  */
 Map *InitMap(
-    const char *pacFilename,
-    const char *pacTilesetImageFilename)
+    const char   *pacFilename,
+    const char   *pacTilesetImageFilename,
+    AssetManager *pstAssets)
 {
     static Map *pstMap;
-    pstMap = malloc(sizeof(struct Map_t));
+    pstMap = AllocMemory(MEMORY_TAG_MAP, sizeof(struct Map_t));
     if (NULL == pstMap)
     {
-        fprintf(stderr, "InitMap(): error allocating memory.\n");
+        LOG_ERROR("InitMap(): error allocating memory.");
         return NULL;
     }
 
-    pstMap->pstTmxMap = tmx_load(pacFilename);
+    pstMap->pstTilesets = NULL;
+    pstMap->pstTmxMap   = _LoadTmxMap(pstMap, pstAssets->pstPack, pacFilename);
     if (NULL == pstMap->pstTmxMap)
     {
-        free(pstMap);
-        fprintf(stderr, "%s\n", tmx_strerr());
+        if (NULL != pstMap->pstTilesets)
+        {
+            tmx_free_tileset_manager(pstMap->pstTilesets);
+        }
+        FreeMemory(pstMap);
         return NULL;
     }
 
     pstMap->pacTilesetImageFilename =
-        malloc(strlen(pacTilesetImageFilename) + 1);
+        AllocMemory(MEMORY_TAG_MAP, strlen(pacTilesetImageFilename) + 1);
     if (NULL == pstMap->pacTilesetImageFilename)
     {
-        free(pstMap);
-        fprintf(stderr, "InitMap(): error allocating memory.\n");
+        FreeMemory(pstMap);
+        LOG_ERROR("InitMap(): error allocating memory.");
         return NULL;
     }
     memcpy(
@@ -215,12 +1274,217 @@ Map *InitMap(
 
     for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
     {
-        pstMap->pstLayer[u8Index] = NULL;
+        pstMap->pstChunks[u8Index] = NULL;
+    }
+
+    pstMap->pstTileset = NULL;
+    pstMap->pstAssets  = pstAssets;
+    pstMap->pstJobs    = NULL;
+    ResetMapStats(pstMap);
+
+    pstMap->pu8TileIsOpaque    = NULL;
+    pstMap->pstCoverage        = NULL;
+    pstMap->pu32BakeList       = NULL;
+    pstMap->u16ChunkCountX     = (pstMap->pstTmxMap->width  + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    pstMap->u16ChunkCountY     = (pstMap->pstTmxMap->height + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    pstMap->u8MipmapCount      = 0;
+    pstMap->dPrefetchLookahead = 0.5;
+    pstMap->u32PrefetchBudget  = 2000;
+    pstMap->u16PrefetchChunks  = 16;
+    pstMap->u8OccluderMask     = UINT8_MAX;
+    pstMap->u8HasLastCamera    = 0;
+    memset(&pstMap->stCache, 0, sizeof(struct MapCacheStats_t));
+
+    pstMap->s16Tileset = LoadAsset(pstAssets, pacTilesetImageFilename, ASSET_SURFACE);
+    if (-1 == pstMap->s16Tileset)
+    {
+        FreeMap(pstMap);
+        return NULL;
+    }
+
+    // Large enough for every chunk of every layer.
+    pstMap->pu32BakeList = AllocMemory(
+        MEMORY_TAG_MAP,
+        (uint32_t)pstMap->u16ChunkCountX * pstMap->u16ChunkCountY *
+        MAP_MAX_LAYERS * sizeof(uint32_t));
+    if (NULL == pstMap->pu32BakeList)
+    {
+        LOG_ERROR("InitMap(): error allocating memory.");
+        FreeMap(pstMap);
+        return NULL;
     }
 
     return pstMap;
 }
 
+/**
+ * @brief   Bake chunks ahead of the Camera.  The viewport is predicted
+ *          dPrefetchLookahead seconds ahead from the movement of the
+ *          Camera since the last call.  Chunks of all layers drawn so
+ *          far are baked in rings around the centre of that viewport,
+ *          up to one chunk beyond its edges.  Baking stops after
+ *          u16PrefetchChunks chunks or once u32PrefetchBudget
+ *          microseconds have been used up; the budget is checked between
+ *          batches of one chunk per thread.  This function should be
+ *          called once per frame after drawing.
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstMap      the Map.  See @ref struct Map.
+ * @param   pstCamera   the Camera.  See @ref struct Camera.
+ * @param   dDeltaTime  time since last frame in seconds.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t PrefetchMap(
+    SDL_Renderer *pstRenderer,
+    Map          *pstMap,
+    const Camera *pstCamera,
+    double        dDeltaTime)
+{
+    uint64_t u64Start       = SDL_GetPerformanceCounter();
+    uint64_t u64Budget      = SDL_GetPerformanceFrequency() * pstMap->u32PrefetchBudget / 1000000;
+    double   dChunkWidth    = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_width;
+    double   dChunkHeight   = MAP_CHUNK_SIZE * pstMap->pstTmxMap->tile_height;
+    double   dVelocityX     = 0;
+    double   dVelocityY     = 0;
+    double   dLeft;
+    double   dTop;
+    int32_t  s32FirstChunkX;
+    int32_t  s32LastChunkX;
+    int32_t  s32FirstChunkY;
+    int32_t  s32LastChunkY;
+    int32_t  s32CenterX;
+    int32_t  s32CenterY;
+    int32_t  s32Radius;
+    uint32_t u32Count       = 0;
+    uint32_t u32Batch       = 1;
+
+    if (pstMap->u8HasLastCamera && dDeltaTime > 0)
+    {
+        dVelocityX = (pstCamera->dPosX - pstMap->dLastCameraPosX) / dDeltaTime;
+        dVelocityY = (pstCamera->dPosY - pstMap->dLastCameraPosY) / dDeltaTime;
+    }
+    pstMap->dLastCameraPosX = pstCamera->dPosX;
+    pstMap->dLastCameraPosY = pstCamera->dPosY;
+    pstMap->u8HasLastCamera = 1;
+
+    // The predicted viewport plus a margin of one chunk.
+    dLeft          = pstCamera->dPosX + dVelocityX * pstMap->dPrefetchLookahead - pstMap->dWorldPosX;
+    dTop           = pstCamera->dPosY + dVelocityY * pstMap->dPrefetchLookahead - pstMap->dWorldPosY;
+    s32FirstChunkX = SDL_max((int32_t)floor(dLeft / dChunkWidth)  - 1, 0);
+    s32FirstChunkY = SDL_max((int32_t)floor(dTop  / dChunkHeight) - 1, 0);
+    s32LastChunkX  = SDL_min((int32_t)floor((dLeft + pstCamera->dViewportWidth)  / dChunkWidth)  + 1, pstMap->u16ChunkCountX - 1);
+    s32LastChunkY  = SDL_min((int32_t)floor((dTop  + pstCamera->dViewportHeight) / dChunkHeight) + 1, pstMap->u16ChunkCountY - 1);
+
+    if ((s32FirstChunkX > s32LastChunkX) || (s32FirstChunkY > s32LastChunkY))
+    {
+        return 0;
+    }
+
+    s32CenterX = (s32FirstChunkX + s32LastChunkX) / 2;
+    s32CenterY = (s32FirstChunkY + s32LastChunkY) / 2;
+    s32Radius  = SDL_max(
+        SDL_max(s32CenterX - s32FirstChunkX, s32LastChunkX - s32CenterX),
+        SDL_max(s32CenterY - s32FirstChunkY, s32LastChunkY - s32CenterY));
+
+    // Closer to the centre comes first.
+    for (int32_t s32Ring = 0; s32Ring <= s32Radius; s32Ring++)
+    {
+        for (int32_t s32ChunkY = s32CenterY - s32Ring; s32ChunkY <= s32CenterY + s32Ring; s32ChunkY++)
+        {
+            for (int32_t s32ChunkX = s32CenterX - s32Ring; s32ChunkX <= s32CenterX + s32Ring; s32ChunkX++)
+            {
+                uint32_t u32Chunk = s32ChunkY * pstMap->u16ChunkCountX + s32ChunkX;
+
+                if ((abs(s32ChunkX - s32CenterX) != s32Ring && abs(s32ChunkY - s32CenterY) != s32Ring) ||
+                    (s32ChunkX < s32FirstChunkX) || (s32ChunkX > s32LastChunkX) ||
+                    (s32ChunkY < s32FirstChunkY) || (s32ChunkY > s32LastChunkY))
+                {
+                    continue;
+                }
+
+                for (uint8_t u8Index = 0; u8Index < MAP_MAX_LAYERS; u8Index++)
+                {
+                    if ((NULL == pstMap->pstChunks[u8Index]) ||
+                        (pstMap->pstChunks[u8Index][u32Chunk].u8IsBaked) ||
+                        (u32Count >= pstMap->u16PrefetchChunks))
+                    {
+                        continue;
+                    }
+                    pstMap->pu32BakeList[u32Count++] = u32Chunk * MAP_MAX_LAYERS + u8Index;
+                }
+            }
+        }
+    }
+
+    if (NULL != pstMap->pstJobs)
+    {
+        u32Batch += pstMap->pstJobs->u8WorkerCount;
+    }
+
+    for (uint32_t u32Item = 0; u32Item < u32Count; u32Item += u32Batch)
+    {
+        if (SDL_GetPerformanceCounter() - u64Start >= u64Budget)
+        {
+            break;
+        }
+
+        if (-1 == _BakeList(
+                pstRenderer,
+                pstMap,
+                &pstMap->pu32BakeList[u32Item],
+                SDL_min(u32Batch, u32Count - u32Item)))
+        {
+            return -1;
+        }
+        pstMap->stCache.u32Prefetched += SDL_min(u32Batch, u32Count - u32Item);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Reset the per-frame draw statistics of the Map.  This
+ *          function has to be called once per frame before drawing.
+ * @param   pstMap a Map.  See @ref struct Map.
+ * @ingroup Map
+ */
+void ResetMapStats(Map *pstMap)
+{
+    pstMap->stStats.u32BlendedPixels   = 0;
+    pstMap->stStats.u32OpaquePixels    = 0;
+    pstMap->stStats.u32SkippedPixels   = 0;
+    pstMap->stStats.u32SkippedChunks   = 0;
+    pstMap->stStats.u32MipmappedChunks = 0;
+}
+
+/**
+ * @brief   Set which layer groups are drawn in front of the Background.
+ *          Only their opaque tiles hide it; a layer group drawn behind
+ *          the Background must not.  By default all layer groups do.
+ * @param   pstMap a Map.  See @ref struct Map.
+ * @param   u8Mask bit n is set if the layer group drawn with index n is
+ *                 in front of the Background.  See DrawMap().
+ * @return  0 on success, -1 on failure.
+ * @ingroup Map
+ */
+int8_t SetMapOccluders(Map *pstMap, uint8_t u8Mask)
+{
+    if (u8Mask == pstMap->u8OccluderMask)
+    {
+        return 0;
+    }
+
+    pstMap->u8OccluderMask = u8Mask;
+
+    // Nothing to rebuild before the first layer group is set up.
+    if (NULL == pstMap->pstCoverage)
+    {
+        return 0;
+    }
+
+    return _BuildCoverage(pstMap);
+}
+
 /**
  * @brief   Check whether a map tile is of a specific type.
  * @param   pstMap  a Map.  See @ref struct Map.
@@ -7,44 +7,165 @@
 
 #include <SDL2/SDL.h>
 #include <stdint.h>
+#include "Asset.h"
+#include "Camera.h"
+#include "Job.h"
+#include "RenderQueue.h"
 #include "tmx/tmx.h"
+#include "tmx/tsx.h"
 
 /**
  * @ingroup Map
  */
 enum MapLimits
 {
-    MAP_MAX_LAYERS = 5
+    MAP_MAX_LAYERS      = 5,
+    MAP_MAX_MIPMAPS     = 2,
+    MAP_MAX_NAME_LENGTH = 32,
+    MAP_CHUNK_SIZE      = 8
 };
 
 /**
+ * @brief   Opaque coverage of a chunk of MAP_CHUNK_SIZE x MAP_CHUNK_SIZE
+ *          tiles.  The tile rows from u8OpaqueTop up to (excluding)
+ *          u8OpaqueBottom are completely covered by opaque tiles of
+ *          at least one layer group set in u8OccluderMask.  Both
+ *          values are equal if the chunk has no such rows.
+ * @ingroup Map
+ */
+typedef struct MapCoverage_t
+{
+    uint8_t u8OpaqueTop;
+    uint8_t u8OpaqueBottom;
+} MapCoverage;
+
+/**
+ * @brief   A baked chunk of a layer group.  Rows from u8UsedTop up to
+ *          (excluding) u8UsedBottom contain tiles; the opaque rows
+ *          within them are drawn without blending.  pstMipmaps holds
+ *          the half- and quarter-resolution versions of pstTexture once
+ *          they have been needed.  pstSurface holds the pixels baked on
+ *          the CPU until they have been uploaded to pstTexture.  Chunks
+ *          are baked on first use; u8IsBaked is set once that happened,
+ *          even if the chunk turned out to be empty.
+ * @ingroup Map
+ */
+typedef struct MapChunk_t
+{
+    SDL_Texture *pstTexture;
+    SDL_Texture *pstMipmaps[MAP_MAX_MIPMAPS];
+    SDL_Surface *pstSurface;
+    MapCoverage  stOpaque;
+    uint8_t      u8UsedTop;
+    uint8_t      u8UsedBottom;
+    uint8_t      u8IsBaked;
+} MapChunk;
+
+/**
+ * @brief   Per-frame draw statistics.  Opaque and skipped pixels are
+ *          the blended area avoided compared to drawing whole layers.
+ * @ingroup Map
+ */
+typedef struct MapStats_t
+{
+    uint32_t u32BlendedPixels;
+    uint32_t u32OpaquePixels;
+    uint32_t u32SkippedPixels;
+    uint32_t u32SkippedChunks;
+    uint32_t u32MipmappedChunks;
+} MapStats;
+
+/**
+ * @brief   Chunk cache statistics since the Map has been loaded.  Hits
+ *          are visible chunks which had been baked already, misses had
+ *          to be baked while drawing.  dWorstHitch is the longest time
+ *          in milliseconds a single DrawMap() call spent on baking.
+ * @ingroup Map
+ */
+typedef struct MapCacheStats_t
+{
+    uint32_t u32Hits;
+    uint32_t u32Misses;
+    uint32_t u32Prefetched;
+    double   dWorstHitch;
+} MapCacheStats;
+
+/**
+ * @brief   pstTileset is a CPU copy of the tileset image in
+ *          SDL_PIXELFORMAT_ARGB8888 which chunks are baked from; it is
+ *          owned by the AssetManager.  With a
+ *          JobSystem set, chunks are baked in parallel.  PrefetchMap()
+ *          bakes chunks ahead of the Camera within u32PrefetchBudget
+ *          microseconds and at most u16PrefetchChunks chunks per frame.
+ *          Bit n of u8OccluderMask is set if layer group n is drawn in
+ *          front of the Background.  See SetMapOccluders().
  * @ingroup Map
  */
 typedef struct Map_t
 {
-    tmx_map     *pstTmxMap;
-    char        *pacTilesetImageFilename;
-    SDL_Texture *pstLayer[MAP_MAX_LAYERS];
-    uint32_t     u32Height;
-    uint32_t     u32Width;
-    double       dWorldPosX;
-    double       dWorldPosY;
+    tmx_map             *pstTmxMap;
+    tmx_tileset_manager *pstTilesets;
+    char                *pacTilesetImageFilename;
+    MapChunk            *pstChunks[MAP_MAX_LAYERS];
+    char                 aacLayerNames[MAP_MAX_LAYERS][MAP_MAX_NAME_LENGTH];
+    SDL_Surface         *pstTileset;
+    AssetManager        *pstAssets;
+    JobSystem           *pstJobs;
+    MapStats             stStats;
+    MapCacheStats        stCache;
+    uint8_t             *pu8TileIsOpaque;
+    MapCoverage         *pstCoverage;
+    uint32_t            *pu32BakeList;
+    uint16_t             u16ChunkCountX;
+    uint16_t             u16ChunkCountY;
+    uint8_t              u8MipmapCount;
+    uint32_t             u32Height;
+    uint32_t             u32Width;
+    double               dWorldPosX;
+    double               dWorldPosY;
+    double               dPrefetchLookahead;
+    uint32_t             u32PrefetchBudget;
+    uint16_t             u16PrefetchChunks;
+    uint8_t              u8OccluderMask;
+    /* Remark: the following variables are used internally. */
+    int16_t              s16Tileset;
+    double               dLastCameraPosX;
+    double               dLastCameraPosY;
+    uint8_t              u8HasLastCamera;
 } Map;
 
 int8_t DrawMap(
     SDL_Renderer  *pstRenderer,
+    RenderQueue   *pstQueue,
     Map           *pstMap,
     const char    *pacLayerName,
     const uint8_t  u8RenderBgColour,
     const uint8_t  u8Index,
-    const double   dCameraPosX,
-    const double   dCameraPosY);
+    const uint16_t u16Layer,
+    const Camera  *pstCamera);
 
 void FreeMap(Map *pstMap);
 
+MapCacheStats GetMapCacheStats(const Map *pstMap);
+
+MapStats GetMapStats(const Map *pstMap);
+
+uint8_t HasMapLayer(const Map *pstMap, const char *pacLayerName);
+
 Map *InitMap(
-    const char *pacFilename,
-    const char *pacTilesetImageFilename);
+    const char   *pacFilename,
+    const char   *pacTilesetImageFilename,
+    AssetManager *pstAssets);
+
+int8_t PrefetchMap(
+    SDL_Renderer *pstRenderer,
+    Map          *pstMap,
+    const Camera *pstCamera,
+    double        dDeltaTime);
+
+void ResetMapStats(Map *pstMap);
+
+int8_t SetMapOccluders(Map *pstMap, uint8_t u8Mask);
 
 uint8_t IsMapCoordOfType(
     const Map  *pstMap,
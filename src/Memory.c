@@ -0,0 +1,410 @@
+/**
+ * @file      Memory.c
+ * @ingroup   Memory
+ * @defgroup  Memory
+ * @brief     Memory accounting.  Heap allocations carry a small header
+ *            with their size and the subsystem they belong to; textures
+ *            carry the same along with an estimate of their size as
+ *            user data.  Current and peak usage are tracked per subsystem
+ *            and checked against an optional budget.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Log.h"
+#include "Memory.h"
+
+/**
+ * @brief   Precedes every tracked allocation.  The union keeps the data
+ *          behind it as aligned as malloc() would.
+ * @ingroup Memory
+ */
+typedef union MemoryHeader_u
+{
+    struct
+    {
+        size_t  zSize;
+        uint8_t u8Tag;
+    } stInfo;
+    long double ldAlign;
+    long long   llAlign;
+    void       *pAlign;
+} MemoryHeader;
+
+static const char *_apacTagNames[MEMORY_TAG_COUNT] =
+{
+    "Animation",
+    "Asset",
+    "Background",
+    "Camera",
+    "Core",
+    "Entity",
+    "Map",
+    "Pack",
+    "Renderer",
+    "Scene",
+    "Simulation",
+    "tmx"
+};
+
+static MemoryStats  _astStats[MEMORY_TAG_COUNT];
+static SDL_SpinLock _stLock;
+static uint64_t     _u64Allocated;
+
+static void _Update(
+    uint8_t u8Tag,
+    uint8_t u8IsTexture,
+    size_t  zAdded,
+    size_t  zRemoved,
+    int8_t  s8Count)
+{
+    MemoryStats *pstStats   = &_astStats[u8Tag];
+    MemoryUsage *pstUsage   = u8IsTexture ? &pstStats->stTexture : &pstStats->stHeap;
+    size_t       zBudget;
+    uint8_t      u8Exceeded = 0;
+
+    SDL_AtomicLock(&_stLock);
+
+    pstUsage->zCurrent = pstUsage->zCurrent + zAdded - zRemoved;
+    if (zAdded > zRemoved)
+    {
+        _u64Allocated += zAdded - zRemoved;
+    }
+    if (pstUsage->zCurrent > pstUsage->zPeak)
+    {
+        pstUsage->zPeak = pstUsage->zCurrent;
+    }
+
+    if (u8IsTexture)
+    {
+        pstStats->u32Textures += s8Count;
+    }
+    else
+    {
+        pstStats->u32Allocations += s8Count;
+    }
+
+    // Only crossing the budget is reported, not every allocation beyond.
+    zBudget = pstStats->zBudget;
+    if ((zBudget > 0) && (pstStats->stHeap.zCurrent + pstStats->stTexture.zCurrent > zBudget))
+    {
+        u8Exceeded               = ! pstStats->u8IsOverBudget;
+        pstStats->u8IsOverBudget = 1;
+    }
+    else
+    {
+        pstStats->u8IsOverBudget = 0;
+    }
+
+    SDL_AtomicUnlock(&_stLock);
+
+    if (u8Exceeded)
+    {
+        LOG_ERROR("Memory: %s exceeds its budget of %zu KiB.", _apacTagNames[u8Tag], zBudget / 1024);
+    }
+}
+
+static size_t _EstimateTextureSize(uint32_t u32Format, int32_t s32Width, int32_t s32Height)
+{
+    size_t zPixels = (size_t)s32Width * (size_t)s32Height;
+
+    // YUV formats take 12 to 16 bits per pixel.
+    if (SDL_ISPIXELFORMAT_FOURCC(u32Format))
+    {
+        return zPixels * 2;
+    }
+
+    return zPixels * SDL_BYTESPERPIXEL(u32Format);
+}
+
+/**
+ * @brief   Allocate memory on behalf of a subsystem.  Must be freed
+ *          using FreeMemory().
+ * @param   u8Tag  the MemoryTag to account the allocation to.
+ * @param   zSize  the size in bytes.
+ * @return  the allocated memory on success, NULL on failure.
+ * @ingroup Memory
+ */
+void *AllocMemory(uint8_t u8Tag, size_t zSize)
+{
+    MemoryHeader *pstHeader;
+
+    if (zSize > SIZE_MAX - sizeof(union MemoryHeader_u))
+    {
+        return NULL;
+    }
+
+    pstHeader = malloc(sizeof(union MemoryHeader_u) + zSize);
+    if (NULL == pstHeader)
+    {
+        return NULL;
+    }
+
+    pstHeader->stInfo.zSize = zSize;
+    pstHeader->stInfo.u8Tag = u8Tag;
+    _Update(u8Tag, 0, zSize, 0, 1);
+
+    return pstHeader + 1;
+}
+
+/**
+ * @brief   Like AllocMemory(), but for an array which is zeroed.
+ * @param   u8Tag  the MemoryTag to account the allocation to.
+ * @param   zCount the number of elements.
+ * @param   zSize  the size of each element in bytes.
+ * @return  the allocated memory on success, NULL on failure.
+ * @ingroup Memory
+ */
+void *AllocZeroedMemory(uint8_t u8Tag, size_t zCount, size_t zSize)
+{
+    MemoryHeader *pstHeader;
+    size_t        zTotal;
+
+    if ((zSize > 0) && (zCount > (SIZE_MAX - sizeof(union MemoryHeader_u)) / zSize))
+    {
+        return NULL;
+    }
+    zTotal = zCount * zSize;
+
+    pstHeader = calloc(1, sizeof(union MemoryHeader_u) + zTotal);
+    if (NULL == pstHeader)
+    {
+        return NULL;
+    }
+
+    pstHeader->stInfo.zSize = zTotal;
+    pstHeader->stInfo.u8Tag = u8Tag;
+    _Update(u8Tag, 0, zTotal, 0, 1);
+
+    return pstHeader + 1;
+}
+
+/**
+ * @brief   Create a texture on behalf of a subsystem.  Must be
+ *          destroyed using DestroyTrackedTexture().  The parameters
+ *          are the ones of SDL_CreateTexture().
+ * @param   u8Tag the MemoryTag to account the texture to.
+ * @return  the texture on success, NULL on failure.
+ * @ingroup Memory
+ */
+SDL_Texture *CreateTrackedTexture(
+    uint8_t       u8Tag,
+    SDL_Renderer *pstRenderer,
+    uint32_t      u32Format,
+    int32_t       s32Access,
+    int32_t       s32Width,
+    int32_t       s32Height)
+{
+    SDL_Texture   *pstTexture;
+    MemoryTexture *pstInfo;
+
+    pstTexture = SDL_CreateTexture(pstRenderer, u32Format, s32Access, s32Width, s32Height);
+    if (NULL == pstTexture)
+    {
+        return NULL;
+    }
+
+    pstInfo = malloc(sizeof(struct MemoryTexture_t));
+    if (NULL == pstInfo)
+    {
+        // Still usable, just not accounted for.
+        LOG_ERROR("CreateTrackedTexture(): error allocating memory.");
+        return pstTexture;
+    }
+    pstInfo->zBytes = _EstimateTextureSize(u32Format, s32Width, s32Height);
+    pstInfo->u8Tag  = u8Tag;
+    SDL_SetTextureUserData(pstTexture, pstInfo);
+
+    _Update(u8Tag, 1, pstInfo->zBytes, 0, 1);
+
+    return pstTexture;
+}
+
+/**
+ * @brief   Destroy a texture created by CreateTrackedTexture().
+ * @param   pstTexture the texture or NULL.
+ * @ingroup Memory
+ */
+void DestroyTrackedTexture(SDL_Texture *pstTexture)
+{
+    MemoryTexture *pstInfo;
+
+    if (NULL == pstTexture)
+    {
+        return;
+    }
+
+    pstInfo = SDL_GetTextureUserData(pstTexture);
+    if (NULL != pstInfo)
+    {
+        _Update(pstInfo->u8Tag, 1, 0, pstInfo->zBytes, -1);
+        free(pstInfo);
+    }
+
+    SDL_DestroyTexture(pstTexture);
+}
+
+/**
+ * @brief   Free memory allocated by AllocMemory(), AllocZeroedMemory()
+ *          or ReallocMemory().
+ * @param   pData the memory or NULL.
+ * @ingroup Memory
+ */
+void FreeMemory(void *pData)
+{
+    MemoryHeader *pstHeader;
+
+    if (NULL == pData)
+    {
+        return;
+    }
+
+    pstHeader = (MemoryHeader *)pData - 1;
+    _Update(pstHeader->stInfo.u8Tag, 0, 0, pstHeader->stInfo.zSize, -1);
+    free(pstHeader);
+}
+
+/**
+ * @brief   Get the heap and texture memory allocated so far by all
+ *          subsystems together, not counting what has been freed, e.g.
+ *          to attribute allocations to a period of time.
+ * @return  the number of bytes.
+ * @ingroup Memory
+ */
+uint64_t GetMemoryAllocated(void)
+{
+    uint64_t u64Allocated;
+
+    SDL_AtomicLock(&_stLock);
+    u64Allocated = _u64Allocated;
+    SDL_AtomicUnlock(&_stLock);
+
+    return u64Allocated;
+}
+
+/**
+ * @brief   Get the memory usage of a subsystem.
+ * @param   u8Tag the MemoryTag.
+ * @return  a copy of its MemoryStats.  See @ref struct MemoryStats.
+ * @ingroup Memory
+ */
+MemoryStats GetMemoryStats(uint8_t u8Tag)
+{
+    MemoryStats stStats;
+
+    SDL_AtomicLock(&_stLock);
+    stStats = _astStats[u8Tag];
+    SDL_AtomicUnlock(&_stLock);
+
+    return stStats;
+}
+
+/**
+ * @brief   Resize memory like realloc().  Memory which has already been
+ *          allocated stays with the MemoryTag it was allocated for.
+ * @param   u8Tag the MemoryTag to account new memory to.
+ * @param   pData the memory or NULL.
+ * @param   zSize the new size in bytes.  With 0, the memory is freed.
+ * @return  the resized memory on success, NULL on failure, in which
+ *          case pData is left untouched.
+ * @ingroup Memory
+ */
+void *ReallocMemory(uint8_t u8Tag, void *pData, size_t zSize)
+{
+    MemoryHeader *pstHeader;
+    MemoryHeader *pstResized;
+    size_t        zOldSize;
+
+    if (NULL == pData)
+    {
+        return AllocMemory(u8Tag, zSize);
+    }
+
+    if (0 == zSize)
+    {
+        FreeMemory(pData);
+        return NULL;
+    }
+
+    if (zSize > SIZE_MAX - sizeof(union MemoryHeader_u))
+    {
+        return NULL;
+    }
+
+    pstHeader  = (MemoryHeader *)pData - 1;
+    zOldSize   = pstHeader->stInfo.zSize;
+    pstResized = realloc(pstHeader, sizeof(union MemoryHeader_u) + zSize);
+    if (NULL == pstResized)
+    {
+        return NULL;
+    }
+
+    pstResized->stInfo.zSize = zSize;
+    _Update(pstResized->stInfo.u8Tag, 0, zSize, zOldSize, 0);
+
+    return pstResized + 1;
+}
+
+/**
+ * @brief   Print current and peak usage of each subsystem to stdout.
+ * @ingroup Memory
+ */
+void ReportMemory(void)
+{
+    printf("Memory:\n");
+    printf(
+        "  %-12s %8s %10s %10s %10s %10s %10s\n",
+        "Subsystem", "Blocks", "Heap KiB", "Peak KiB", "VRAM KiB", "Peak KiB", "Budget KiB");
+
+    for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAG_COUNT; u8Tag++)
+    {
+        MemoryStats stStats = GetMemoryStats(u8Tag);
+
+        printf(
+            "  %-12s %8lu %10lu %10lu %10lu %10lu %10lu%s\n",
+            _apacTagNames[u8Tag],
+            (unsigned long)stStats.u32Allocations + stStats.u32Textures,
+            (unsigned long)(stStats.stHeap.zCurrent    / 1024),
+            (unsigned long)(stStats.stHeap.zPeak       / 1024),
+            (unsigned long)(stStats.stTexture.zCurrent / 1024),
+            (unsigned long)(stStats.stTexture.zPeak    / 1024),
+            (unsigned long)(stStats.zBudget            / 1024),
+            stStats.u8IsOverBudget ? " over budget" : "");
+    }
+}
+
+/**
+ * @brief   Reset the peaks to the current usage, e.g. before loading a
+ *          level.
+ * @ingroup Memory
+ */
+void ResetMemoryPeaks(void)
+{
+    SDL_AtomicLock(&_stLock);
+    for (uint8_t u8Tag = 0; u8Tag < MEMORY_TAG_COUNT; u8Tag++)
+    {
+        _astStats[u8Tag].stHeap.zPeak    = _astStats[u8Tag].stHeap.zCurrent;
+        _astStats[u8Tag].stTexture.zPeak = _astStats[u8Tag].stTexture.zCurrent;
+    }
+    SDL_AtomicUnlock(&_stLock);
+}
+
+/**
+ * @brief   Set the budget of a subsystem.  An error is logged whenever
+ *          its heap and texture memory together grow beyond it.
+ * @param   u8Tag  the MemoryTag.
+ * @param   zBytes the budget in bytes, 0 for none.
+ * @ingroup Memory
+ */
+void SetMemoryBudget(uint8_t u8Tag, size_t zBytes)
+{
+    SDL_AtomicLock(&_stLock);
+    _astStats[u8Tag].zBudget        = zBytes;
+    _astStats[u8Tag].u8IsOverBudget = 0;
+    SDL_AtomicUnlock(&_stLock);
+}
@@ -0,0 +1,98 @@
+/**
+ * @file    Memory.h
+ * @ingroup Memory
+ */
+
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief   The subsystem an allocation is accounted to.
+ * @ingroup Memory
+ */
+enum MemoryTag
+{
+    MEMORY_TAG_ANIMATION = 0,
+    MEMORY_TAG_ASSET,
+    MEMORY_TAG_BACKGROUND,
+    MEMORY_TAG_CAMERA,
+    MEMORY_TAG_CORE,
+    MEMORY_TAG_ENTITY,
+    MEMORY_TAG_MAP,
+    MEMORY_TAG_PACK,
+    MEMORY_TAG_RENDERER,
+    MEMORY_TAG_SCENE,
+    MEMORY_TAG_SIMULATION,
+    MEMORY_TAG_TMX,
+    MEMORY_TAG_COUNT
+};
+
+/**
+ * @ingroup Memory
+ */
+typedef struct MemoryUsage_t
+{
+    size_t zCurrent;
+    size_t zPeak;
+} MemoryUsage;
+
+/**
+ * @brief   Heap and texture memory of one subsystem.  Texture memory is
+ *          estimated from format and size; the driver may need more.
+ *          The budget covers both, 0 means none.
+ * @ingroup Memory
+ */
+typedef struct MemoryStats_t
+{
+    MemoryUsage stHeap;
+    MemoryUsage stTexture;
+    size_t      zBudget;
+    uint32_t    u32Allocations;
+    uint32_t    u32Textures;
+    uint8_t     u8IsOverBudget;
+} MemoryStats;
+
+/**
+ * @brief   Attached as user data to every texture created by
+ *          CreateTrackedTexture().
+ * @ingroup Memory
+ */
+typedef struct MemoryTexture_t
+{
+    size_t  zBytes;
+    uint8_t u8Tag;
+} MemoryTexture;
+
+void *AllocMemory(uint8_t u8Tag, size_t zSize);
+
+void *AllocZeroedMemory(uint8_t u8Tag, size_t zCount, size_t zSize);
+
+SDL_Texture *CreateTrackedTexture(
+    uint8_t       u8Tag,
+    SDL_Renderer *pstRenderer,
+    uint32_t      u32Format,
+    int32_t       s32Access,
+    int32_t       s32Width,
+    int32_t       s32Height);
+
+void DestroyTrackedTexture(SDL_Texture *pstTexture);
+
+void FreeMemory(void *pData);
+
+uint64_t GetMemoryAllocated(void);
+
+MemoryStats GetMemoryStats(uint8_t u8Tag);
+
+void *ReallocMemory(uint8_t u8Tag, void *pData, size_t zSize);
+
+void ReportMemory(void);
+
+void ResetMemoryPeaks(void);
+
+void SetMemoryBudget(uint8_t u8Tag, size_t zBytes);
+
+#endif
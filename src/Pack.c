@@ -0,0 +1,624 @@
+/**
+ * @file      Pack.c
+ * @ingroup   Pack
+ * @defgroup  Pack
+ * @brief     Read-only resource archive.  The archive is mapped into
+ *            memory once and files are handed out as pointers into the
+ *            mapping, so stored files are never copied.  Paths which
+ *            are not in the archive, or all paths if none is mounted,
+ *            are read from the file system instead.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "inih/ini.h"
+#include "Log.h"
+#include "Macros.h"
+#include "Memory.h"
+#include "Pack.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PACK_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief This structure is used to feed a file in memory to inih line by
+ * line.
+ */
+typedef struct PackReader_t
+{
+    const char *pacCursor;
+    const char *pacEnd;
+} PackReader;
+
+/* Reads are recorded whether an archive is mounted or not, so the
+ * record is kept outside of any Pack. */
+static PackRead     _astReads[PACK_MAX_READS];
+static uint16_t     _u16ReadCount;
+static SDL_SpinLock _stReadLock;
+
+static void _RecordRead(const char *pacPath, uint64_t u64Bytes, uint64_t u64Copied)
+{
+    PackRead *pstRead = NULL;
+
+    SDL_AtomicLock(&_stReadLock);
+
+    for (uint16_t u16Index = 0; u16Index < _u16ReadCount; u16Index++)
+    {
+        if (0 == strncmp(pacPath, _astReads[u16Index].acPath, PACK_MAX_PATH_LENGTH - 1))
+        {
+            pstRead = &_astReads[u16Index];
+            break;
+        }
+    }
+
+    // Once full, further files simply aren't recorded.
+    if ((NULL == pstRead) && (_u16ReadCount < PACK_MAX_READS))
+    {
+        pstRead = &_astReads[_u16ReadCount];
+        snprintf(pstRead->acPath, PACK_MAX_PATH_LENGTH, "%s", pacPath);
+        _u16ReadCount++;
+    }
+
+    if (NULL != pstRead)
+    {
+        pstRead->u64Bytes  += u64Bytes;
+        pstRead->u64Copied += u64Copied;
+        pstRead->u32Count++;
+    }
+
+    SDL_AtomicUnlock(&_stReadLock);
+}
+
+static int8_t _NormalizePath(const char *pacPath, char *pacNormalized)
+{
+    size_t zLength = 0;
+
+    while ('\0' != *pacPath)
+    {
+        const char *pacNext = strchr(pacPath, '/');
+        size_t      zPart;
+
+        if (NULL == pacNext)
+        {
+            pacNext = pacPath + strlen(pacPath);
+        }
+        zPart = pacNext - pacPath;
+
+        if ((2 == zPart) && (0 == strncmp(pacPath, "..", 2)))
+        {
+            while ((zLength > 0) && ('/' != pacNormalized[zLength - 1]))
+            {
+                zLength--;
+            }
+            if (zLength > 0)
+            {
+                zLength--;
+            }
+        }
+        else if ((zPart > 0) && ! ((1 == zPart) && ('.' == pacPath[0])))
+        {
+            if (zLength + 1 + zPart >= PACK_MAX_PATH_LENGTH)
+            {
+                return -1;
+            }
+            if (zLength > 0)
+            {
+                pacNormalized[zLength++] = '/';
+            }
+            memcpy(&pacNormalized[zLength], pacPath, zPart);
+            zLength += zPart;
+        }
+
+        pacPath = ('\0' == *pacNext) ? pacNext : pacNext + 1;
+    }
+    pacNormalized[zLength] = '\0';
+
+    return 0;
+}
+
+static const PackEntry *_FindEntry(Pack *pstPack, const char *pacPath)
+{
+    char     acPath[PACK_MAX_PATH_LENGTH];
+    uint32_t u32Low  = 0;
+    uint32_t u32High;
+
+    if ((NULL == pstPack) || (-1 == _NormalizePath(pacPath, acPath)))
+    {
+        return NULL;
+    }
+
+    u32High = pstPack->u32EntryCount;
+    while (u32Low < u32High)
+    {
+        uint32_t u32Middle = u32Low + (u32High - u32Low) / 2;
+        int32_t  s32Order  = strcmp(acPath, pstPack->pstEntries[u32Middle].acPath);
+
+        if (0 == s32Order)
+        {
+            return &pstPack->pstEntries[u32Middle];
+        }
+        else if (s32Order < 0)
+        {
+            u32High = u32Middle;
+        }
+        else
+        {
+            u32Low = u32Middle + 1;
+        }
+    }
+
+    return NULL;
+}
+
+/* Same as SDL_LoadFile(), only accounted to MEMORY_TAG_PACK. */
+static void *_LoadFile(const char *pacPath, size_t *pzSize)
+{
+    SDL_RWops *pstFile = SDL_RWFromFile(pacPath, "rb");
+    Sint64     s64Size;
+    void      *pData;
+
+    if (NULL == pstFile)
+    {
+        return NULL;
+    }
+
+    s64Size = SDL_RWsize(pstFile);
+    if (s64Size < 0)
+    {
+        SDL_RWclose(pstFile);
+        return NULL;
+    }
+
+    pData = AllocMemory(MEMORY_TAG_PACK, (size_t)s64Size + 1);
+    if ((NULL != pData) && (s64Size > 0) && (1 != SDL_RWread(pstFile, pData, (size_t)s64Size, 1)))
+    {
+        FreeMemory(pData);
+        pData = NULL;
+    }
+    else if (NULL != pData)
+    {
+        ((char *)pData)[s64Size] = '\0';
+    }
+    SDL_RWclose(pstFile);
+
+    *pzSize = (size_t)s64Size;
+    return pData;
+}
+
+static void *_Inflate(Pack *pstPack, const PackEntry *pstEntry, size_t *pzSize)
+{
+    uLongf   zSize = SDL_SwapLE32(pstEntry->u32Size);
+    uint8_t *pu8Data;
+
+    pu8Data = AllocMemory(MEMORY_TAG_PACK, zSize + 1);
+    if (NULL == pu8Data)
+    {
+        LOG_ERROR("LoadPackFile(): error allocating memory.");
+        return NULL;
+    }
+
+    if ((Z_OK != uncompress(
+             pu8Data,
+             &zSize,
+             pstPack->pu8Data + SDL_SwapLE32(pstEntry->u32Offset),
+             SDL_SwapLE32(pstEntry->u32StoredSize))) ||
+        (zSize != SDL_SwapLE32(pstEntry->u32Size)))
+    {
+        LOG_ERROR("LoadPackFile(): %s is corrupt.", pstEntry->acPath);
+        FreeMemory(pu8Data);
+        return NULL;
+    }
+
+    *pzSize = zSize;
+    return pu8Data;
+}
+
+static int8_t _Map(Pack *pstPack, const char *pacFilename)
+{
+    #ifdef PACK_USE_MMAP
+    struct stat  stStat;
+    void        *pData;
+    int32_t      s32File = open(pacFilename, O_RDONLY);
+
+    if (-1 == s32File)
+    {
+        return -1;
+    }
+
+    if ((0 != fstat(s32File, &stStat)) || (0 == stStat.st_size))
+    {
+        close(s32File);
+        return -1;
+    }
+
+    // The mapping stays valid after the file is closed.
+    pData = mmap(NULL, stStat.st_size, PROT_READ, MAP_PRIVATE, s32File, 0);
+    close(s32File);
+    if (MAP_FAILED == pData)
+    {
+        return -1;
+    }
+
+    pstPack->pu8Data    = pData;
+    pstPack->zSize      = stStat.st_size;
+    pstPack->u8IsMapped = 1;
+    #else
+    pstPack->pu8Data = _LoadFile(pacFilename, &pstPack->zSize);
+    if (NULL == pstPack->pu8Data)
+    {
+        return -1;
+    }
+    #endif
+
+    return 0;
+}
+
+static int8_t _Validate(Pack *pstPack)
+{
+    const PackHeader *pstHeader = (const PackHeader *)pstPack->pu8Data;
+    uint64_t          u64Index;
+
+    if ((pstPack->zSize < sizeof(struct PackHeader_t)) ||
+        (0 != memcmp(pstHeader->acMagic, "BSPK", 4)) ||
+        (PACK_VERSION != SDL_SwapLE32(pstHeader->u32Version)))
+    {
+        return -1;
+    }
+
+    pstPack->u32EntryCount = SDL_SwapLE32(pstHeader->u32EntryCount);
+    pstPack->pstEntries    = (const PackEntry *)(pstPack->pu8Data + sizeof(struct PackHeader_t));
+
+    u64Index = sizeof(struct PackHeader_t) + (uint64_t)pstPack->u32EntryCount * sizeof(struct PackEntry_t);
+    if (u64Index > pstPack->zSize)
+    {
+        return -1;
+    }
+
+    // Checked once here, so lookups can trust the index.
+    for (uint32_t u32Index = 0; u32Index < pstPack->u32EntryCount; u32Index++)
+    {
+        const PackEntry *pstEntry  = &pstPack->pstEntries[u32Index];
+        uint32_t         u32Offset = SDL_SwapLE32(pstEntry->u32Offset);
+
+        if (('\0' != pstEntry->acPath[PACK_MAX_PATH_LENGTH - 1]) ||
+            (0 != u32Offset % PACK_ALIGNMENT) ||
+            ((uint64_t)u32Offset + SDL_SwapLE32(pstEntry->u32StoredSize) > pstPack->zSize))
+        {
+            return -1;
+        }
+
+        if (FLAG_IS_NOT_SET(SDL_SwapLE32(pstEntry->u32Flags), PACK_ENTRY_DEFLATED) &&
+            (pstEntry->u32StoredSize != pstEntry->u32Size))
+        {
+            return -1;
+        }
+
+        if ((u32Index > 0) && (strcmp(pstEntry[-1].acPath, pstEntry->acPath) >= 0))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int32_t _CloseInflated(SDL_RWops *pstRW)
+{
+    FreeMemory(pstRW->hidden.mem.base);
+    SDL_FreeRW(pstRW);
+    return 0;
+}
+
+static char *_ReadLine(char *pacString, int32_t s32Size, void *pStream)
+{
+    PackReader *pstReader = (PackReader *)pStream;
+    int32_t     s32Length = 0;
+
+    if (pstReader->pacCursor >= pstReader->pacEnd)
+    {
+        return NULL;
+    }
+
+    while ((s32Length < s32Size - 1) && (pstReader->pacCursor < pstReader->pacEnd))
+    {
+        char cChar = *pstReader->pacCursor++;
+
+        pacString[s32Length++] = cChar;
+        if ('\n' == cChar)
+        {
+            break;
+        }
+    }
+    pacString[s32Length] = '\0';
+
+    return pacString;
+}
+
+/**
+ * @brief   Unmount Pack and free it from memory.  Files loaded from it
+ *          must not be used anymore.
+ * @param   pstPack a Pack.  See @ref struct Pack.
+ * @ingroup Pack
+ */
+void FreePack(Pack *pstPack)
+{
+    if (NULL == pstPack)
+    {
+        return;
+    }
+
+    #ifdef PACK_USE_MMAP
+    if (pstPack->u8IsMapped)
+    {
+        munmap((void *)pstPack->pu8Data, pstPack->zSize);
+    }
+    #else
+    FreeMemory((void *)pstPack->pu8Data);
+    #endif
+    FreeMemory(pstPack);
+}
+
+/**
+ * @brief   Release a file returned by LoadPackFile().  Files stored in
+ *          the archive itself are left alone.
+ * @param   pstPack a Pack or NULL.  See @ref struct Pack.
+ * @param   pData   the file.
+ * @ingroup Pack
+ */
+void FreePackFile(Pack *pstPack, const void *pData)
+{
+    if (NULL == pData)
+    {
+        return;
+    }
+
+    if ((NULL != pstPack) &&
+        ((const uint8_t *)pData >= pstPack->pu8Data) &&
+        ((const uint8_t *)pData <  pstPack->pu8Data + pstPack->zSize))
+    {
+        return;
+    }
+
+    FreeMemory((void *)pData);
+}
+
+/**
+ * @brief   Get the files read so far, e.g. to attribute startup time
+ *          and memory to them.  Reading the same file again adds to its
+ *          record.
+ * @param   pstReads    returns the records.
+ * @param   u16MaxReads the number of records pstReads can hold.
+ * @return  the number of records returned.
+ * @ingroup Pack
+ */
+uint16_t GetPackReads(PackRead *pstReads, uint16_t u16MaxReads)
+{
+    uint16_t u16Count;
+
+    SDL_AtomicLock(&_stReadLock);
+    u16Count = SDL_min(u16MaxReads, _u16ReadCount);
+    memcpy(pstReads, _astReads, u16Count * sizeof(struct PackRead_t));
+    SDL_AtomicUnlock(&_stReadLock);
+
+    return u16Count;
+}
+
+/**
+ * @brief   Mount an archive built by tools/pack.
+ * @param   pacFilename the filename of the archive.
+ * @return  a Pack on success, NULL on failure.
+ * @ingroup Pack
+ */
+Pack *InitPack(const char *pacFilename)
+{
+    struct stat  stStat;
+    static Pack *pstPack;
+    pstPack = AllocZeroedMemory(MEMORY_TAG_PACK, 1, sizeof(struct Pack_t));
+    if (NULL == pstPack)
+    {
+        LOG_ERROR("InitPack(): error allocating memory.");
+        return NULL;
+    }
+
+    if (-1 == _Map(pstPack, pacFilename))
+    {
+        LOG_ERROR("InitPack(): couldn't open %s", pacFilename);
+        FreeMemory(pstPack);
+        return NULL;
+    }
+
+    if (-1 == _Validate(pstPack))
+    {
+        LOG_ERROR("InitPack(): %s is not a valid archive.", pacFilename);
+        FreePack(pstPack);
+        return NULL;
+    }
+
+    if (0 == stat(pacFilename, &stStat))
+    {
+        pstPack->s64ModifiedTime = stStat.st_mtime;
+    }
+
+    return pstPack;
+}
+
+/**
+ * @brief   Load a whole file.  A file stored uncompressed is returned
+ *          in place, without copying it.  The file is not terminated.
+ * @param   pstPack a Pack or NULL.  See @ref struct Pack.
+ * @param   pacPath the path of the file.
+ * @param   pzSize  returns the size of the file in bytes.
+ * @return  the file on success, NULL on failure.  Must be released
+ *          using FreePackFile().
+ * @ingroup Pack
+ */
+const void *LoadPackFile(Pack *pstPack, const char *pacPath, size_t *pzSize)
+{
+    const PackEntry *pstEntry = _FindEntry(pstPack, pacPath);
+    void            *pData;
+
+    if (NULL == pstEntry)
+    {
+        pData = _LoadFile(pacPath, pzSize);
+        if (NULL == pData)
+        {
+            LOG_ERROR("LoadPackFile(): couldn't read %s", pacPath);
+            return NULL;
+        }
+        _RecordRead(pacPath, *pzSize, *pzSize);
+        return pData;
+    }
+
+    if (FLAG_IS_SET(SDL_SwapLE32(pstEntry->u32Flags), PACK_ENTRY_DEFLATED))
+    {
+        pData = _Inflate(pstPack, pstEntry, pzSize);
+        if (NULL != pData)
+        {
+            _RecordRead(pacPath, *pzSize, *pzSize);
+        }
+        return pData;
+    }
+
+    *pzSize = SDL_SwapLE32(pstEntry->u32Size);
+    _RecordRead(pacPath, *pzSize, 0);
+    return pstPack->pu8Data + SDL_SwapLE32(pstEntry->u32Offset);
+}
+
+/**
+ * @brief   Open a file as SDL_RWops, e.g. for IMG_Load_RW().  A file
+ *          stored uncompressed is read in place, without copying it.
+ * @param   pstPack a Pack or NULL.  See @ref struct Pack.
+ * @param   pacPath the path of the file.
+ * @return  the opened file on success, NULL on failure.
+ * @ingroup Pack
+ */
+SDL_RWops *OpenPackFile(Pack *pstPack, const char *pacPath)
+{
+    const PackEntry *pstEntry = _FindEntry(pstPack, pacPath);
+    SDL_RWops       *pstRW;
+    void            *pData;
+    size_t           zSize;
+
+    if (NULL == pstEntry)
+    {
+        pstRW = SDL_RWFromFile(pacPath, "rb");
+        if (NULL != pstRW)
+        {
+            _RecordRead(pacPath, (uint64_t)SDL_max(SDL_RWsize(pstRW), 0), 0);
+        }
+        return pstRW;
+    }
+
+    if (FLAG_IS_NOT_SET(SDL_SwapLE32(pstEntry->u32Flags), PACK_ENTRY_DEFLATED))
+    {
+        _RecordRead(pacPath, SDL_SwapLE32(pstEntry->u32Size), 0);
+        return SDL_RWFromConstMem(
+            pstPack->pu8Data + SDL_SwapLE32(pstEntry->u32Offset),
+            SDL_SwapLE32(pstEntry->u32Size));
+    }
+
+    pData = _Inflate(pstPack, pstEntry, &zSize);
+    if (NULL == pData)
+    {
+        return NULL;
+    }
+
+    // The inflated copy belongs to the stream from here on.
+    pstRW = SDL_RWFromConstMem(pData, zSize);
+    if (NULL == pstRW)
+    {
+        FreeMemory(pData);
+        return NULL;
+    }
+    pstRW->close = _CloseInflated;
+    _RecordRead(pacPath, zSize, zSize);
+
+    return pstRW;
+}
+
+/**
+ * @brief   Parse an INI file.  Same as ini_parse(), only read through
+ *          the archive.
+ * @param   pstPack    a Pack or NULL.  See @ref struct Pack.
+ * @param   pacPath    the path of the INI file.
+ * @param   pfnHandler the inih handler.
+ * @param   pUser      passed to the handler.
+ * @return  see ini_parse().
+ * @ingroup Pack
+ */
+int32_t ParsePackIni(
+    Pack        *pstPack,
+    const char  *pacPath,
+    ini_handler  pfnHandler,
+    void        *pUser)
+{
+    PackReader  stReader;
+    const char *pacData;
+    size_t      zSize;
+    int32_t     s32Status;
+
+    pacData = LoadPackFile(pstPack, pacPath, &zSize);
+    if (NULL == pacData)
+    {
+        return -1;
+    }
+
+    stReader.pacCursor = pacData;
+    stReader.pacEnd    = pacData + zSize;
+
+    s32Status = ini_parse_stream(_ReadLine, &stReader, pfnHandler, pUser);
+    FreePackFile(pstPack, pacData);
+
+    return s32Status;
+}
+
+/**
+ * @brief   Get the size and modification time of a file, e.g. to tell
+ *          whether something derived from it is still up to date.
+ *          Files in the archive share the modification time of the
+ *          archive.
+ * @param   pstPack  a Pack or NULL.  See @ref struct Pack.
+ * @param   pacPath  the path of the file.
+ * @param   pu64Size returns the size of the file in bytes.
+ * @param   ps64Time returns the modification time of the file.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Pack
+ */
+int8_t StatPackFile(
+    Pack       *pstPack,
+    const char *pacPath,
+    uint64_t   *pu64Size,
+    int64_t    *ps64Time)
+{
+    const PackEntry *pstEntry = _FindEntry(pstPack, pacPath);
+    struct stat      stStat;
+
+    if (NULL != pstEntry)
+    {
+        *pu64Size = SDL_SwapLE32(pstEntry->u32Size);
+        *ps64Time = pstPack->s64ModifiedTime;
+        return 0;
+    }
+
+    if (0 != stat(pacPath, &stStat))
+    {
+        return -1;
+    }
+
+    *pu64Size = stStat.st_size;
+    *ps64Time = stStat.st_mtime;
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file    Pack.h
+ * @ingroup Pack
+ */
+
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "inih/ini.h"
+
+/**
+ * @ingroup Pack
+ */
+enum PackLimits
+{
+    PACK_ALIGNMENT       = 16,
+    PACK_MAX_PATH_LENGTH = 112,
+    PACK_MAX_READS       = 64,
+    PACK_VERSION         = 1
+};
+
+/**
+ * @ingroup Pack
+ */
+enum PackEntryFlags
+{
+    PACK_ENTRY_DEFLATED = 0
+};
+
+/**
+ * @brief   File header.  All integers are stored little-endian.
+ * @ingroup Pack
+ */
+typedef struct PackHeader_t
+{
+    char     acMagic[4];
+    uint32_t u32Version;
+    uint32_t u32EntryCount;
+    uint32_t u32Reserved;
+} PackHeader;
+
+/**
+ * @brief   Index entry.  The index directly follows the header and is
+ *          sorted by path.  Each blob starts at a multiple of
+ *          PACK_ALIGNMENT; u32StoredSize differs from u32Size only if
+ *          the blob is deflated.
+ * @ingroup Pack
+ */
+typedef struct PackEntry_t
+{
+    char     acPath[PACK_MAX_PATH_LENGTH];
+    uint32_t u32Offset;
+    uint32_t u32Size;
+    uint32_t u32StoredSize;
+    uint32_t u32Flags;
+} PackEntry;
+
+/**
+ * @brief   A mounted archive.  Read-only once mounted, so it can be
+ *          used from any thread.
+ * @ingroup Pack
+ */
+typedef struct Pack_t
+{
+    const uint8_t   *pu8Data;
+    const PackEntry *pstEntries;
+    size_t           zSize;
+    int64_t          s64ModifiedTime;
+    uint32_t         u32EntryCount;
+    uint8_t          u8IsMapped;
+} Pack;
+
+/**
+ * @brief   A file read through LoadPackFile() or OpenPackFile().
+ *          u64Copied counts the bytes which had to be allocated for
+ *          it, i.e. for inflated files and for files read from the
+ *          file system by LoadPackFile(); files read in place cost
+ *          none.
+ * @ingroup Pack
+ */
+typedef struct PackRead_t
+{
+    char     acPath[PACK_MAX_PATH_LENGTH];
+    uint64_t u64Bytes;
+    uint64_t u64Copied;
+    uint32_t u32Count;
+} PackRead;
+
+void FreePack(Pack *pstPack);
+
+void FreePackFile(Pack *pstPack, const void *pData);
+
+uint16_t GetPackReads(PackRead *pstReads, uint16_t u16MaxReads);
+
+Pack *InitPack(const char *pacFilename);
+
+const void *LoadPackFile(Pack *pstPack, const char *pacPath, size_t *pzSize);
+
+SDL_RWops *OpenPackFile(Pack *pstPack, const char *pacPath);
+
+int32_t ParsePackIni(
+    Pack        *pstPack,
+    const char  *pacPath,
+    ini_handler  pfnHandler,
+    void        *pUser);
+
+int8_t StatPackFile(
+    Pack       *pstPack,
+    const char *pacPath,
+    uint64_t   *pu64Size,
+    int64_t    *ps64Time);
+
+#endif
@@ -0,0 +1,506 @@
+/**
+ * @file      RenderQueue.c
+ * @ingroup   RenderQueue
+ * @defgroup  RenderQueue
+ * @brief     Frame render queue.  Map, Background and Entity push
+ *            textured quads instead of drawing them right away.  Once
+ *            per frame the quads are sorted by layer, blend mode and
+ *            texture, and each run of quads sharing a texture is drawn
+ *            with one call to SDL_RenderGeometry().
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Log.h"
+#include "Memory.h"
+#include "RenderQueue.h"
+
+static int8_t _Reserve(RenderQueue *pstQueue, uint32_t u32Commands)
+{
+    RenderCommand *pstCommands;
+    SDL_Vertex    *pstVertices;
+    int32_t       *ps32Indices;
+
+    if (u32Commands <= pstQueue->u32CommandCapacity)
+    {
+        return 0;
+    }
+
+    if (u32Commands > RENDER_QUEUE_MAX_COMMANDS)
+    {
+        LOG_ERROR("PushRenderQuad(): too many commands.");
+        return -1;
+    }
+
+    u32Commands = SDL_min(RENDER_QUEUE_MAX_COMMANDS, SDL_max(u32Commands, 2 * pstQueue->u32CommandCapacity));
+
+    pstCommands = ReallocMemory(MEMORY_TAG_RENDERER, pstQueue->pstCommands, u32Commands * sizeof(struct RenderCommand_t));
+    if (NULL == pstCommands)
+    {
+        goto error;
+    }
+    pstQueue->pstCommands = pstCommands;
+
+    pstCommands = ReallocMemory(MEMORY_TAG_RENDERER, pstQueue->pstSorted, u32Commands * sizeof(struct RenderCommand_t));
+    if (NULL == pstCommands)
+    {
+        goto error;
+    }
+    pstQueue->pstSorted = pstCommands;
+
+    pstVertices = ReallocMemory(MEMORY_TAG_RENDERER, pstQueue->pstVertices, u32Commands * 4 * sizeof(SDL_Vertex));
+    if (NULL == pstVertices)
+    {
+        goto error;
+    }
+    pstQueue->pstVertices = pstVertices;
+
+    pstVertices = ReallocMemory(MEMORY_TAG_RENDERER, pstQueue->pstBatch, u32Commands * 4 * sizeof(SDL_Vertex));
+    if (NULL == pstVertices)
+    {
+        goto error;
+    }
+    pstQueue->pstBatch = pstVertices;
+
+    ps32Indices = ReallocMemory(MEMORY_TAG_RENDERER, pstQueue->ps32Indices, u32Commands * 6 * sizeof(int32_t));
+    if (NULL == ps32Indices)
+    {
+        goto error;
+    }
+    pstQueue->ps32Indices = ps32Indices;
+
+    // Every batch is a list of quads, so the indices never change.
+    for (uint32_t u32Quad = pstQueue->u32CommandCapacity; u32Quad < u32Commands; u32Quad++)
+    {
+        ps32Indices[u32Quad * 6 + 0] = u32Quad * 4 + 0;
+        ps32Indices[u32Quad * 6 + 1] = u32Quad * 4 + 1;
+        ps32Indices[u32Quad * 6 + 2] = u32Quad * 4 + 2;
+        ps32Indices[u32Quad * 6 + 3] = u32Quad * 4 + 2;
+        ps32Indices[u32Quad * 6 + 4] = u32Quad * 4 + 1;
+        ps32Indices[u32Quad * 6 + 5] = u32Quad * 4 + 3;
+    }
+    pstQueue->u32CommandCapacity = u32Commands;
+
+    return 0;
+
+error:
+    LOG_ERROR("PushRenderQuad(): error allocating memory.");
+    return -1;
+}
+
+/* Map a texture to a small id which is valid for the current frame.
+ * Slots from previous frames are recognised by their generation, so
+ * the table never has to be cleared. */
+static int32_t _GetTextureId(RenderQueue *pstQueue, SDL_Texture *pstTexture)
+{
+    uint32_t u32Slot = (uint32_t)(((uintptr_t)pstTexture >> 4) * 2654435761u);
+
+    for (uint32_t u32Probe = 0; u32Probe < RENDER_QUEUE_TEXTURE_SLOTS; u32Probe++)
+    {
+        RenderTextureSlot *pstSlot = &pstQueue->pstTextureSlots[
+            (u32Slot + u32Probe) & (RENDER_QUEUE_TEXTURE_SLOTS - 1)];
+
+        if (pstSlot->u32Generation != pstQueue->u32Generation)
+        {
+            if (RENDER_QUEUE_MAX_TEXTURES == pstQueue->u16TextureCount)
+            {
+                break;
+            }
+
+            pstSlot->pstTexture    = pstTexture;
+            pstSlot->u32Generation = pstQueue->u32Generation;
+            pstSlot->u16Id         = pstQueue->u16TextureCount;
+            pstQueue->u16TextureCount++;
+            return pstSlot->u16Id;
+        }
+
+        if (pstSlot->pstTexture == pstTexture)
+        {
+            return pstSlot->u16Id;
+        }
+    }
+
+    LOG_ERROR("PushRenderQuad(): too many textures.");
+    return -1;
+}
+
+static uint32_t _GetBlendModeKey(SDL_BlendMode eBlendMode)
+{
+    switch (eBlendMode)
+    {
+        case SDL_BLENDMODE_NONE:
+            return 0;
+        case SDL_BLENDMODE_BLEND:
+            return 1;
+        case SDL_BLENDMODE_ADD:
+            return 2;
+        default:
+            return 3;
+    }
+}
+
+static RenderCommand *_PushCommand(
+    RenderQueue   *pstQueue,
+    uint16_t       u16Layer,
+    SDL_Texture   *pstTexture,
+    SDL_BlendMode  eBlendMode)
+{
+    RenderCommand *pstCommand;
+    int32_t        s32TextureId;
+
+    if (-1 == _Reserve(pstQueue, pstQueue->u32CommandCount + 1))
+    {
+        return NULL;
+    }
+
+    s32TextureId = _GetTextureId(pstQueue, pstTexture);
+    if (-1 == s32TextureId)
+    {
+        return NULL;
+    }
+
+    pstCommand             = &pstQueue->pstCommands[pstQueue->u32CommandCount];
+    pstCommand->pstTexture = pstTexture;
+    pstCommand->eBlendMode = eBlendMode;
+    pstCommand->u32Vertex  = pstQueue->u32CommandCount * 4;
+    pstCommand->u32Key     =
+        ((uint32_t)u16Layer           << 16) |
+        (_GetBlendModeKey(eBlendMode) << 14) |
+        (uint32_t)s32TextureId;
+
+    pstQueue->u32CommandCount++;
+
+    return pstCommand;
+}
+
+/* LSD radix sort over the 32 bits of the key, one byte per pass.  The
+ * sort is stable, so equal keys stay in submission order.  Passes in
+ * which all keys share the same byte are skipped; with few layers and
+ * textures most of them are. */
+static void _Sort(RenderQueue *pstQueue)
+{
+    RenderCommand *pstSource = pstQueue->pstCommands;
+    RenderCommand *pstTarget = pstQueue->pstSorted;
+    uint32_t       au32Count[256];
+
+    for (uint8_t u8Shift = 0; u8Shift < 32; u8Shift += 8)
+    {
+        uint32_t u32Offset   = 0;
+        uint8_t  u8IsTrivial = 0;
+
+        memset(au32Count, 0, sizeof(au32Count));
+        for (uint32_t u32Index = 0; u32Index < pstQueue->u32CommandCount; u32Index++)
+        {
+            au32Count[(pstSource[u32Index].u32Key >> u8Shift) & 0xFF]++;
+        }
+
+        for (uint16_t u16Digit = 0; u16Digit < 256; u16Digit++)
+        {
+            uint32_t u32Count = au32Count[u16Digit];
+
+            if (u32Count == pstQueue->u32CommandCount)
+            {
+                u8IsTrivial = 1;
+                break;
+            }
+            au32Count[u16Digit] = u32Offset;
+            u32Offset          += u32Count;
+        }
+
+        if (u8IsTrivial)
+        {
+            continue;
+        }
+
+        for (uint32_t u32Index = 0; u32Index < pstQueue->u32CommandCount; u32Index++)
+        {
+            uint8_t u8Digit = (pstSource[u32Index].u32Key >> u8Shift) & 0xFF;
+            pstTarget[au32Count[u8Digit]] = pstSource[u32Index];
+            au32Count[u8Digit]++;
+        }
+
+        pstQueue->pstCommands = pstTarget;
+        pstQueue->pstSorted   = pstSource;
+        pstSource             = pstTarget;
+        pstTarget             = pstQueue->pstSorted;
+    }
+}
+
+static int8_t _DrawBatch(
+    SDL_Renderer        *pstRenderer,
+    RenderQueue         *pstQueue,
+    const RenderCommand *pstCommand,
+    uint32_t             u32QuadCount)
+{
+    if ((NULL != pstCommand->pstTexture) &&
+        (0 != SDL_SetTextureBlendMode(pstCommand->pstTexture, pstCommand->eBlendMode)))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    if (0 != SDL_RenderGeometry(
+            pstRenderer,
+            pstCommand->pstTexture,
+            pstQueue->pstBatch,
+            u32QuadCount * 4,
+            pstQueue->ps32Indices,
+            u32QuadCount * 6))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    pstQueue->stStats.u32Batches++;
+
+    return 0;
+}
+
+/**
+ * @brief   Draw all quads pushed since the last call and empty the
+ *          queue.  This function has to be called once per frame
+ *          before UpdateVideo().
+ * @param   pstRenderer a SDL rendering context.  See @ref struct Video.
+ * @param   pstQueue    a RenderQueue.  See @ref struct RenderQueue.
+ * @return  0 on success, -1 on failure.
+ * @ingroup RenderQueue
+ */
+int8_t DrawRenderQueue(SDL_Renderer *pstRenderer, RenderQueue *pstQueue)
+{
+    const RenderCommand *pstFirst     = NULL;
+    uint32_t             u32QuadCount = 0;
+    int8_t               s8Result     = 0;
+
+    pstQueue->stStats.u32Commands = pstQueue->u32CommandCount;
+    pstQueue->stStats.u32Batches  = 0;
+
+    _Sort(pstQueue);
+
+    for (uint32_t u32Index = 0; u32Index < pstQueue->u32CommandCount; u32Index++)
+    {
+        const RenderCommand *pstCommand = &pstQueue->pstCommands[u32Index];
+
+        if ((NULL != pstFirst) &&
+            ((pstCommand->pstTexture != pstFirst->pstTexture) ||
+             (pstCommand->eBlendMode != pstFirst->eBlendMode)))
+        {
+            if (-1 == _DrawBatch(pstRenderer, pstQueue, pstFirst, u32QuadCount))
+            {
+                s8Result = -1;
+            }
+            u32QuadCount = 0;
+        }
+
+        if (0 == u32QuadCount)
+        {
+            pstFirst = pstCommand;
+        }
+
+        memcpy(
+            &pstQueue->pstBatch[u32QuadCount * 4],
+            &pstQueue->pstVertices[pstCommand->u32Vertex],
+            4 * sizeof(SDL_Vertex));
+        u32QuadCount++;
+    }
+
+    if ((u32QuadCount > 0) && (-1 == _DrawBatch(pstRenderer, pstQueue, pstFirst, u32QuadCount)))
+    {
+        s8Result = -1;
+    }
+
+    pstQueue->u32CommandCount = 0;
+    pstQueue->u16TextureCount = 0;
+    pstQueue->u32Generation++;
+
+    return s8Result;
+}
+
+/**
+ * @brief   Free RenderQueue from memory.
+ * @param   pstQueue a RenderQueue.  See @ref struct RenderQueue.
+ * @ingroup RenderQueue
+ */
+void FreeRenderQueue(RenderQueue *pstQueue)
+{
+    if (NULL == pstQueue)
+    {
+        return;
+    }
+
+    FreeMemory(pstQueue->pstCommands);
+    FreeMemory(pstQueue->pstSorted);
+    FreeMemory(pstQueue->pstVertices);
+    FreeMemory(pstQueue->pstBatch);
+    FreeMemory(pstQueue->ps32Indices);
+    FreeMemory(pstQueue->pstTextureSlots);
+    FreeMemory(pstQueue);
+}
+
+/**
+ * @brief   Initialise RenderQueue.
+ * @return  a RenderQueue on success, NULL on failure.
+ * @ingroup RenderQueue
+ */
+RenderQueue *InitRenderQueue(void)
+{
+    static RenderQueue *pstQueue;
+    pstQueue = AllocMemory(MEMORY_TAG_RENDERER, sizeof(struct RenderQueue_t));
+    if (NULL == pstQueue)
+    {
+        LOG_ERROR("InitRenderQueue(): error allocating memory.");
+        return NULL;
+    }
+
+    pstQueue->pstCommands         = NULL;
+    pstQueue->pstSorted           = NULL;
+    pstQueue->pstVertices         = NULL;
+    pstQueue->pstBatch            = NULL;
+    pstQueue->ps32Indices         = NULL;
+    pstQueue->stStats.u32Commands = 0;
+    pstQueue->stStats.u32Batches  = 0;
+    pstQueue->u32CommandCount     = 0;
+    pstQueue->u32CommandCapacity  = 0;
+    pstQueue->u32Generation       = 1;
+    pstQueue->u16TextureCount     = 0;
+
+    // Generation 0 marks a slot as unused.
+    pstQueue->pstTextureSlots = AllocZeroedMemory(MEMORY_TAG_RENDERER, RENDER_QUEUE_TEXTURE_SLOTS, sizeof(struct RenderTextureSlot_t));
+    if (NULL == pstQueue->pstTextureSlots)
+    {
+        LOG_ERROR("InitRenderQueue(): error allocating memory.");
+        FreeMemory(pstQueue);
+        return NULL;
+    }
+
+    if (-1 == _Reserve(pstQueue, 256))
+    {
+        FreeRenderQueue(pstQueue);
+        return NULL;
+    }
+
+    return pstQueue;
+}
+
+/**
+ * @brief   Push a textured quad.
+ * @param   pstQueue   a RenderQueue.  See @ref struct RenderQueue.
+ * @param   u16Layer   the layer.  See @ref enum RenderLayer.
+ * @param   pstTexture the texture.
+ * @param   eBlendMode the blend mode the texture is drawn with.
+ * @param   pstDst     the destination rectangle.
+ * @param   pstUV      the normalised texture coordinates.
+ * @param   eFlip      flip the texture coordinates horizontally and/or
+ *                     vertically.
+ * @return  0 on success, -1 on failure.
+ * @ingroup RenderQueue
+ */
+int8_t PushRenderQuad(
+    RenderQueue      *pstQueue,
+    uint16_t          u16Layer,
+    SDL_Texture      *pstTexture,
+    SDL_BlendMode     eBlendMode,
+    const SDL_FRect  *pstDst,
+    const SDL_FRect  *pstUV,
+    SDL_RendererFlip  eFlip)
+{
+    RenderCommand *pstCommand;
+
+    pstCommand = _PushCommand(pstQueue, u16Layer, pstTexture, eBlendMode);
+    if (NULL == pstCommand)
+    {
+        return -1;
+    }
+
+    SetRenderQuadVertices(&pstQueue->pstVertices[pstCommand->u32Vertex], pstDst, pstUV, eFlip);
+
+    return 0;
+}
+
+/**
+ * @brief   Push a list of quads which share a texture.  Each quad
+ *          consists of four vertices: top left, top right, bottom left
+ *          and bottom right.
+ * @param   pstQueue     a RenderQueue.  See @ref struct RenderQueue.
+ * @param   u16Layer     the layer.  See @ref enum RenderLayer.
+ * @param   pstTexture   the texture.
+ * @param   eBlendMode   the blend mode the texture is drawn with.
+ * @param   pstVertices  the vertices.
+ * @param   u32QuadCount the number of quads.
+ * @return  0 on success, -1 on failure.
+ * @ingroup RenderQueue
+ */
+int8_t PushRenderQuads(
+    RenderQueue      *pstQueue,
+    uint16_t          u16Layer,
+    SDL_Texture      *pstTexture,
+    SDL_BlendMode     eBlendMode,
+    const SDL_Vertex *pstVertices,
+    uint32_t          u32QuadCount)
+{
+    for (uint32_t u32Quad = 0; u32Quad < u32QuadCount; u32Quad++)
+    {
+        RenderCommand *pstCommand = _PushCommand(pstQueue, u16Layer, pstTexture, eBlendMode);
+        if (NULL == pstCommand)
+        {
+            return -1;
+        }
+
+        memcpy(
+            &pstQueue->pstVertices[pstCommand->u32Vertex],
+            &pstVertices[u32Quad * 4],
+            4 * sizeof(SDL_Vertex));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Set up the four vertices of a quad in the order expected by
+ *          PushRenderQuads(): top left, top right, bottom left and
+ *          bottom right.
+ * @param   pstVertices the four vertices.
+ * @param   pstDst      the destination rectangle.
+ * @param   pstUV       the normalised texture coordinates.
+ * @param   eFlip       flip the texture coordinates horizontally and/or
+ *                      vertically.
+ * @ingroup RenderQueue
+ */
+void SetRenderQuadVertices(
+    SDL_Vertex       *pstVertices,
+    const SDL_FRect  *pstDst,
+    const SDL_FRect  *pstUV,
+    SDL_RendererFlip  eFlip)
+{
+    const SDL_Color stWhite = { 255, 255, 255, 255 };
+    SDL_FRect       stUV    = *pstUV;
+
+    // Flipping is just swapping the texture coordinates.
+    if (eFlip & SDL_FLIP_HORIZONTAL)
+    {
+        stUV.x += stUV.w;
+        stUV.w  = -stUV.w;
+    }
+
+    if (eFlip & SDL_FLIP_VERTICAL)
+    {
+        stUV.y += stUV.h;
+        stUV.h  = -stUV.h;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < 4; u8Index++)
+    {
+        uint8_t u8Right  = u8Index & 1;
+        uint8_t u8Bottom = u8Index >> 1;
+
+        pstVertices[u8Index].position.x  = pstDst->x + u8Right  * pstDst->w;
+        pstVertices[u8Index].position.y  = pstDst->y + u8Bottom * pstDst->h;
+        pstVertices[u8Index].color       = stWhite;
+        pstVertices[u8Index].tex_coord.x = stUV.x + u8Right  * stUV.w;
+        pstVertices[u8Index].tex_coord.y = stUV.y + u8Bottom * stUV.h;
+    }
+}
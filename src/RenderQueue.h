@@ -0,0 +1,117 @@
+/**
+ * @file    RenderQueue.h
+ * @ingroup RenderQueue
+ */
+
+#ifndef _RENDERQUEUE_H_
+#define _RENDERQUEUE_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+
+/**
+ * @brief   Distance between the base layers of two scene layers.  Each
+ *          subsystem adds its own index to the base layer, e.g. the
+ *          index of a background layer.  See @ref struct Scene.
+ * @ingroup RenderQueue
+ */
+enum RenderLayer
+{
+    RENDER_LAYER_STEP = 0x100
+};
+
+/**
+ * @ingroup RenderQueue
+ */
+enum RenderQueueLimits
+{
+    RENDER_QUEUE_MAX_TEXTURES  = 0x4000,
+    RENDER_QUEUE_MAX_COMMANDS  = 0x1000000,
+    RENDER_QUEUE_TEXTURE_SLOTS = 2 * RENDER_QUEUE_MAX_TEXTURES
+};
+
+/**
+ * @brief   A textured quad.  The sort key holds, from the most to the
+ *          least significant bits: layer (16), blend mode (2) and
+ *          texture id (14).  Within a layer, quads are therefore
+ *          grouped by blend mode and texture; the sort is stable, so
+ *          quads of the same texture keep their submission order.
+ *          Quads which have to be drawn in submission order regardless
+ *          of their texture belong on layers of their own.
+ * @ingroup RenderQueue
+ */
+typedef struct RenderCommand_t
+{
+    uint32_t       u32Key;
+    SDL_Texture   *pstTexture;
+    SDL_BlendMode  eBlendMode;
+    uint32_t       u32Vertex;
+} RenderCommand;
+
+/**
+ * @ingroup RenderQueue
+ */
+typedef struct RenderTextureSlot_t
+{
+    SDL_Texture *pstTexture;
+    uint32_t     u32Generation;
+    uint16_t     u16Id;
+} RenderTextureSlot;
+
+/**
+ * @ingroup RenderQueue
+ */
+typedef struct RenderQueueStats_t
+{
+    uint32_t u32Commands;
+    uint32_t u32Batches;
+} RenderQueueStats;
+
+/**
+ * @ingroup RenderQueue
+ */
+typedef struct RenderQueue_t
+{
+    RenderCommand     *pstCommands;
+    RenderCommand     *pstSorted;
+    SDL_Vertex        *pstVertices;
+    SDL_Vertex        *pstBatch;
+    int32_t           *ps32Indices;
+    RenderTextureSlot *pstTextureSlots;
+    RenderQueueStats   stStats;
+    uint32_t           u32CommandCount;
+    uint32_t           u32CommandCapacity;
+    uint32_t           u32Generation;
+    uint16_t           u16TextureCount;
+} RenderQueue;
+
+int8_t DrawRenderQueue(SDL_Renderer *pstRenderer, RenderQueue *pstQueue);
+
+void FreeRenderQueue(RenderQueue *pstQueue);
+
+RenderQueue *InitRenderQueue(void);
+
+int8_t PushRenderQuad(
+    RenderQueue      *pstQueue,
+    uint16_t          u16Layer,
+    SDL_Texture      *pstTexture,
+    SDL_BlendMode     eBlendMode,
+    const SDL_FRect  *pstDst,
+    const SDL_FRect  *pstUV,
+    SDL_RendererFlip  eFlip);
+
+int8_t PushRenderQuads(
+    RenderQueue      *pstQueue,
+    uint16_t          u16Layer,
+    SDL_Texture      *pstTexture,
+    SDL_BlendMode     eBlendMode,
+    const SDL_Vertex *pstVertices,
+    uint32_t          u32QuadCount);
+
+void SetRenderQuadVertices(
+    SDL_Vertex       *pstVertices,
+    const SDL_FRect  *pstDst,
+    const SDL_FRect  *pstUV,
+    SDL_RendererFlip  eFlip);
+
+#endif
@@ -0,0 +1,482 @@
+/**
+ * @file      Scene.c
+ * @ingroup   Scene
+ * @defgroup  Scene
+ * @brief     Scene composition.  The draw order of the parallax
+ *            background, the tile layers of the map and the entities
+ *            is read once from the map property "scene", e.g.
+ *            "parallax;tiles:Background;entities:0;tiles:World".
+ *            Entities are assigned to the bucket of their depth.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "AABB.h"
+#include "Background.h"
+#include "Camera.h"
+#include "Entity.h"
+#include "Job.h"
+#include "Log.h"
+#include "Map.h"
+#include "Memory.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "SpriteBatch.h"
+#include "tmx/tmx.h"
+
+#define SCENE_DEFAULT "parallax;tiles:Background;entities:0;tiles:World;tiles:Foreground"
+
+static uint8_t _GetActivity(
+    const Scene  *pstScene,
+    const Entity *pstEntity,
+    const Camera *pstCamera)
+{
+    AABB stBox;
+    AABB stNear = pstCamera->stVisible;
+
+    stBox.dLeft   = pstEntity->dWorldPosX;
+    stBox.dTop    = pstEntity->dWorldPosY;
+    stBox.dRight  = pstEntity->dWorldPosX + pstEntity->u8Width;
+    stBox.dBottom = pstEntity->dWorldPosY + pstEntity->u8Height;
+
+    if (IsCameraVisible(pstCamera, stBox))
+    {
+        return ENTITY_ACTIVITY_VISIBLE;
+    }
+
+    stNear.dLeft   -= pstScene->dNearMargin;
+    stNear.dTop    -= pstScene->dNearMargin;
+    stNear.dRight  += pstScene->dNearMargin;
+    stNear.dBottom += pstScene->dNearMargin;
+
+    if (AreIntersecting(stNear, stBox))
+    {
+        return ENTITY_ACTIVITY_NEAR;
+    }
+
+    return ENTITY_ACTIVITY_DORMANT;
+}
+
+static int8_t _AddLayer(
+    Scene      *pstScene,
+    const Map  *pstMap,
+    const char *pacToken)
+{
+    SceneLayer *pstLayer;
+    const char *pacArg   = strchr(pacToken, ':');
+    size_t      sTypeLen = pacArg ? (size_t)(pacArg - pacToken) : strlen(pacToken);
+    uint8_t     u8Tiles  = 0;
+
+    if (pstScene->u8LayerCount >= SCENE_MAX_LAYERS)
+    {
+        LOG_ERROR("InitScene(): too many layers.");
+        return -1;
+    }
+
+    pstLayer = &pstScene->astLayers[pstScene->u8LayerCount];
+    memset(pstLayer, 0, sizeof(struct SceneLayer_t));
+
+    // Every scene layer gets a range of its own in the RenderQueue.
+    pstLayer->u16RenderLayer = pstScene->u8LayerCount * RENDER_LAYER_STEP;
+
+    for (uint8_t u8Index = 0; u8Index < pstScene->u8LayerCount; u8Index++)
+    {
+        if (SCENE_LAYER_TILES == pstScene->astLayers[u8Index].u8Type)
+        {
+            u8Tiles++;
+        }
+    }
+
+    if (pacArg)
+    {
+        pacArg++;
+    }
+
+    #define MATCH(pacT) (strlen(pacT) == sTypeLen && 0 == strncmp(pacToken, pacT, sTypeLen))
+    if (MATCH("parallax"))
+    {
+        pstLayer->u8Type = SCENE_LAYER_PARALLAX;
+    }
+    else if (MATCH("tiles") && pacArg)
+    {
+        if (u8Tiles >= MAP_MAX_LAYERS)
+        {
+            LOG_ERROR("InitScene(): too many tile layers.");
+            return -1;
+        }
+
+        if ((strlen(pacArg) >= SCENE_MAX_NAME_LENGTH) || (! HasMapLayer(pstMap, pacArg)))
+        {
+            LOG_ERROR("InitScene(): unknown map layer '%s'.", pacArg);
+            return -1;
+        }
+
+        pstLayer->u8Type     = SCENE_LAYER_TILES;
+        pstLayer->u8MapIndex = u8Tiles;
+        // The first tile layer sets the colour the frame is cleared with.
+        pstLayer->u8RenderBgColour = (0 == u8Tiles) ? 1 : 0;
+        memcpy(pstLayer->acName, pacArg, strlen(pacArg) + 1);
+    }
+    else if (MATCH("entities") && pacArg)
+    {
+        char *pacEnd;
+        long  lDepth = strtol(pacArg, &pacEnd, 10);
+
+        if ((pacEnd == pacArg) || ('\0' != *pacEnd) || (lDepth < 0) || (lDepth > UINT8_MAX))
+        {
+            LOG_ERROR("InitScene(): invalid depth '%s'.", pacArg);
+            return -1;
+        }
+
+        pstLayer->u8Type  = SCENE_LAYER_ENTITIES;
+        pstLayer->u8Depth = (uint8_t)lDepth;
+    }
+    else
+    {
+        LOG_ERROR("InitScene(): invalid layer '%s'.", pacToken);
+        return -1;
+    }
+    #undef MATCH
+
+    pstScene->u8LayerCount++;
+    return 0;
+}
+
+static void _UpdateEntities(void *pData, uint32_t u32Begin, uint32_t u32End)
+{
+    Scene *pstScene = (Scene *)pData;
+
+    for (uint32_t u32Index = u32Begin; u32Index < u32End; u32Index++)
+    {
+        UpdateEntity(pstScene->pstEntities[u32Index].pstEntity, pstScene->dDeltaTime);
+    }
+}
+
+/**
+ * @brief   Add Entity to a depth bucket of the Scene.  Entities of the
+ *          same depth are batched per sprite sheet: the sheets are drawn
+ *          in the order they are first used in the frame, entities
+ *          sharing a sheet in the order they have been added.  Entities
+ *          which have to overlap in a fixed order belong to different
+ *          depths.
+ * @param   pstScene  a Scene.  See @ref struct Scene.
+ * @param   pstEntity an Entity.  See @ref struct Entity.
+ * @param   u8Depth   the depth of an entity layer of the Scene.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Scene
+ */
+int8_t AddSceneEntity(
+    Scene   *pstScene,
+    Entity  *pstEntity,
+    uint8_t  u8Depth)
+{
+    uint8_t u8HasBucket = 0;
+
+    for (uint8_t u8Index = 0; u8Index < pstScene->u8LayerCount; u8Index++)
+    {
+        if ((SCENE_LAYER_ENTITIES == pstScene->astLayers[u8Index].u8Type) &&
+            (u8Depth == pstScene->astLayers[u8Index].u8Depth))
+        {
+            u8HasBucket = 1;
+            break;
+        }
+    }
+
+    if (! u8HasBucket)
+    {
+        LOG_ERROR("AddSceneEntity(): no entity layer of depth %u.", u8Depth);
+        return -1;
+    }
+
+    if (UINT16_MAX == pstScene->u16EntityCount)
+    {
+        LOG_ERROR("AddSceneEntity(): too many entities.");
+        return -1;
+    }
+
+    if (pstScene->u16EntityCount >= pstScene->u16EntityCapacity)
+    {
+        uint32_t     u32Capacity = pstScene->u16EntityCapacity ? pstScene->u16EntityCapacity * 2u : 8;
+        SceneEntity *pstEntities;
+
+        // The count is 16 bits wide, so is the capacity.
+        u32Capacity = SDL_min(u32Capacity, UINT16_MAX);
+        pstEntities = ReallocMemory(
+            MEMORY_TAG_SCENE,
+            pstScene->pstEntities,
+            u32Capacity * sizeof(struct SceneEntity_t));
+
+        if (NULL == pstEntities)
+        {
+            LOG_ERROR("AddSceneEntity(): error allocating memory.");
+            return -1;
+        }
+        pstScene->pstEntities       = pstEntities;
+        pstScene->u16EntityCapacity = u32Capacity;
+    }
+
+    pstScene->pstEntities[pstScene->u16EntityCount].pstEntity = pstEntity;
+    pstScene->pstEntities[pstScene->u16EntityCount].u8Depth   = u8Depth;
+    pstScene->u16EntityCount++;
+
+    return 0;
+}
+
+/**
+ * @brief   Draw Scene.  All layers are pushed to the RenderQueue from
+ *          back to front; the queue still has to be drawn afterwards.
+ * @param   pstRenderer     a SDL rendering context.  See @ref struct Video.
+ * @param   pstQueue        the RenderQueue.  See @ref struct RenderQueue.
+ * @param   pstScene        the Scene to draw.  See @ref struct Scene.
+ * @param   pstBackground   the parallax Background.  See @ref struct Background.
+ * @param   pstMap          the Map.  See @ref struct Map.
+ * @param   pstEntityStates copies of the entities in the order they have
+ *                          been added, e.g. of a snapshot, or NULL to
+ *                          draw the entities themselves.
+ * @param   pstCamera       the Camera.  See @ref struct Camera.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Scene
+ */
+int8_t DrawScene(
+    SDL_Renderer *pstRenderer,
+    RenderQueue  *pstQueue,
+    Scene        *pstScene,
+    Background   *pstBackground,
+    Map          *pstMap,
+    const Entity *pstEntityStates,
+    const Camera *pstCamera)
+{
+    int8_t s8Result = 0;
+
+    // Tiles drawn behind the parallax layer must not hide it.
+    if (-1 == SetMapOccluders(pstMap, pstScene->u8MapOccluders))
+    {
+        return -1;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < pstScene->u8LayerCount; u8Index++)
+    {
+        const SceneLayer *pstLayer = &pstScene->astLayers[u8Index];
+
+        switch (pstLayer->u8Type)
+        {
+            case SCENE_LAYER_PARALLAX:
+                s8Result = DrawBackground(
+                    pstRenderer,
+                    pstQueue,
+                    pstBackground,
+                    pstMap,
+                    pstLayer->u16RenderLayer);
+                break;
+            case SCENE_LAYER_TILES:
+                s8Result = DrawMap(
+                    pstRenderer,
+                    pstQueue,
+                    pstMap,
+                    pstLayer->acName,
+                    pstLayer->u8RenderBgColour,
+                    pstLayer->u8MapIndex,
+                    pstLayer->u16RenderLayer,
+                    pstCamera);
+                break;
+            case SCENE_LAYER_ENTITIES:
+                for (uint16_t u16Index = 0; u16Index < pstScene->u16EntityCount; u16Index++)
+                {
+                    const Entity *pstEntity = pstScene->pstEntities[u16Index].pstEntity;
+
+                    if (pstLayer->u8Depth != pstScene->pstEntities[u16Index].u8Depth)
+                    {
+                        continue;
+                    }
+
+                    if (NULL != pstEntityStates)
+                    {
+                        pstEntity = &pstEntityStates[u16Index];
+                    }
+
+                    s8Result = DrawEntity(pstScene->pstSprites, pstEntity, pstCamera);
+                    if (-1 == s8Result)
+                    {
+                        break;
+                    }
+                }
+
+                // Always flush, so no sprite leaks into the next bucket.
+                if (-1 == DrawSpriteBatch(pstQueue, pstScene->pstSprites, pstLayer->u16RenderLayer))
+                {
+                    s8Result = -1;
+                }
+                break;
+        }
+
+        if (-1 == s8Result)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Free Scene from memory.  The entities are not freed.
+ * @param   pstScene a Scene.  See @ref struct Scene.
+ * @ingroup Scene
+ */
+void FreeScene(Scene *pstScene)
+{
+    if (NULL == pstScene)
+    {
+        return;
+    }
+
+    FreeSpriteBatch(pstScene->pstSprites);
+    FreeMemory(pstScene->pstEntities);
+    FreeMemory(pstScene);
+}
+
+/**
+ * @brief   Initialise Scene from the map property "scene", a list of
+ *          layers separated by semicolons.  A layer is either
+ *          "parallax", "tiles:<map layer>" or "entities:<depth>".  Maps
+ *          without the property use the default jungle order.
+ * @param   pstMap the Map.  See @ref struct Map.
+ * @return  a Scene on success, NULL on failure.
+ * @ingroup Scene
+ */
+Scene *InitScene(const Map *pstMap)
+{
+    tmx_property *pstProperty;
+    const char   *pacScene = SCENE_DEFAULT;
+    char         *pacCopy;
+    char         *pacToken;
+
+    static Scene *pstScene;
+    pstScene = AllocZeroedMemory(MEMORY_TAG_SCENE, 1, sizeof(struct Scene_t));
+    if (NULL == pstScene)
+    {
+        LOG_ERROR("InitScene(): error allocating memory.");
+        return NULL;
+    }
+
+    pstScene->dNearMargin = 256;
+
+    pstScene->pstSprites = InitSpriteBatch();
+    if (NULL == pstScene->pstSprites)
+    {
+        FreeScene(pstScene);
+        return NULL;
+    }
+
+    pstProperty = tmx_get_property(pstMap->pstTmxMap->properties, "scene");
+    if ((NULL != pstProperty) && (PT_STRING == pstProperty->type))
+    {
+        pacScene = pstProperty->value.string;
+    }
+
+    pacCopy = AllocMemory(MEMORY_TAG_SCENE, strlen(pacScene) + 1);
+    if (NULL == pacCopy)
+    {
+        LOG_ERROR("InitScene(): error allocating memory.");
+        FreeScene(pstScene);
+        return NULL;
+    }
+    memcpy(pacCopy, pacScene, strlen(pacScene) + 1);
+
+    pacToken = strtok(pacCopy, ";");
+    while (pacToken)
+    {
+        if (-1 == _AddLayer(pstScene, pstMap, pacToken))
+        {
+            FreeMemory(pacCopy);
+            FreeScene(pstScene);
+            return NULL;
+        }
+        pacToken = strtok(NULL, ";");
+    }
+    FreeMemory(pacCopy);
+
+    // Only tile layers after the last parallax layer cover it.
+    for (uint8_t u8Index = 0; u8Index < pstScene->u8LayerCount; u8Index++)
+    {
+        const SceneLayer *pstLayer = &pstScene->astLayers[u8Index];
+
+        if (SCENE_LAYER_PARALLAX == pstLayer->u8Type)
+        {
+            pstScene->u8MapOccluders = 0;
+        }
+        else if (SCENE_LAYER_TILES == pstLayer->u8Type)
+        {
+            pstScene->u8MapOccluders |= 1 << pstLayer->u8MapIndex;
+        }
+    }
+
+    return pstScene;
+}
+
+/**
+ * @brief   Update Scene.  Every Entity is assigned an activity tier
+ *          based on the visible area of the Camera and updated
+ *          accordingly, so the cost of a large world grows with what is
+ *          near the player.  This function has to be called every frame
+ *          instead of calling UpdateEntity() directly.  Entities do not
+ *          depend on each other, so with a JobSystem set they are
+ *          updated in parallel.
+ * @param   pstScene   a Scene.  See @ref struct Scene.
+ * @param   pstCamera  the Camera.  See @ref struct Camera.
+ * @param   dDeltaTime time since last frame in seconds.
+ * @ingroup Scene
+ */
+void UpdateScene(
+    Scene        *pstScene,
+    const Camera *pstCamera,
+    double        dDeltaTime)
+{
+    pstScene->stStats.u16Visible = 0;
+    pstScene->stStats.u16Near    = 0;
+    pstScene->stStats.u16Dormant = 0;
+    pstScene->dDeltaTime         = dDeltaTime;
+
+    for (uint16_t u16Index = 0; u16Index < pstScene->u16EntityCount; u16Index++)
+    {
+        Entity *pstEntity = pstScene->pstEntities[u16Index].pstEntity;
+
+        pstEntity->u8Activity = _GetActivity(pstScene, pstEntity, pstCamera);
+        switch (pstEntity->u8Activity)
+        {
+            case ENTITY_ACTIVITY_VISIBLE:
+                pstScene->stStats.u16Visible++;
+                break;
+            case ENTITY_ACTIVITY_NEAR:
+                pstScene->stStats.u16Near++;
+                break;
+            default:
+                pstScene->stStats.u16Dormant++;
+                break;
+        }
+    }
+
+    if (NULL == pstScene->pstJobs)
+    {
+        _UpdateEntities(pstScene, 0, pstScene->u16EntityCount);
+    }
+    else
+    {
+        JobCounter stCounter = { { 0 } };
+
+        RunParallelFor(
+            pstScene->pstJobs,
+            "UpdateEntity",
+            _UpdateEntities,
+            pstScene,
+            pstScene->u16EntityCount,
+            SCENE_UPDATE_GRAIN,
+            &stCounter);
+        WaitForJobCounter(pstScene->pstJobs, &stCounter);
+    }
+}
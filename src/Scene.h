@@ -0,0 +1,122 @@
+/**
+ * @file    Scene.h
+ * @ingroup Scene
+ */
+
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Background.h"
+#include "Camera.h"
+#include "Entity.h"
+#include "Job.h"
+#include "Map.h"
+#include "RenderQueue.h"
+#include "SpriteBatch.h"
+
+/**
+ * @ingroup Scene
+ */
+enum SceneLimits
+{
+    SCENE_MAX_LAYERS      = 16,
+    SCENE_MAX_NAME_LENGTH = 32,
+    SCENE_UPDATE_GRAIN    = 64
+};
+
+/**
+ * @ingroup Scene
+ */
+enum SceneLayerType
+{
+    SCENE_LAYER_PARALLAX = 0,
+    SCENE_LAYER_TILES    = 1,
+    SCENE_LAYER_ENTITIES = 2
+};
+
+/**
+ * @brief   A layer of the scene.  Tile layers refer to a layer of the
+ *          map by name, entity layers to a depth bucket.
+ * @ingroup Scene
+ */
+typedef struct SceneLayer_t
+{
+    char     acName[SCENE_MAX_NAME_LENGTH];
+    uint16_t u16RenderLayer;
+    uint8_t  u8Type;
+    uint8_t  u8MapIndex;
+    uint8_t  u8Depth;
+    uint8_t  u8RenderBgColour;
+} SceneLayer;
+
+/**
+ * @ingroup Scene
+ */
+typedef struct SceneEntity_t
+{
+    Entity  *pstEntity;
+    uint8_t  u8Depth;
+} SceneEntity;
+
+/**
+ * @brief   Number of entities per activity tier during the last update.
+ *          See @ref enum EntityActivity.
+ * @ingroup Scene
+ */
+typedef struct SceneStats_t
+{
+    uint16_t u16Visible;
+    uint16_t u16Near;
+    uint16_t u16Dormant;
+} SceneStats;
+
+/**
+ * @brief   Draw order of the scene, from back to front.  Entities within
+ *          dNearMargin pixel of the visible area are near, all others
+ *          outside of it are dormant.  With a JobSystem set, entities
+ *          are updated in parallel.  u8MapOccluders holds the map
+ *          layer groups drawn after the last parallax layer; see
+ *          SetMapOccluders().
+ * @ingroup Scene
+ */
+typedef struct Scene_t
+{
+    SceneLayer   astLayers[SCENE_MAX_LAYERS];
+    SpriteBatch *pstSprites;
+    SceneEntity *pstEntities;
+    JobSystem   *pstJobs;
+    SceneStats   stStats;
+    double       dNearMargin;
+    double       dDeltaTime;
+    uint16_t     u16EntityCount;
+    uint16_t     u16EntityCapacity;
+    uint8_t      u8LayerCount;
+    uint8_t      u8MapOccluders;
+} Scene;
+
+int8_t AddSceneEntity(
+    Scene   *pstScene,
+    Entity  *pstEntity,
+    uint8_t  u8Depth);
+
+int8_t DrawScene(
+    SDL_Renderer *pstRenderer,
+    RenderQueue  *pstQueue,
+    Scene        *pstScene,
+    Background   *pstBackground,
+    Map          *pstMap,
+    const Entity *pstEntityStates,
+    const Camera *pstCamera);
+
+void FreeScene(Scene *pstScene);
+
+Scene *InitScene(const Map *pstMap);
+
+void UpdateScene(
+    Scene        *pstScene,
+    const Camera *pstCamera,
+    double        dDeltaTime);
+
+#endif
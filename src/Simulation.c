@@ -0,0 +1,302 @@
+/**
+ * @file      Simulation.c
+ * @ingroup   Simulation
+ * @defgroup  Simulation
+ * @brief     Game simulation.  Applies the player input, updates the
+ *            Scene and the Camera and publishes a snapshot for the
+ *            renderer.  Optionally runs on a thread of its own, so
+ *            simulating the next step overlaps with drawing the last.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Camera.h"
+#include "Entity.h"
+#include "Log.h"
+#include "Macros.h"
+#include "Map.h"
+#include "Memory.h"
+#include "Scene.h"
+#include "Simulation.h"
+
+static void _Publish(Simulation *pstSimulation)
+{
+    SimulationSnapshot *pstSnapshot = &pstSimulation->astSnapshots[pstSimulation->u8Back];
+    int32_t             s32Shared;
+
+    pstSnapshot->stCamera = *pstSimulation->pstCamera;
+    pstSnapshot->u32Tick  = pstSimulation->u32Tick;
+
+    for (uint16_t u16Index = 0; u16Index < pstSnapshot->u16EntityCount; u16Index++)
+    {
+        pstSnapshot->pstEntities[u16Index] = *pstSimulation->pstScene->pstEntities[u16Index].pstEntity;
+    }
+
+    /* Swap the back slot with the shared one and mark it as fresh.
+     * SDL_AtomicSet() only orders like an acquire, so make sure the
+     * copies are complete before the renderer can take the slot. */
+    SDL_MemoryBarrierRelease();
+    s32Shared = SDL_AtomicSet(
+        &pstSimulation->stShared,
+        pstSimulation->u8Back | SIMULATION_SNAPSHOT_FRESH);
+
+    // Don't overwrite the returned slot while the renderer still reads it.
+    SDL_MemoryBarrierAcquire();
+    pstSimulation->u8Back = s32Shared & ~SIMULATION_SNAPSHOT_FRESH;
+}
+
+static int32_t _Run(void *pData)
+{
+    Simulation *pstSimulation = (Simulation *)pData;
+    uint64_t    u64Frequency  = SDL_GetPerformanceFrequency();
+    uint64_t    u64Last       = SDL_GetPerformanceCounter();
+    double      dLag          = 0;
+
+    while (SDL_AtomicGet(&pstSimulation->stIsRunning))
+    {
+        uint64_t u64Now = SDL_GetPerformanceCounter();
+
+        dLag    += (double)(u64Now - u64Last) / u64Frequency;
+        u64Last  = u64Now;
+
+        // Drop what cannot be caught up instead of spiralling after a stall.
+        if (dLag > 8 * pstSimulation->dStep)
+        {
+            dLag = 8 * pstSimulation->dStep;
+        }
+
+        if (dLag < pstSimulation->dStep)
+        {
+            SDL_Delay(1);
+            continue;
+        }
+
+        while (dLag >= pstSimulation->dStep)
+        {
+            StepSimulation(pstSimulation, pstSimulation->dStep);
+            dLag -= pstSimulation->dStep;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Free Simulation from memory.  A running simulation thread is
+ *          stopped first.
+ * @param   pstSimulation a Simulation.  See @ref struct Simulation.
+ * @ingroup Simulation
+ */
+void FreeSimulation(Simulation *pstSimulation)
+{
+    if (NULL == pstSimulation)
+    {
+        return;
+    }
+
+    if (NULL != pstSimulation->pstThread)
+    {
+        SDL_AtomicSet(&pstSimulation->stIsRunning, 0);
+        SDL_WaitThread(pstSimulation->pstThread, NULL);
+    }
+
+    for (uint8_t u8Index = 0; u8Index < SIMULATION_SNAPSHOTS; u8Index++)
+    {
+        FreeMemory(pstSimulation->astSnapshots[u8Index].pstEntities);
+    }
+    FreeMemory(pstSimulation);
+}
+
+/**
+ * @brief   Get the latest snapshot.  The snapshot stays valid until
+ *          the next call of this function.
+ * @param   pstSimulation a Simulation.  See @ref struct Simulation.
+ * @return  the latest snapshot.  See @ref struct SimulationSnapshot.
+ * @ingroup Simulation
+ */
+const SimulationSnapshot *GetSimulationSnapshot(Simulation *pstSimulation)
+{
+    if (SDL_AtomicGet(&pstSimulation->stShared) & SIMULATION_SNAPSHOT_FRESH)
+    {
+        int32_t s32Shared;
+
+        // Done reading the old slot before the simulation may reuse it.
+        SDL_MemoryBarrierRelease();
+        s32Shared = SDL_AtomicSet(&pstSimulation->stShared, pstSimulation->u8Front);
+
+        // Don't read the new slot before it has been published.
+        SDL_MemoryBarrierAcquire();
+        pstSimulation->u8Front = s32Shared & ~SIMULATION_SNAPSHOT_FRESH;
+    }
+
+    return &pstSimulation->astSnapshots[pstSimulation->u8Front];
+}
+
+/**
+ * @brief   Initialise Simulation.  All entities have to be added to the
+ *          Scene beforehand.  An initial snapshot is published right
+ *          away.
+ * @param   pstScene  the Scene.  See @ref struct Scene.
+ * @param   pstCamera the Camera.  See @ref struct Camera.
+ * @param   pstMap    the Map.  See @ref struct Map.
+ * @param   pstPlayer the Entity controlled by the player.  See @ref struct Entity.
+ * @return  a Simulation on success, NULL on failure.
+ * @ingroup Simulation
+ */
+Simulation *InitSimulation(
+    Scene  *pstScene,
+    Camera *pstCamera,
+    Map    *pstMap,
+    Entity *pstPlayer)
+{
+    static Simulation *pstSimulation;
+    pstSimulation = AllocZeroedMemory(MEMORY_TAG_SIMULATION, 1, sizeof(struct Simulation_t));
+    if (NULL == pstSimulation)
+    {
+        LOG_ERROR("InitSimulation(): error allocating memory.");
+        return NULL;
+    }
+
+    pstSimulation->pstScene  = pstScene;
+    pstSimulation->pstCamera = pstCamera;
+    pstSimulation->pstMap    = pstMap;
+    pstSimulation->pstPlayer = pstPlayer;
+    pstSimulation->u8Back    = 0;
+    pstSimulation->u8Front   = 1;
+    SDL_AtomicSet(&pstSimulation->stShared, 2);
+
+    for (uint8_t u8Index = 0; u8Index < SIMULATION_SNAPSHOTS; u8Index++)
+    {
+        SimulationSnapshot *pstSnapshot = &pstSimulation->astSnapshots[u8Index];
+
+        pstSnapshot->u16EntityCount = pstScene->u16EntityCount;
+        pstSnapshot->pstEntities    = AllocZeroedMemory(MEMORY_TAG_SIMULATION, pstScene->u16EntityCount + 1, sizeof(struct Entity_t));
+        if (NULL == pstSnapshot->pstEntities)
+        {
+            LOG_ERROR("InitSimulation(): error allocating memory.");
+            FreeSimulation(pstSimulation);
+            return NULL;
+        }
+    }
+
+    _Publish(pstSimulation);
+
+    return pstSimulation;
+}
+
+/**
+ * @brief   Set the player input for the next steps.  Can be called from
+ *          any thread.
+ * @param   pstSimulation a Simulation.  See @ref struct Simulation.
+ * @param   u16Input      the input.  See @ref enum SimulationInput.
+ * @ingroup Simulation
+ */
+void SetSimulationInput(Simulation *pstSimulation, uint16_t u16Input)
+{
+    SDL_AtomicSet(&pstSimulation->stInput, u16Input);
+}
+
+/**
+ * @brief   Run the simulation on a thread of its own at a fixed rate.
+ *          From then on, StepSimulation() must not be called anymore
+ *          and the Scene, Camera and entities must only be read
+ *          through GetSimulationSnapshot().
+ * @param   pstSimulation a Simulation.  See @ref struct Simulation.
+ * @param   dRate         the simulation rate in steps per second.
+ * @return  0 on success, -1 on failure.
+ * @ingroup Simulation
+ */
+int8_t StartSimulationThread(Simulation *pstSimulation, double dRate)
+{
+    if (dRate <= 0)
+    {
+        LOG_ERROR("StartSimulationThread(): invalid rate.");
+        return -1;
+    }
+
+    pstSimulation->dStep = 1 / dRate;
+    SDL_AtomicSet(&pstSimulation->stIsRunning, 1);
+
+    pstSimulation->pstThread = SDL_CreateThread(_Run, "Simulation", pstSimulation);
+    if (NULL == pstSimulation->pstThread)
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        SDL_AtomicSet(&pstSimulation->stIsRunning, 0);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief   Advance the simulation by one step and publish a snapshot.
+ * @param   pstSimulation a Simulation.  See @ref struct Simulation.
+ * @param   dDeltaTime    the step in seconds.
+ * @ingroup Simulation
+ */
+void StepSimulation(Simulation *pstSimulation, double dDeltaTime)
+{
+    Entity   *pstPlayer = pstSimulation->pstPlayer;
+    Camera   *pstCamera = pstSimulation->pstCamera;
+    uint16_t  u16Input  = SDL_AtomicGet(&pstSimulation->stInput);
+
+    // Reset ENTITY_IS_MOVING flag (in case no key is pressed).
+    FLAG_CLEAR(pstPlayer->u16Flags, ENTITY_IS_MOVING);
+
+    if (FLAG_IS_SET(u16Input, SIMULATION_INPUT_ZOOM_RESET))
+    {
+        SetCameraZoomLevel(pstCamera, pstCamera->dZoomLevelInitial);
+    }
+
+    if (FLAG_IS_SET(u16Input, SIMULATION_INPUT_ZOOM_OUT))
+    {
+        SetCameraZoomLevel(pstCamera, pstCamera->dZoomLevel - dDeltaTime);
+    }
+
+    if (FLAG_IS_SET(u16Input, SIMULATION_INPUT_ZOOM_IN))
+    {
+        SetCameraZoomLevel(pstCamera, pstCamera->dZoomLevel + dDeltaTime);
+    }
+
+    if (FLAG_IS_SET(u16Input, SIMULATION_INPUT_LEFT))
+    {
+        FLAG_SET(pstPlayer->u16Flags, ENTITY_IS_MOVING);
+        FLAG_SET(pstPlayer->u16Flags, ENTITY_DIRECTION);
+    }
+
+    if (FLAG_IS_SET(u16Input, SIMULATION_INPUT_RIGHT))
+    {
+        FLAG_SET(pstPlayer->u16Flags,   ENTITY_IS_MOVING);
+        FLAG_CLEAR(pstPlayer->u16Flags, ENTITY_DIRECTION);
+    }
+
+    UpdateScene(pstSimulation->pstScene, pstCamera, dDeltaTime);
+
+    // Follow the player.
+    UpdateCamera(
+        pstCamera,
+        pstPlayer->dWorldPosX + (pstPlayer->u8Width  / 2),
+        pstPlayer->dWorldPosY + (pstPlayer->u8Height / 2),
+        dDeltaTime);
+
+    // Set up collision detection.
+    if (IsMapCoordOfType(
+            pstSimulation->pstMap,
+            "Floor",
+            pstPlayer->dWorldPosX + pstPlayer->u8Width,
+            pstPlayer->dWorldPosY + pstPlayer->u8Height))
+    {
+        FLAG_CLEAR(pstPlayer->u16Flags, ENTITY_IS_IN_MID_AIR);
+    }
+    else
+    {
+        FLAG_SET(pstPlayer->u16Flags, ENTITY_IS_IN_MID_AIR);
+    }
+
+    pstSimulation->u32Tick++;
+    _Publish(pstSimulation);
+}
@@ -0,0 +1,92 @@
+/**
+ * @file    Simulation.h
+ * @ingroup Simulation
+ */
+
+#ifndef _SIMULATION_H_
+#define _SIMULATION_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "Camera.h"
+#include "Entity.h"
+#include "Map.h"
+#include "Scene.h"
+
+/**
+ * @brief   Player input, one bit per action.
+ * @ingroup Simulation
+ */
+enum SimulationInput
+{
+    SIMULATION_INPUT_LEFT       = 0,
+    SIMULATION_INPUT_RIGHT      = 1,
+    SIMULATION_INPUT_ZOOM_IN    = 2,
+    SIMULATION_INPUT_ZOOM_OUT   = 3,
+    SIMULATION_INPUT_ZOOM_RESET = 4
+};
+
+/**
+ * @ingroup Simulation
+ */
+enum SimulationLimits
+{
+    SIMULATION_SNAPSHOTS      = 3,
+    SIMULATION_SNAPSHOT_FRESH = 4
+};
+
+/**
+ * @brief   Immutable copy of everything the renderer needs.  The
+ *          entities are stored in the order of the Scene.
+ * @ingroup Simulation
+ */
+typedef struct SimulationSnapshot_t
+{
+    Camera    stCamera;
+    Entity   *pstEntities;
+    uint16_t  u16EntityCount;
+    uint32_t  u32Tick;
+} SimulationSnapshot;
+
+/**
+ * @brief   The simulation either steps along with the frame or runs on
+ *          its own thread at a fixed rate.  Snapshots are handed over
+ *          through a lock-free triple buffer: the simulation owns the
+ *          back slot, the renderer the front slot, and the remaining
+ *          slot is swapped atomically in between.
+ * @ingroup Simulation
+ */
+typedef struct Simulation_t
+{
+    SimulationSnapshot  astSnapshots[SIMULATION_SNAPSHOTS];
+    Scene              *pstScene;
+    Camera             *pstCamera;
+    Map                *pstMap;
+    Entity             *pstPlayer;
+    SDL_Thread         *pstThread;
+    SDL_atomic_t        stInput;
+    SDL_atomic_t        stShared;
+    SDL_atomic_t        stIsRunning;
+    double              dStep;
+    uint32_t            u32Tick;
+    uint8_t             u8Back;
+    uint8_t             u8Front;
+} Simulation;
+
+void FreeSimulation(Simulation *pstSimulation);
+
+const SimulationSnapshot *GetSimulationSnapshot(Simulation *pstSimulation);
+
+Simulation *InitSimulation(
+    Scene  *pstScene,
+    Camera *pstCamera,
+    Map    *pstMap,
+    Entity *pstPlayer);
+
+void SetSimulationInput(Simulation *pstSimulation, uint16_t u16Input);
+
+int8_t StartSimulationThread(Simulation *pstSimulation, double dRate);
+
+void StepSimulation(Simulation *pstSimulation, double dDeltaTime);
+
+#endif
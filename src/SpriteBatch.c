@@ -0,0 +1,225 @@
+/**
+ * @file      SpriteBatch.c
+ * @ingroup   SpriteBatch
+ * @defgroup  SpriteBatch
+ * @brief     Sprite batcher.  Entities push their current frame here
+ *            instead of to the RenderQueue; the quads are collected per
+ *            sprite sheet and handed over with one PushRenderQuads()
+ *            per sheet, so entities sharing a sheet end up in a single
+ *            SDL_RenderGeometry() call.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "Log.h"
+#include "Memory.h"
+#include "RenderQueue.h"
+#include "SpriteBatch.h"
+
+static SpriteAtlas *_GetAtlas(SpriteBatch *pstBatch, SDL_Texture *pstTexture)
+{
+    SpriteAtlas *pstAtlas;
+
+    for (uint8_t u8Index = 0; u8Index < pstBatch->u8AtlasCount; u8Index++)
+    {
+        if (pstTexture == pstBatch->astAtlases[u8Index].pstTexture)
+        {
+            return &pstBatch->astAtlases[u8Index];
+        }
+    }
+
+    if (pstBatch->u8AtlasCount >= SPRITE_BATCH_MAX_ATLASES)
+    {
+        LOG_ERROR("PushSprite(): too many sprite sheets.");
+        return NULL;
+    }
+
+    // Slots keep their vertex buffer; only the sheet is replaced.
+    pstAtlas = &pstBatch->astAtlases[pstBatch->u8AtlasCount];
+    pstAtlas->pstTexture   = pstTexture;
+    pstAtlas->u32QuadCount = 0;
+    if (0 != SDL_QueryTexture(pstTexture, NULL, NULL, &pstAtlas->s32Width, &pstAtlas->s32Height))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return NULL;
+    }
+    pstBatch->u8AtlasCount++;
+
+    return pstAtlas;
+}
+
+static int8_t _ReserveQuads(SpriteAtlas *pstAtlas, uint32_t u32Quads)
+{
+    SDL_Vertex *pstVertices;
+    uint32_t    u32Capacity;
+
+    if (u32Quads <= pstAtlas->u32QuadCapacity)
+    {
+        return 0;
+    }
+
+    u32Capacity = pstAtlas->u32QuadCapacity ? pstAtlas->u32QuadCapacity * 2 : 32;
+    pstVertices = ReallocMemory(MEMORY_TAG_RENDERER, pstAtlas->pstVertices, u32Capacity * 4 * sizeof(SDL_Vertex));
+    if (NULL == pstVertices)
+    {
+        LOG_ERROR("PushSprite(): error allocating memory.");
+        return -1;
+    }
+    pstAtlas->pstVertices     = pstVertices;
+    pstAtlas->u32QuadCapacity = u32Capacity;
+
+    return 0;
+}
+
+/**
+ * @brief   Hand the collected sprites over to the RenderQueue, one list
+ *          of quads per sprite sheet, and empty the SpriteBatch.
+ * @param   pstQueue the RenderQueue.  See @ref struct RenderQueue.
+ * @param   pstBatch a SpriteBatch.  See @ref struct SpriteBatch.
+ * @param   u16Layer the render layer.  See @ref struct Scene.
+ * @return  0 on success, -1 on failure.
+ * @ingroup SpriteBatch
+ */
+int8_t DrawSpriteBatch(
+    RenderQueue *pstQueue,
+    SpriteBatch *pstBatch,
+    uint16_t     u16Layer)
+{
+    int8_t s8Result = 0;
+
+    for (uint8_t u8Index = 0; u8Index < pstBatch->u8AtlasCount; u8Index++)
+    {
+        SpriteAtlas *pstAtlas = &pstBatch->astAtlases[u8Index];
+
+        if ((0 == s8Result) && (-1 == PushRenderQuads(
+                pstQueue,
+                u16Layer,
+                pstAtlas->pstTexture,
+                SDL_BLENDMODE_BLEND,
+                pstAtlas->pstVertices,
+                pstAtlas->u32QuadCount)))
+        {
+            s8Result = -1;
+        }
+
+        pstBatch->stStats.u32Batches++;
+        pstAtlas->pstTexture   = NULL;
+        pstAtlas->u32QuadCount = 0;
+    }
+    pstBatch->u8AtlasCount = 0;
+
+    return s8Result;
+}
+
+/**
+ * @brief   Free SpriteBatch from memory.  The sprite sheets are not
+ *          destroyed.
+ * @param   pstBatch a SpriteBatch.  See @ref struct SpriteBatch.
+ * @ingroup SpriteBatch
+ */
+void FreeSpriteBatch(SpriteBatch *pstBatch)
+{
+    if (NULL == pstBatch)
+    {
+        return;
+    }
+
+    for (uint8_t u8Index = 0; u8Index < SPRITE_BATCH_MAX_ATLASES; u8Index++)
+    {
+        FreeMemory(pstBatch->astAtlases[u8Index].pstVertices);
+    }
+    FreeMemory(pstBatch);
+}
+
+/**
+ * @brief   Get the sprite statistics of the last frame.
+ * @param   pstBatch a SpriteBatch.  See @ref struct SpriteBatch.
+ * @return  the statistics.  See @ref struct SpriteBatchStats.
+ * @ingroup SpriteBatch
+ */
+SpriteBatchStats GetSpriteBatchStats(const SpriteBatch *pstBatch)
+{
+    return pstBatch->stStats;
+}
+
+/**
+ * @brief   Initialise SpriteBatch.
+ * @return  a SpriteBatch on success, NULL on failure.
+ * @ingroup SpriteBatch
+ */
+SpriteBatch *InitSpriteBatch(void)
+{
+    static SpriteBatch *pstBatch;
+    pstBatch = AllocZeroedMemory(MEMORY_TAG_RENDERER, 1, sizeof(struct SpriteBatch_t));
+    if (NULL == pstBatch)
+    {
+        LOG_ERROR("InitSpriteBatch(): error allocating memory.");
+        return NULL;
+    }
+
+    return pstBatch;
+}
+
+/**
+ * @brief   Add a sprite to the SpriteBatch.
+ * @param   pstBatch a SpriteBatch.  See @ref struct SpriteBatch.
+ * @param   pstAtlas the sprite sheet.
+ * @param   pstSrc   the frame on the sprite sheet in pixel.
+ * @param   pstDst   the destination on screen.
+ * @param   eFlip    horizontal and/or vertical flip.  Flipping is done by
+ *                   swapping the texture coordinates.
+ * @return  0 on success, -1 on failure.
+ * @ingroup SpriteBatch
+ */
+int8_t PushSprite(
+    SpriteBatch      *pstBatch,
+    SDL_Texture      *pstAtlas,
+    const SDL_Rect   *pstSrc,
+    const SDL_FRect  *pstDst,
+    SDL_RendererFlip  eFlip)
+{
+    SpriteAtlas *pstSheet;
+    SDL_FRect    stUV;
+
+    if (NULL == pstAtlas)
+    {
+        pstBatch->stStats.u32Missing++;
+        return 0;
+    }
+
+    pstSheet = _GetAtlas(pstBatch, pstAtlas);
+    if ((NULL == pstSheet) || (-1 == _ReserveQuads(pstSheet, pstSheet->u32QuadCount + 1)))
+    {
+        return -1;
+    }
+
+    stUV.x = (float)pstSrc->x / pstSheet->s32Width;
+    stUV.y = (float)pstSrc->y / pstSheet->s32Height;
+    stUV.w = (float)pstSrc->w / pstSheet->s32Width;
+    stUV.h = (float)pstSrc->h / pstSheet->s32Height;
+
+    SetRenderQuadVertices(&pstSheet->pstVertices[pstSheet->u32QuadCount * 4], pstDst, &stUV, eFlip);
+
+    pstSheet->u32QuadCount++;
+    pstBatch->stStats.u32Sprites++;
+
+    return 0;
+}
+
+/**
+ * @brief   Reset the per-frame statistics of the SpriteBatch.  This
+ *          function has to be called once per frame before drawing.
+ * @param   pstBatch a SpriteBatch.  See @ref struct SpriteBatch.
+ * @ingroup SpriteBatch
+ */
+void ResetSpriteBatchStats(SpriteBatch *pstBatch)
+{
+    pstBatch->stStats.u32Sprites = 0;
+    pstBatch->stStats.u32Culled  = 0;
+    pstBatch->stStats.u32Missing = 0;
+    pstBatch->stStats.u32Batches = 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file    SpriteBatch.h
+ * @ingroup SpriteBatch
+ */
+
+#ifndef _SPRITEBATCH_H_
+#define _SPRITEBATCH_H_
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include "RenderQueue.h"
+
+/**
+ * @ingroup SpriteBatch
+ */
+enum SpriteBatchLimits
+{
+    SPRITE_BATCH_MAX_ATLASES = 16
+};
+
+/**
+ * @brief   The sprites of one sprite sheet collected since the last
+ *          flush.  The size of the sheet is looked up once per flush.
+ * @ingroup SpriteBatch
+ */
+typedef struct SpriteAtlas_t
+{
+    SDL_Texture *pstTexture;
+    SDL_Vertex  *pstVertices;
+    int32_t      s32Width;
+    int32_t      s32Height;
+    uint32_t     u32QuadCount;
+    uint32_t     u32QuadCapacity;
+} SpriteAtlas;
+
+/**
+ * @brief   Per-frame sprite statistics.  Culled sprites were outside of
+ *          the visible area, missing sprites had no sprite sheet.
+ * @ingroup SpriteBatch
+ */
+typedef struct SpriteBatchStats_t
+{
+    uint32_t u32Sprites;
+    uint32_t u32Culled;
+    uint32_t u32Missing;
+    uint32_t u32Batches;
+} SpriteBatchStats;
+
+/**
+ * @ingroup SpriteBatch
+ */
+typedef struct SpriteBatch_t
+{
+    SpriteAtlas      astAtlases[SPRITE_BATCH_MAX_ATLASES];
+    SpriteBatchStats stStats;
+    uint8_t          u8AtlasCount;
+} SpriteBatch;
+
+int8_t DrawSpriteBatch(
+    RenderQueue *pstQueue,
+    SpriteBatch *pstBatch,
+    uint16_t     u16Layer);
+
+void FreeSpriteBatch(SpriteBatch *pstBatch);
+
+SpriteBatchStats GetSpriteBatchStats(const SpriteBatch *pstBatch);
+
+SpriteBatch *InitSpriteBatch(void);
+
+int8_t PushSprite(
+    SpriteBatch      *pstBatch,
+    SDL_Texture      *pstAtlas,
+    const SDL_Rect   *pstSrc,
+    const SDL_FRect  *pstDst,
+    SDL_RendererFlip  eFlip);
+
+void ResetSpriteBatchStats(SpriteBatch *pstBatch);
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file      Startup.c
+ * @ingroup   Startup
+ * @defgroup  Startup
+ * @brief     Startup profiler.  Measures wall time, CPU time, page
+ *            faults, allocations and heap growth of each startup phase
+ *            and reports them along with the files read and the load
+ *            time of each image once the first frame is presented.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Asset.h"
+#include "Log.h"
+#include "Memory.h"
+#include "Pack.h"
+#include "Startup.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STARTUP_USE_RUSAGE
+#include <sys/resource.h>
+#include <sys/time.h>
+#endif
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC_MINOR__ >= 33))
+#define STARTUP_USE_MALLINFO
+#include <malloc.h>
+#endif
+
+static void _Sample(StartupSample *pstSample)
+{
+    pstSample->u64Counter    = SDL_GetPerformanceCounter();
+    pstSample->u64Allocated  = GetMemoryAllocated();
+    pstSample->dCpuTime      = (double)clock() * 1000 / CLOCKS_PER_SEC;
+    pstSample->s64PageFaults = 0;
+    pstSample->s64HeapBytes  = 0;
+
+    #ifdef STARTUP_USE_RUSAGE
+    {
+        struct rusage stUsage;
+
+        if (0 == getrusage(RUSAGE_SELF, &stUsage))
+        {
+            pstSample->dCpuTime =
+                (stUsage.ru_utime.tv_sec  + stUsage.ru_stime.tv_sec)  * 1000.0 +
+                (stUsage.ru_utime.tv_usec + stUsage.ru_stime.tv_usec) / 1000.0;
+            pstSample->s64PageFaults = stUsage.ru_minflt + stUsage.ru_majflt;
+        }
+    }
+    #endif
+
+    #ifdef STARTUP_USE_MALLINFO
+    {
+        struct mallinfo2 stInfo = mallinfo2();
+
+        pstSample->s64HeapBytes = stInfo.uordblks + stInfo.hblkhd;
+    }
+    #endif
+}
+
+static void _Measure(
+    StartupPhase        *pstPhase,
+    const StartupSample *pstStart,
+    const StartupSample *pstEnd)
+{
+    pstPhase->dWallTime     = (double)(pstEnd->u64Counter - pstStart->u64Counter) * 1000 / SDL_GetPerformanceFrequency();
+    pstPhase->dCpuTime      = pstEnd->dCpuTime      - pstStart->dCpuTime;
+    pstPhase->s64PageFaults = pstEnd->s64PageFaults - pstStart->s64PageFaults;
+    pstPhase->s64HeapBytes  = pstEnd->s64HeapBytes  - pstStart->s64HeapBytes;
+    pstPhase->u64Allocated  = pstEnd->u64Allocated  - pstStart->u64Allocated;
+}
+
+static void _PrintPhase(const StartupPhase *pstPhase)
+{
+    char acHeap[16] = "n/a";
+
+    // Without mallinfo2() there is nothing to tell, not even 0.
+    #ifdef STARTUP_USE_MALLINFO
+    snprintf(acHeap, sizeof(acHeap), "%lld", (long long)pstPhase->s64HeapBytes / 1024);
+    #endif
+
+    printf(
+        "  %-40s %9.2f %9.2f %8lld %10llu %10s\n",
+        pstPhase->acName,
+        pstPhase->dWallTime,
+        pstPhase->dCpuTime,
+        (long long)pstPhase->s64PageFaults,
+        (unsigned long long)pstPhase->u64Allocated / 1024,
+        acHeap);
+}
+
+static void _PrintReads(void)
+{
+    PackRead astReads[PACK_MAX_READS];
+    uint16_t u16Count = GetPackReads(astReads, PACK_MAX_READS);
+
+    // Bytes read from the file and bytes allocated to hold it.
+    printf("  %-40s %9s %9s %8s %10s\n", "File", "Reads", "Read KiB", "", "Alloc KiB");
+    for (uint16_t u16Index = 0; u16Index < u16Count; u16Index++)
+    {
+        printf(
+            "  %-40s %9u %9llu %8s %10llu\n",
+            astReads[u16Index].acPath,
+            (unsigned int)astReads[u16Index].u32Count,
+            (unsigned long long)astReads[u16Index].u64Bytes / 1024,
+            "",
+            (unsigned long long)astReads[u16Index].u64Copied / 1024);
+    }
+}
+
+/**
+ * @brief   End the current phase and begin the next one.
+ * @param   pstProfile  a StartupProfile.  See @ref struct StartupProfile.
+ * @param   pacName     the name of the phase.
+ * @param   pacFilename the file the phase loads or NULL.
+ * @ingroup Startup
+ */
+void BeginStartupPhase(
+    StartupProfile *pstProfile,
+    const char     *pacName,
+    const char     *pacFilename)
+{
+    StartupSample stNow;
+    StartupPhase *pstPhase;
+
+    if ((NULL == pstProfile) || pstProfile->u8IsReported)
+    {
+        return;
+    }
+
+    // Once full, the last phase simply runs on.
+    if (pstProfile->u8PhaseCount >= STARTUP_MAX_PHASES)
+    {
+        return;
+    }
+
+    _Sample(&stNow);
+    if (pstProfile->u8PhaseCount > 0)
+    {
+        _Measure(
+            &pstProfile->astPhases[pstProfile->u8PhaseCount - 1],
+            &pstProfile->stPhaseStart,
+            &stNow);
+    }
+
+    pstPhase = &pstProfile->astPhases[pstProfile->u8PhaseCount];
+    if (NULL == pacFilename)
+    {
+        snprintf(pstPhase->acName, STARTUP_MAX_NAME_LENGTH, "%s", pacName);
+    }
+    else
+    {
+        snprintf(pstPhase->acName, STARTUP_MAX_NAME_LENGTH, "%s %s", pacName, pacFilename);
+    }
+
+    pstProfile->stPhaseStart = stNow;
+    pstProfile->u8PhaseCount++;
+}
+
+/**
+ * @brief   Free StartupProfile from memory.
+ * @param   pstProfile a StartupProfile.  See @ref struct StartupProfile.
+ * @ingroup Startup
+ */
+void FreeStartupProfile(StartupProfile *pstProfile)
+{
+    FreeMemory(pstProfile);
+}
+
+/**
+ * @brief   Initialise StartupProfile.  Should be the very first thing
+ *          the program does.
+ * @return  a StartupProfile on success, NULL on failure.
+ * @ingroup Startup
+ */
+StartupProfile *InitStartupProfile(void)
+{
+    static StartupProfile *pstProfile;
+    pstProfile = AllocZeroedMemory(MEMORY_TAG_CORE, 1, sizeof(struct StartupProfile_t));
+    if (NULL == pstProfile)
+    {
+        LOG_ERROR("InitStartupProfile(): error allocating memory.");
+        return NULL;
+    }
+
+    _Sample(&pstProfile->stStart);
+    pstProfile->stPhaseStart = pstProfile->stStart;
+
+    return pstProfile;
+}
+
+/**
+ * @brief   End the last phase and print the report to stdout.  Only
+ *          the first call has any effect.
+ * @param   pstProfile a StartupProfile.  See @ref struct StartupProfile.
+ * @param   pstAssets  the AssetManager whose images are listed or NULL.
+ *                     See @ref struct AssetManager.
+ * @ingroup Startup
+ */
+void ReportStartupProfile(StartupProfile *pstProfile, AssetManager *pstAssets)
+{
+    StartupSample stNow;
+    StartupPhase  stTotal;
+    AssetStats    stAssetStats;
+
+    if ((NULL == pstProfile) || pstProfile->u8IsReported)
+    {
+        return;
+    }
+    pstProfile->u8IsReported = 1;
+
+    _Sample(&stNow);
+    if (pstProfile->u8PhaseCount > 0)
+    {
+        _Measure(
+            &pstProfile->astPhases[pstProfile->u8PhaseCount - 1],
+            &pstProfile->stPhaseStart,
+            &stNow);
+    }
+
+    printf("Startup:\n");
+    printf(
+        "  %-40s %9s %9s %8s %10s %10s\n",
+        "Phase", "Wall ms", "CPU ms", "Faults", "Alloc KiB", "Heap KiB");
+    for (uint8_t u8Index = 0; u8Index < pstProfile->u8PhaseCount; u8Index++)
+    {
+        _PrintPhase(&pstProfile->astPhases[u8Index]);
+    }
+
+    memset(&stTotal, 0, sizeof(struct StartupPhase_t));
+    snprintf(stTotal.acName, STARTUP_MAX_NAME_LENGTH, "Total");
+    _Measure(&stTotal, &pstProfile->stStart, &stNow);
+    _PrintPhase(&stTotal);
+
+    _PrintReads();
+
+    if (NULL == pstAssets)
+    {
+        return;
+    }
+
+    // Images load on the workers, overlapping the phases above.
+    printf("  %-40s %9s %9s %8s %10s\n", "Image", "Load ms", "", "", "Pixel KiB");
+    for (uint16_t u16Index = 0; u16Index < pstAssets->u16Count; u16Index++)
+    {
+        Asset *pstAsset = &pstAssets->astAssets[u16Index];
+
+        if (ASSET_READY != GetAssetState(pstAssets, u16Index))
+        {
+            continue;
+        }
+
+        printf(
+            "  %-40s %9.2f %9s %8s %10u\n",
+            pstAsset->acFilename,
+            pstAsset->dLoadTime,
+            pstAsset->u8IsCached ? "cached" : "decoded",
+            "",
+            (unsigned int)(pstAsset->u32Bytes / 1024));
+    }
+
+    stAssetStats = GetAssetStats(pstAssets);
+    printf(
+        "  %u decoded in %.2f ms, %u from cache in %.2f ms\n",
+        stAssetStats.u16Decoded,
+        stAssetStats.dDecodeTime,
+        stAssetStats.u16Cached,
+        stAssetStats.dCacheTime);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file    Startup.h
+ * @ingroup Startup
+ */
+
+#ifndef _STARTUP_H_
+#define _STARTUP_H_
+
+#include <stdint.h>
+#include "Asset.h"
+
+/**
+ * @ingroup Startup
+ */
+enum StartupLimits
+{
+    STARTUP_MAX_PHASES      = 32,
+    STARTUP_MAX_NAME_LENGTH = 64
+};
+
+/**
+ * @brief   Process-wide counters at one point in time.  CPU time, page
+ *          faults and allocations include all threads, e.g. workers
+ *          decoding images.  u64Allocated counts the memory allocated
+ *          through the Memory module, s64HeapBytes the heap in use as
+ *          far as the C library tells.
+ * @ingroup Startup
+ */
+typedef struct StartupSample_t
+{
+    uint64_t u64Counter;
+    uint64_t u64Allocated;
+    double   dCpuTime;
+    int64_t  s64PageFaults;
+    int64_t  s64HeapBytes;
+} StartupSample;
+
+/**
+ * @brief   Difference between the samples at the start and the end of
+ *          a phase.  Times are in milliseconds.
+ * @ingroup Startup
+ */
+typedef struct StartupPhase_t
+{
+    char     acName[STARTUP_MAX_NAME_LENGTH];
+    double   dWallTime;
+    double   dCpuTime;
+    int64_t  s64PageFaults;
+    int64_t  s64HeapBytes;
+    uint64_t u64Allocated;
+} StartupPhase;
+
+/**
+ * @brief   Splits the startup into consecutive phases.  Each phase
+ *          lasts until the next one begins; the last one ends with the
+ *          report.
+ * @ingroup Startup
+ */
+typedef struct StartupProfile_t
+{
+    StartupPhase  astPhases[STARTUP_MAX_PHASES];
+    StartupSample stStart;
+    StartupSample stPhaseStart;
+    uint8_t       u8PhaseCount;
+    uint8_t       u8IsReported;
+} StartupProfile;
+
+void BeginStartupPhase(
+    StartupProfile *pstProfile,
+    const char     *pacName,
+    const char     *pacFilename);
+
+void FreeStartupProfile(StartupProfile *pstProfile);
+
+StartupProfile *InitStartupProfile(void);
+
+void ReportStartupProfile(StartupProfile *pstProfile, AssetManager *pstAssets);
+
+#endif
@@ -8,18 +8,179 @@
  */
 
 #include <SDL2/SDL.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "Log.h"
+#include "Memory.h"
+#include "RenderQueue.h"
 #include "Video.h"
 
+/* Draw everything into a target of the native resolution.  The logical
+ * size is set to the same size, so the single copy to the window in
+ * UpdateVideo() is scaled by an integer factor with nearest filtering.
+ * Texture targets are always drawn to 1:1 by SDL.  The target is only
+ * selected once the logical size has been set, as that would otherwise
+ * be applied to the target as well. */
+static int8_t _InitNativeTarget(
+    Video         *pstVideo,
+    const int32_t  s32NativeWidth,
+    const int32_t  s32NativeHeight)
+{
+    int32_t s32Scale = SDL_min(
+        pstVideo->s32WindowWidth  / s32NativeWidth,
+        pstVideo->s32WindowHeight / s32NativeHeight);
+
+    pstVideo->pstTarget = CreateTrackedTexture(
+        MEMORY_TAG_RENDERER,
+        pstVideo->pstRenderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_TARGET,
+        s32NativeWidth,
+        s32NativeHeight);
+
+    if (NULL == pstVideo->pstTarget)
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    if ((0 != SDL_SetTextureBlendMode(pstVideo->pstTarget, SDL_BLENDMODE_NONE))   ||
+        (0 != SDL_SetTextureScaleMode(pstVideo->pstTarget, SDL_ScaleModeNearest)) ||
+        (0 != SDL_RenderSetIntegerScale(pstVideo->pstRenderer, SDL_TRUE)))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        return -1;
+    }
+
+    pstVideo->s32LogicalWidth  = s32NativeWidth;
+    pstVideo->s32LogicalHeight = s32NativeHeight;
+    pstVideo->dZoomLevel       = SDL_max(1, s32Scale);
+    pstVideo->dOutputScale     = 1;
+
+    return 0;
+}
+
+/* Stretch the used part of the target over the window.  With linear
+ * filtering, samples at the right and bottom edge of a partially used
+ * target would blend in stale texels next to it, so the texture
+ * coordinates stop half a texel short there.  The outer edges of the
+ * texture are clamped anyway. */
+static void _PresentTarget(Video *pstVideo, const double dScale)
+{
+    const int32_t s32Indices[6] = { 0, 1, 2, 2, 1, 3 };
+    SDL_Vertex    astVertices[4];
+    SDL_FRect     stDst;
+    SDL_FRect     stUV;
+    int32_t       s32Width;
+    int32_t       s32Height;
+    double        dUsedWidth  = ceil(pstVideo->s32LogicalWidth  * dScale);
+    double        dUsedHeight = ceil(pstVideo->s32LogicalHeight * dScale);
+
+    SDL_QueryTexture(pstVideo->pstTarget, NULL, NULL, &s32Width, &s32Height);
+
+    stDst.x = 0;
+    stDst.y = 0;
+    stDst.w = pstVideo->s32LogicalWidth;
+    stDst.h = pstVideo->s32LogicalHeight;
+
+    if (dUsedWidth < s32Width)
+    {
+        dUsedWidth -= 0.5;
+    }
+
+    if (dUsedHeight < s32Height)
+    {
+        dUsedHeight -= 0.5;
+    }
+
+    stUV.x = 0;
+    stUV.y = 0;
+    stUV.w = dUsedWidth  / s32Width;
+    stUV.h = dUsedHeight / s32Height;
+
+    SetRenderQuadVertices(astVertices, &stDst, &stUV, SDL_FLIP_NONE);
+    SDL_RenderGeometry(pstVideo->pstRenderer, pstVideo->pstTarget, astVertices, 4, s32Indices, 6);
+}
+
+/* Measure the time spent on the frame, including the present where SDL
+ * submits the batched draw calls and the GPU cost of the resolution
+ * shows, and adapt the resolution scale.  The scale is lowered quickly
+ * when the budget is exceeded but only raised again after the frame
+ * time has been well below it for a while. */
+static void _UpdateResolution(VideoResolution *pstResolution)
+{
+    uint64_t u64Now = SDL_GetPerformanceCounter();
+    double   dFrameTime;
+
+    if (0 == pstResolution->u64FrameStart)
+    {
+        return;
+    }
+
+    dFrameTime =
+        (double)(u64Now - pstResolution->u64FrameStart) * 1000 /
+        SDL_GetPerformanceFrequency();
+
+    // Smooth out single spikes.
+    pstResolution->dFrameTime += (dFrameTime - pstResolution->dFrameTime) * 0.1;
+
+    if (pstResolution->dFrameTime > pstResolution->dFrameBudget * 0.9)
+    {
+        pstResolution->u16FastFrames = 0;
+        pstResolution->u16SlowFrames++;
+    }
+    else if (pstResolution->dFrameTime < pstResolution->dFrameBudget * 0.6)
+    {
+        pstResolution->u16SlowFrames = 0;
+        pstResolution->u16FastFrames++;
+    }
+    else
+    {
+        pstResolution->u16SlowFrames = 0;
+        pstResolution->u16FastFrames = 0;
+    }
+
+    if (pstResolution->u16SlowFrames >= VIDEO_FRAMES_BEFORE_LOWERING)
+    {
+        pstResolution->dScale        = SDL_max(pstResolution->dMinScale, pstResolution->dScale * 0.9);
+        pstResolution->u16SlowFrames = 0;
+    }
+    else if (pstResolution->u16FastFrames >= VIDEO_FRAMES_BEFORE_RAISING)
+    {
+        pstResolution->dScale        = SDL_min(1, pstResolution->dScale * 1.05);
+        pstResolution->u16FastFrames = 0;
+    }
+}
+
+/**
+ * @brief   Mark the start of a frame.  The time until UpdateVideo() has
+ *          presented it is what dynamic resolution scaling tries to
+ *          keep within budget; waiting for the FPS limiter is not
+ *          counted.
+ * @param   pstVideo Video.  See @ref struct Video.
+ * @ingroup Video
+ */
+void BeginVideoFrame(Video *pstVideo)
+{
+    pstVideo->stResolution.u64FrameStart = SDL_GetPerformanceCounter();
+}
+
 /**
  * @brief   Initialise Video subsystem.
  * @param   pacTitle     the name of the window.
  * @param   s32Width     window width.
  * @param   s32Height    window height.
  * @param   u8Fullscreen boolean value to set fullscreen state.
- * @param   dZoomLevel   the initial zoom level.
+ * @param   dZoomLevel   the scale of the logical size.  The logical size is
+ *                       fixed for the lifetime of the renderer; zooming
+ *                       is done by the Camera.
+ * @param   s32NativeWidth  width of the native resolution or 0.  If set,
+ *                          the scene is drawn into a target of this size
+ *                          which is upscaled by an integer factor once
+ *                          per frame and dZoomLevel is ignored.
+ * @param   s32NativeHeight height of the native resolution or 0.
  * @return  Video on success, NULL on failure.  See @ref struct Video.
  * @ingroup Video
  */
@@ -28,30 +189,42 @@ Video *InitVideo(
     const int32_t  s32Width,
     const int32_t  s32Height,
     const uint8_t  u8Fullscreen,
-    const double   dZoomLevel)
+    const double   dZoomLevel,
+    const int32_t  s32NativeWidth,
+    const int32_t  s32NativeHeight)
 {
     uint32_t      u32Flags;
     static Video *pstVideo;
 
-    pstVideo = malloc(sizeof(struct Video_t));
+    pstVideo = AllocMemory(MEMORY_TAG_RENDERER, sizeof(struct Video_t));
 
     if (NULL == pstVideo)
     {
-        fprintf(stderr, "InitVideo(): error allocating memory.\n");
+        LOG_ERROR("InitVideo(): error allocating memory.");
         return NULL;
     }
 
     if (0 != SDL_Init(SDL_INIT_VIDEO))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        LOG_ERROR("%s", SDL_GetError());
+        FreeMemory(pstVideo);
         return NULL;
     }
 
-    pstVideo->s32WindowHeight   = s32Height;
-    pstVideo->s32WindowWidth    = s32Width;
-    pstVideo->dZoomLevel        = dZoomLevel;
-    pstVideo->dZoomLevelInitial = dZoomLevel;
+    pstVideo->s32WindowHeight = s32Height;
+    pstVideo->s32WindowWidth  = s32Width;
+    pstVideo->dZoomLevel      = dZoomLevel;
+    pstVideo->dOutputScale    = dZoomLevel;
+    pstVideo->pstTarget       = NULL;
+
+    pstVideo->stResolution.dScale        = 1;
+    pstVideo->stResolution.dMinScale     = 1;
+    pstVideo->stResolution.dFrameBudget  = 0;
+    pstVideo->stResolution.dFrameTime    = 0;
+    pstVideo->stResolution.u64FrameStart = 0;
+    pstVideo->stResolution.u16SlowFrames = 0;
+    pstVideo->stResolution.u16FastFrames = 0;
+    pstVideo->stResolution.u8IsDynamic   = 0;
 
     if (u8Fullscreen)
     {
@@ -72,8 +245,8 @@ Video *InitVideo(
 
     if (NULL == pstVideo->pstWindow)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        LOG_ERROR("%s", SDL_GetError());
+        FreeMemory(pstVideo);
         return NULL;
     }
 
@@ -86,8 +259,8 @@ Video *InitVideo(
 
         if (0 > SDL_ShowCursor(SDL_DISABLE))
         {
-            fprintf(stderr, "%s\n", SDL_GetError());
-            free(pstVideo);
+            LOG_ERROR("%s", SDL_GetError());
+            FreeMemory(pstVideo);
             return NULL;
         }
     }
@@ -99,18 +272,38 @@ Video *InitVideo(
 
     if (NULL == pstVideo->pstRenderer)
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        LOG_ERROR("%s", SDL_GetError());
+        FreeMemory(pstVideo);
         return NULL;
     }
 
+    pstVideo->s32LogicalWidth  = pstVideo->s32WindowWidth  / dZoomLevel;
+    pstVideo->s32LogicalHeight = pstVideo->s32WindowHeight / dZoomLevel;
+
+    if ((s32NativeWidth > 0) && (s32NativeHeight > 0))
+    {
+        if (-1 == _InitNativeTarget(pstVideo, s32NativeWidth, s32NativeHeight))
+        {
+            TerminateVideo(pstVideo);
+            return NULL;
+        }
+    }
+
     if (0 != SDL_RenderSetLogicalSize(
             pstVideo->pstRenderer,
-            pstVideo->s32WindowWidth  / dZoomLevel,
-            pstVideo->s32WindowHeight / dZoomLevel))
+            pstVideo->s32LogicalWidth,
+            pstVideo->s32LogicalHeight))
+    {
+        LOG_ERROR("%s", SDL_GetError());
+        TerminateVideo(pstVideo);
+        return NULL;
+    }
+
+    if ((NULL != pstVideo->pstTarget) &&
+        (0 != SDL_SetRenderTarget(pstVideo->pstRenderer, pstVideo->pstTarget)))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
-        free(pstVideo);
+        LOG_ERROR("%s", SDL_GetError());
+        TerminateVideo(pstVideo);
         return NULL;
     }
 
@@ -118,27 +311,49 @@ Video *InitVideo(
 }
 
 /**
- * @brief   Set Video zoom level.
- * @param   pstVideo   Video.  See @ref struct Video.
- * @param   dZoomLevel the zoom level.
+ * @brief   Enable dynamic resolution scaling.  The scene is then drawn
+ *          at a fraction of the native resolution which is adapted to
+ *          the measured frame time.  If no native resolution is set,
+ *          the logical size is used as such.
+ * @param   pstVideo     Video.  See @ref struct Video.
+ * @param   dMinScale    the lowest resolution scale, e.g. 0.5.
+ * @param   dFrameBudget the frame time to hold in milliseconds.
+ * @return  0 on success, -1 on failure.
  * @ingroup Video
- * @return
  */
-int8_t SetVideoZoomLevel(Video *pstVideo, double dZoomLevel)
+int8_t SetVideoDynamicResolution(
+    Video        *pstVideo,
+    const double  dMinScale,
+    const double  dFrameBudget)
 {
-    if (dZoomLevel <= VIDEO_MIN_ZOOMLEVEL) dZoomLevel = VIDEO_MIN_ZOOMLEVEL;
-    if (dZoomLevel >= VIDEO_MAX_ZOOMLEVEL) dZoomLevel = VIDEO_MAX_ZOOMLEVEL;
+    if (NULL == pstVideo->pstTarget)
+    {
+        if (-1 == _InitNativeTarget(pstVideo, pstVideo->s32LogicalWidth, pstVideo->s32LogicalHeight))
+        {
+            return -1;
+        }
 
-    if (0 != SDL_RenderSetLogicalSize(
-            pstVideo->pstRenderer,
-            pstVideo->s32WindowWidth  / dZoomLevel,
-            pstVideo->s32WindowHeight / dZoomLevel))
+        if ((0 != SDL_RenderSetLogicalSize(
+                pstVideo->pstRenderer,
+                pstVideo->s32LogicalWidth,
+                pstVideo->s32LogicalHeight)) ||
+            (0 != SDL_SetRenderTarget(pstVideo->pstRenderer, pstVideo->pstTarget)))
+        {
+            LOG_ERROR("%s", SDL_GetError());
+            return -1;
+        }
+    }
+
+    // A partially used target is stretched, not integer scaled.
+    if (0 != SDL_SetTextureScaleMode(pstVideo->pstTarget, SDL_ScaleModeLinear))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
+        LOG_ERROR("%s", SDL_GetError());
         return -1;
     }
 
-    pstVideo->dZoomLevel = dZoomLevel;
+    pstVideo->stResolution.dMinScale    = SDL_min(1, SDL_max(0.25, dMinScale));
+    pstVideo->stResolution.dFrameBudget = dFrameBudget;
+    pstVideo->stResolution.u8IsDynamic  = 1;
 
     return 0;
 }
@@ -152,18 +367,50 @@ void TerminateVideo(Video *pstVideo)
 {
     if ((NULL == pstVideo->pstWindow))
     {
-        fprintf(stderr, "%s\n", SDL_GetError());
+        LOG_ERROR("%s", SDL_GetError());
+    }
+
+    if (NULL != pstVideo->pstTarget)
+    {
+        DestroyTrackedTexture(pstVideo->pstTarget);
     }
 
     SDL_DestroyRenderer(pstVideo->pstRenderer);
     SDL_DestroyWindow(pstVideo->pstWindow);
-    free(pstVideo);
+    FreeMemory(pstVideo);
 }
 
-void UpdateVideo(SDL_Renderer *pstRenderer)
+/**
+ * @brief   Present the current frame.  If a native resolution target
+ *          is used, its used part is upscaled to the window first and
+ *          the target is selected again for the next frame.
+ * @param   pstVideo Video.  See @ref struct Video.
+ * @ingroup Video
+ */
+void UpdateVideo(Video *pstVideo)
 {
-    SDL_RenderPresent(pstRenderer);
+    VideoResolution *pstResolution = &pstVideo->stResolution;
+
+    if (NULL != pstVideo->pstTarget)
+    {
+        SDL_SetRenderTarget(pstVideo->pstRenderer, NULL);
+        SDL_RenderClear(pstVideo->pstRenderer);
+        _PresentTarget(pstVideo, pstResolution->dScale);
+    }
+
+    SDL_RenderPresent(pstVideo->pstRenderer);
+
+    if (pstResolution->u8IsDynamic)
+    {
+        _UpdateResolution(pstResolution);
+    }
+
+    if (NULL != pstVideo->pstTarget)
+    {
+        SDL_SetRenderTarget(pstVideo->pstRenderer, pstVideo->pstTarget);
+    }
+
     #ifndef __EMSCRIPTEN__
-    SDL_RenderClear(pstRenderer);
+    SDL_RenderClear(pstVideo->pstRenderer);
     #endif
 }
@@ -18,28 +18,69 @@ enum VideoLimits
     VIDEO_MAX_ZOOMLEVEL = 4
 };
 
+/**
+ * @brief   Frames the frame time has to stay outside of the budget
+ *          before the resolution is lowered or raised again.
+ * @ingroup Video
+ */
+enum VideoHysteresis
+{
+    VIDEO_FRAMES_BEFORE_LOWERING = 15,
+    VIDEO_FRAMES_BEFORE_RAISING  = 120
+};
+
+/**
+ * @brief   Dynamic resolution state.  The scene is drawn into the top
+ *          left dScale part of the native target, which is upscaled to
+ *          the window at present.
+ * @ingroup Video
+ */
+typedef struct VideoResolution_t
+{
+    double   dScale;
+    double   dMinScale;
+    double   dFrameBudget;
+    double   dFrameTime;
+    uint64_t u64FrameStart;
+    uint16_t u16SlowFrames;
+    uint16_t u16FastFrames;
+    uint8_t  u8IsDynamic;
+} VideoResolution;
+
 /**
  * @ingroup Video
  */
 typedef struct Video_t
 {
-    SDL_Renderer *pstRenderer;
-    SDL_Window   *pstWindow;
-    int32_t       s32WindowHeight;
-    int32_t       s32WindowWidth;
-    double        dZoomLevel;
-    double        dZoomLevelInitial;
+    SDL_Renderer   *pstRenderer;
+    SDL_Window     *pstWindow;
+    SDL_Texture    *pstTarget;
+    int32_t         s32WindowHeight;
+    int32_t         s32WindowWidth;
+    int32_t         s32LogicalHeight;
+    int32_t         s32LogicalWidth;
+    double          dZoomLevel;
+    double          dOutputScale;
+    VideoResolution stResolution;
 } Video;
 
+void BeginVideoFrame(Video *pstVideo);
+
 Video *InitVideo(
     const char    *pacTitle,
     const int32_t  s32Width,
     const int32_t  s32Height,
     const uint8_t  u8Fullscreen,
-    const double   dZoomLevel);
+    const double   dZoomLevel,
+    const int32_t  s32NativeWidth,
+    const int32_t  s32NativeHeight);
+
+int8_t SetVideoDynamicResolution(
+    Video        *pstVideo,
+    const double  dMinScale,
+    const double  dFrameBudget);
 
-int8_t SetVideoZoomLevel(Video *pstVideo, double dZoomLevel);
-void   TerminateVideo(Video *pstVideo);
-void   UpdateVideo(SDL_Renderer *pstRenderer);
+void TerminateVideo(Video *pstVideo);
+void UpdateVideo(Video *pstVideo);
 
 #endif
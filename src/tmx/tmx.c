@@ -16,6 +16,7 @@ void* (*tmx_alloc_func) (void *address, size_t len) = NULL;
 void  (*tmx_free_func ) (void *address) = NULL;
 void* (*tmx_img_load_func) (const char *p) = NULL;
 void  (*tmx_img_free_func) (void *address) = NULL;
+void  (*tmx_err_func) (int code, const char *msg) = NULL;
 
 /*
 	Public functions
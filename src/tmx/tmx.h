@@ -42,6 +42,9 @@ TMXEXPORT extern void  (*tmx_free_func ) (void *address);             /* free */
 TMXEXPORT extern void* (*tmx_img_load_func) (const char *path);
 TMXEXPORT extern void  (*tmx_img_free_func) (void *address);
 
+/* called with each error message as it is raised, e.g. to log it */
+TMXEXPORT extern void  (*tmx_err_func) (int code, const char *msg);
+
 /*
 	Data Structures
 */
@@ -113,6 +113,10 @@ void tileset_deallocator(void *val, const char *key);
 #endif
 
 char custom_msg[256];
-#define tmx_err(code, ...) tmx_errno = code; snprintf(custom_msg, 256, __VA_ARGS__)
+#define tmx_err(code, ...) do { \
+	tmx_errno = code; \
+	snprintf(custom_msg, 256, __VA_ARGS__); \
+	if (tmx_err_func) tmx_err_func(code, custom_msg); \
+} while (0)
 
 #endif /* TMXUTILS_H */
@@ -0,0 +1,264 @@
+/**
+ * @file      pack.c
+ * @brief     Builds an archive which can be mounted using InitPack().
+ *            Files are stored under the path given on the command line,
+ *            e.g. "res/maps/demo.tmx".
+ *
+ *            Usage: pack [-z] ARCHIVE FILE...
+ *
+ *            With -z, files are deflated where it pays off; files which
+ *            are already compressed (PNG) are stored as they are, so
+ *            they can still be read in place.
+ * @author    Michael Fitzmayer
+ * @copyright "THE BEER-WARE LICENCE" (Revision 42)
+ */
+
+#include <SDL2/SDL.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "../src/Macros.h"
+#include "../src/Pack.h"
+
+/**
+ * @brief A file to be packed.
+ */
+typedef struct PackFile_t
+{
+    PackEntry  stEntry;
+    uint8_t   *pu8Data;
+} PackFile;
+
+static uint8_t *_ReadFile(const char *pacFilename, uint32_t *pu32Size)
+{
+    FILE    *pstFile = fopen(pacFilename, "rb");
+    uint8_t *pu8Data;
+    long     lSize;
+
+    if (NULL == pstFile)
+    {
+        fprintf(stderr, "pack: couldn't open %s\n", pacFilename);
+        return NULL;
+    }
+
+    fseek(pstFile, 0, SEEK_END);
+    lSize = ftell(pstFile);
+    fseek(pstFile, 0, SEEK_SET);
+
+    if (lSize < 0)
+    {
+        fprintf(stderr, "pack: couldn't read %s\n", pacFilename);
+        fclose(pstFile);
+        return NULL;
+    }
+
+    pu8Data = malloc(lSize + 1);
+    if (NULL == pu8Data)
+    {
+        fprintf(stderr, "pack: error allocating memory.\n");
+        fclose(pstFile);
+        return NULL;
+    }
+
+    if ((long)fread(pu8Data, 1, lSize, pstFile) != lSize)
+    {
+        fprintf(stderr, "pack: couldn't read %s\n", pacFilename);
+        fclose(pstFile);
+        free(pu8Data);
+        return NULL;
+    }
+    fclose(pstFile);
+
+    *pu32Size = lSize;
+    return pu8Data;
+}
+
+static int8_t _Deflate(PackFile *pstFile)
+{
+    uLongf   zStoredSize = compressBound(pstFile->stEntry.u32Size);
+    uint8_t *pu8Stored   = malloc(zStoredSize);
+
+    if (NULL == pu8Stored)
+    {
+        fprintf(stderr, "pack: error allocating memory.\n");
+        return -1;
+    }
+
+    if (Z_OK != compress2(pu8Stored, &zStoredSize, pstFile->pu8Data, pstFile->stEntry.u32Size, Z_BEST_COMPRESSION))
+    {
+        fprintf(stderr, "pack: couldn't deflate %s\n", pstFile->stEntry.acPath);
+        free(pu8Stored);
+        return -1;
+    }
+
+    // Only worth inflating on load if it saves at least an eighth.
+    if (zStoredSize > pstFile->stEntry.u32Size - pstFile->stEntry.u32Size / 8)
+    {
+        free(pu8Stored);
+        return 0;
+    }
+
+    free(pstFile->pu8Data);
+    pstFile->pu8Data               = pu8Stored;
+    pstFile->stEntry.u32StoredSize = zStoredSize;
+    FLAG_SET(pstFile->stEntry.u32Flags, PACK_ENTRY_DEFLATED);
+
+    return 0;
+}
+
+static int32_t _Compare(const void *pA, const void *pB)
+{
+    return strcmp(((const PackFile *)pA)->stEntry.acPath, ((const PackFile *)pB)->stEntry.acPath);
+}
+
+static int8_t _Write(const char *pacFilename, PackFile *pstFiles, uint32_t u32Count)
+{
+    static const uint8_t au8Padding[PACK_ALIGNMENT] = { 0 };
+    PackHeader           stHeader;
+    FILE                *pstArchive;
+    uint32_t             u32Offset;
+
+    pstArchive = fopen(pacFilename, "wb");
+    if (NULL == pstArchive)
+    {
+        fprintf(stderr, "pack: couldn't create %s\n", pacFilename);
+        return -1;
+    }
+
+    memcpy(stHeader.acMagic, "BSPK", 4);
+    stHeader.u32Version    = SDL_SwapLE32(PACK_VERSION);
+    stHeader.u32EntryCount = SDL_SwapLE32(u32Count);
+    stHeader.u32Reserved   = 0;
+    fwrite(&stHeader, sizeof(struct PackHeader_t), 1, pstArchive);
+
+    // Lay out the blobs behind the index.
+    u32Offset = sizeof(struct PackHeader_t) + u32Count * sizeof(struct PackEntry_t);
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        PackEntry stEntry = pstFiles[u32Index].stEntry;
+
+        u32Offset = (u32Offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+
+        pstFiles[u32Index].stEntry.u32Offset = u32Offset;
+        stEntry.u32Offset     = SDL_SwapLE32(u32Offset);
+        stEntry.u32Size       = SDL_SwapLE32(stEntry.u32Size);
+        stEntry.u32StoredSize = SDL_SwapLE32(stEntry.u32StoredSize);
+        stEntry.u32Flags      = SDL_SwapLE32(stEntry.u32Flags);
+        fwrite(&stEntry, sizeof(struct PackEntry_t), 1, pstArchive);
+
+        u32Offset += pstFiles[u32Index].stEntry.u32StoredSize;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        PackEntry *pstEntry = &pstFiles[u32Index].stEntry;
+
+        fwrite(au8Padding, 1, pstEntry->u32Offset - ftell(pstArchive), pstArchive);
+        fwrite(pstFiles[u32Index].pu8Data, 1, pstEntry->u32StoredSize, pstArchive);
+    }
+
+    if (0 != fclose(pstArchive))
+    {
+        fprintf(stderr, "pack: couldn't write %s\n", pacFilename);
+        return -1;
+    }
+
+    return 0;
+}
+
+int32_t main(int32_t s32ArgC, char *pacArgV[])
+{
+    PackFile *pstFiles;
+    uint32_t  u32Count;
+    int32_t   s32First  = 1;
+    int32_t   s32Status = EXIT_FAILURE;
+    uint8_t   u8Deflate = 0;
+
+    if ((s32ArgC > 1) && (0 == strcmp(pacArgV[1], "-z")))
+    {
+        u8Deflate = 1;
+        s32First++;
+    }
+
+    if (s32ArgC < s32First + 2)
+    {
+        fprintf(stderr, "Usage: pack [-z] ARCHIVE FILE...\n");
+        return EXIT_FAILURE;
+    }
+
+    u32Count = s32ArgC - s32First - 1;
+    pstFiles = calloc(u32Count, sizeof(struct PackFile_t));
+    if (NULL == pstFiles)
+    {
+        fprintf(stderr, "pack: error allocating memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        PackFile   *pstFile = &pstFiles[u32Index];
+        const char *pacPath = pacArgV[s32First + 1 + u32Index];
+
+        // Lookups are relative to the working directory of the game.
+        while (0 == strncmp(pacPath, "./", 2))
+        {
+            pacPath += 2;
+        }
+
+        if (strlen(pacPath) >= PACK_MAX_PATH_LENGTH)
+        {
+            fprintf(stderr, "pack: path too long: %s\n", pacPath);
+            goto quit;
+        }
+
+        // Stored paths are compared as they are, so they must be plain.
+        if (('/' == pacPath[0]) ||
+            (NULL != strstr(pacPath, "/./")) ||
+            (NULL != strstr(pacPath, "..")) ||
+            (NULL != strstr(pacPath, "//")))
+        {
+            fprintf(stderr, "pack: path not normalised: %s\n", pacPath);
+            goto quit;
+        }
+        memcpy(pstFile->stEntry.acPath, pacPath, strlen(pacPath) + 1);
+
+        pstFile->pu8Data = _ReadFile(pacArgV[s32First + 1 + u32Index], &pstFile->stEntry.u32Size);
+        if (NULL == pstFile->pu8Data)
+        {
+            goto quit;
+        }
+        pstFile->stEntry.u32StoredSize = pstFile->stEntry.u32Size;
+
+        if (u8Deflate && (-1 == _Deflate(pstFile)))
+        {
+            goto quit;
+        }
+    }
+
+    // The index is searched by bisection.
+    qsort(pstFiles, u32Count, sizeof(struct PackFile_t), _Compare);
+    for (uint32_t u32Index = 1; u32Index < u32Count; u32Index++)
+    {
+        if (0 == _Compare(&pstFiles[u32Index - 1], &pstFiles[u32Index]))
+        {
+            fprintf(stderr, "pack: duplicate path: %s\n", pstFiles[u32Index].stEntry.acPath);
+            goto quit;
+        }
+    }
+
+    if (0 == _Write(pacArgV[s32First], pstFiles, u32Count))
+    {
+        s32Status = EXIT_SUCCESS;
+    }
+
+quit:
+    for (uint32_t u32Index = 0; u32Index < u32Count; u32Index++)
+    {
+        free(pstFiles[u32Index].pu8Data);
+    }
+    free(pstFiles);
+
+    return s32Status;
+}